@@ -0,0 +1,1180 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buffer.h"
+#include "bufHashTbl.h"
+#include "bufTrace.h"
+#include "policies/replacementPolicy.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double nsPerOp(Clock::time_point start, Clock::time_point end, std::uint64_t ops)
+{
+  return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+File createBenchFile(const std::string& filename, PageId pages)
+{
+  try {
+    File::remove(filename);
+  } catch(FileNotFoundException&) {
+  }
+  File file = File::create(filename);
+  for (PageId i = 0; i < pages; i++) {
+    Page page = file.allocatePage();
+    page.insertRecord("bench");
+    file.writePage(page);
+  }
+  return file;
+}
+
+/**
+ * Cost of a hash table miss through the throwing lookup() versus the
+ * non-throwing probe().
+ */
+void benchHashMiss(std::uint64_t ops)
+{
+  const std::string filename = "bench.hash";
+  {
+    File file = createBenchFile(filename, 1);
+    BufHashTbl table(1024);
+    for (FrameId i = 0; i < 512; i++)
+      table.insert(&file, i + 1, i);
+
+    FrameId frame = 0;
+    std::uint64_t misses = 0;
+    Clock::time_point start = Clock::now();
+    for (std::uint64_t i = 0; i < ops; i++) {
+      try {
+        table.lookup(&file, 100000 + (i & 1023), frame);
+      } catch(HashNotFoundException&) {
+        misses++;
+      }
+    }
+    Clock::time_point mid = Clock::now();
+    for (std::uint64_t i = 0; i < ops; i++) {
+      if (!table.probe(&file, 100000 + (i & 1023), frame))
+        misses++;
+    }
+    Clock::time_point end = Clock::now();
+
+    std::cout << "hash-miss lookup+catch: " << nsPerOp(start, mid, ops) << " ns/op\n";
+    std::cout << "hash-miss probe:        " << nsPerOp(mid, end, ops) << " ns/op\n";
+    if (misses != 2 * ops)
+      std::cout << "unexpected hits\n";
+  }
+  File::remove(filename);
+}
+
+/**
+ * Cost of hash table hits, and of the insert/remove churn an eviction does,
+ * on a pool-sized table holding pages from many files.
+ */
+void benchHashHit(std::uint64_t ops)
+{
+  const std::uint32_t entries = 1 << 20;
+  const int numFiles = 64;
+  // only the addresses are used as keys, the objects are never touched
+  std::vector<char> files(numFiles * 64);
+  BufHashTbl table(entries);
+  for (std::uint32_t i = 0; i < entries; i++)
+    table.insert(reinterpret_cast<File*>(&files[(i % numFiles) * 64]), i / numFiles + 1, i);
+
+  FrameId frame = 0;
+  std::uint64_t sum = 0;
+  std::uint64_t seed = 1;
+  Clock::time_point start = Clock::now();
+  for (std::uint64_t i = 0; i < ops; i++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    const std::uint32_t e = (seed >> 33) % entries;
+    table.probe(reinterpret_cast<File*>(&files[(e % numFiles) * 64]), e / numFiles + 1, frame);
+    sum += frame;
+  }
+  Clock::time_point mid = Clock::now();
+  for (std::uint64_t i = 0; i < ops; i++) {
+    const std::uint32_t e = i % entries;
+    File* file = reinterpret_cast<File*>(&files[(e % numFiles) * 64]);
+    table.erase(file, e / numFiles + 1);
+    table.insert(file, e / numFiles + 1, e);
+  }
+  Clock::time_point end = Clock::now();
+
+  std::cout << "hash-hit probe:         " << nsPerOp(start, mid, ops) << " ns/op\n";
+  std::cout << "hash erase+insert:      " << nsPerOp(mid, end, ops) << " ns/op\n";
+  if (sum == 0)
+    std::cout << "no hits\n";
+}
+
+/**
+ * Cost of a BufMgr::readPage() miss: the pool is much smaller than the file
+ * and pages are read in a cycle, so every access misses.
+ */
+void benchReadMiss(std::uint64_t ops)
+{
+  const std::string filename = "bench.miss";
+  const PageId filePages = 1024;
+  {
+    File file = createBenchFile(filename, filePages);
+    BufMgr bufMgr(64);
+    Page* page;
+    Clock::time_point start = Clock::now();
+    for (std::uint64_t i = 0; i < ops; i++) {
+      const PageId pageNo = 1 + (i % filePages);
+      bufMgr.readPage(&file, pageNo, page);
+      bufMgr.unPinPage(&file, pageNo, false);
+    }
+    Clock::time_point end = Clock::now();
+    std::cout << "readPage miss: " << nsPerOp(start, end, ops) << " ns/op\n";
+  }
+  File::remove(filename);
+}
+
+/**
+ * Time to construct and destroy a buffer pool of the given number of frames.
+ */
+void benchPoolCreate(std::uint64_t frames)
+{
+  Clock::time_point start = Clock::now();
+  BufMgr* bufMgr = new BufMgr(static_cast<std::uint32_t>(frames));
+  Clock::time_point mid = Clock::now();
+  delete bufMgr;
+  Clock::time_point end = Clock::now();
+  std::cout << "pool-create " << frames << " frames: "
+            << std::chrono::duration<double, std::milli>(mid - start).count() << " ms, destroy "
+            << std::chrono::duration<double, std::milli>(end - mid).count() << " ms\n";
+}
+
+/**
+ * Hit throughput of readPage()/unPinPage() from 1 up to 32 threads, each
+ * doing ops accesses to random pages of a file that fits in the pool.
+ */
+void benchThreadedHit(std::uint64_t ops)
+{
+  const std::string filename = "bench.threads";
+  const PageId filePages = 2048;
+  {
+    File file = createBenchFile(filename, filePages);
+    BufMgr bufMgr(4096);
+    Page* page;
+    for (PageId i = 1; i <= filePages; i++) {
+      bufMgr.readPage(&file, i, page);
+      bufMgr.unPinPage(&file, i, false);
+    }
+
+    for (int threads = 1; threads <= 32; threads *= 2) {
+      std::vector<std::thread> workers;
+      Clock::time_point start = Clock::now();
+      for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&bufMgr, &file, ops, t, filePages]() {
+          std::uint64_t seed = t + 1;
+          Page* threadPage;
+          for (std::uint64_t i = 0; i < ops; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            const PageId pageNo = 1 + (seed >> 33) % filePages;
+            bufMgr.readPage(&file, pageNo, threadPage);
+            bufMgr.unPinPage(&file, pageNo, false);
+          }
+        }));
+      }
+      for (int t = 0; t < threads; t++)
+        workers[t].join();
+      Clock::time_point end = Clock::now();
+      const double seconds = std::chrono::duration<double>(end - start).count();
+      std::cout << "threaded-hit " << threads << " threads: "
+                << (threads * ops) / seconds / 1e6 << " Mops/s\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Throughput of readPage()/unPinPage() from 1, 4 and 16 threads, each doing
+ * ops accesses to random pages, with the pool in one shard and in the
+ * automatic number of shards (at least 4): all hits on a file that fits in
+ * the pool, and about half misses on one twice its size.
+ */
+void benchShardedHit(std::uint64_t ops)
+{
+  const std::string filename = "bench.shards";
+  const std::uint32_t frames = 4096;
+  {
+    File file = createBenchFile(filename, frames * 2);
+    for (int sharded = 0; sharded < 2; sharded++) {
+      for (int misses = 0; misses < 2; misses++) {
+        const PageId filePages = misses ? frames * 2 : frames / 2;
+        BufMgrOptions options;
+        options.shards = sharded ? std::max<std::uint32_t>(4, PoolTopology().groupCount()) : 1;
+        BufMgr bufMgr(frames, options);
+        Page* page;
+        for (PageId i = 1; i <= std::min<PageId>(filePages, frames); i++) {
+          bufMgr.readPage(&file, i, page);
+          bufMgr.unPinPage(&file, i, false);
+        }
+
+        for (int threads = 1; threads <= 16; threads *= 4) {
+          std::vector<std::thread> workers;
+          Clock::time_point start = Clock::now();
+          for (int t = 0; t < threads; t++) {
+            workers.push_back(std::thread([&bufMgr, &file, ops, t, filePages]() {
+              std::uint64_t seed = t + 1;
+              Page* threadPage;
+              for (std::uint64_t i = 0; i < ops; i++) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                const PageId pageNo = 1 + (seed >> 33) % filePages;
+                bufMgr.readPage(&file, pageNo, threadPage);
+                bufMgr.unPinPage(&file, pageNo, false);
+              }
+            }));
+          }
+          for (int t = 0; t < threads; t++)
+            workers[t].join();
+          Clock::time_point end = Clock::now();
+          const double seconds = std::chrono::duration<double>(end - start).count();
+          std::cout << "sharded-hit " << options.shards << " shard(s), "
+                    << (misses ? "half misses" : "all hits   ") << ", " << threads
+                    << " threads: " << (threads * ops) / seconds / 1e6 << " Mops/s\n";
+        }
+      }
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Time to re-read a hot set of 128 pages after a full scan of a file eight
+ * times the pool size, with the scan made as NORMAL_ACCESS with detection
+ * turned off, as NORMAL_ACCESS with detection, and as SEQUENTIAL_SCAN.
+ */
+void benchScanPollution(std::uint64_t ops)
+{
+  const std::string filename = "bench.scan";
+  const std::uint32_t frames = 256;
+  const PageId filePages = frames * 8;
+  const PageId hotPages = 128;
+  const char* modes[] = {"normal", "detected", "sequential-scan"};
+  {
+    File file = createBenchFile(filename, filePages);
+    for (int m = 0; m < 3; m++) {
+      BufMgrOptions options;
+      if (m == 0)
+        options.sequentialRunLength = 0;
+      BufMgr bufMgr(frames, options);
+      Page* page;
+      // hot pages are every 16th page, so touching them is not a sequential run
+      for (PageId i = 0; i < hotPages; i++) {
+        bufMgr.readPage(&file, 1 + i * 16, page);
+        bufMgr.unPinPage(&file, 1 + i * 16, false);
+      }
+      for (PageId i = 1; i <= filePages; i++) {
+        bufMgr.readPage(&file, i, page, m == 2 ? SEQUENTIAL_SCAN : NORMAL_ACCESS);
+        bufMgr.unPinPage(&file, i, false);
+      }
+      Clock::time_point start = Clock::now();
+      for (PageId i = 0; i < hotPages; i++) {
+        bufMgr.readPage(&file, 1 + i * 16, page);
+        bufMgr.unPinPage(&file, 1 + i * 16, false);
+      }
+      Clock::time_point end = Clock::now();
+      std::cout << "scan-pollution " << modes[m] << ": hot set re-read "
+                << nsPerOp(start, end, hotPages) << " ns/page\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Latency percentiles of readPage() on a write-heavy workload (every page is
+ * dirtied) over a file four times the pool size, for each replacement policy,
+ * without and with the background writer.  A think time between accesses
+ * gives the writer room to work, as a real workload would.
+ */
+void benchDirtyMiss(std::uint64_t ops)
+{
+  const std::string filename = "bench.dirty";
+  const std::uint32_t frames = 512;
+  const PageId filePages = frames * 4;
+  const ReplacementPolicyKind kinds[] = {CLOCK_POLICY, LRU_K_POLICY, TWO_Q_POLICY, ARC_POLICY};
+  const char* names[] = {"clock", "lru-k", "2q", "arc"};
+  {
+    File file = createBenchFile(filename, filePages);
+    std::vector<double> latencies(ops);
+    for (int k = 0; k < 4; k++) {
+      for (int writer = 0; writer < 2; writer++) {
+        BufMgrOptions options;
+        options.policy = kinds[k];
+        options.backgroundWriter = writer == 1;
+        options.cleanFrameTarget = frames / 4;
+        BufMgr bufMgr(frames, options);
+        Page* page;
+        std::uint64_t seed = 7;
+        for (std::uint64_t i = 0; i < ops; i++) {
+          seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+          const PageId pageNo = 1 + (seed >> 33) % filePages;
+          Clock::time_point start = Clock::now();
+          bufMgr.readPage(&file, pageNo, page);
+          Clock::time_point end = Clock::now();
+          bufMgr.unPinPage(&file, pageNo, true);
+          latencies[i] = nsPerOp(start, end, 1);
+          Clock::time_point think = end + std::chrono::microseconds(20);
+          while (Clock::now() < think) {
+          }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "dirty-miss " << (writer ? "writer   " : "no-writer")
+                  << " " << names[k] << ": p50 " << latencies[ops / 2]
+                  << " ns, p99 " << latencies[ops * 99 / 100]
+                  << " ns, p99.9 " << latencies[ops * 999 / 1000] << " ns\n";
+      }
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * An executor-like loop over batches of 32 random pages, with 20 us of
+ * computation per page, reading each page as it gets to it versus
+ * prefetching the next batch before working on the current one.
+ */
+void benchPrefetch(std::uint64_t ops)
+{
+  const std::string filename = "bench.prefetch";
+  const std::uint32_t frames = 256;
+  const PageId filePages = 2048;
+  const std::uint32_t batch = 32;
+  {
+    File file = createBenchFile(filename, filePages);
+    for (int mode = 0; mode < 2; mode++) {
+      BufMgr bufMgr(frames);
+      std::uint64_t seed = 11;
+      std::vector<PageId> current, next;
+      for (std::uint32_t i = 0; i < batch; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        next.push_back(1 + (seed >> 33) % filePages);
+      }
+      Page* page;
+      Clock::time_point start = Clock::now();
+      for (std::uint64_t done = 0; done < ops; done += batch) {
+        current.swap(next);
+        next.clear();
+        for (std::uint32_t i = 0; i < batch; i++) {
+          seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+          next.push_back(1 + (seed >> 33) % filePages);
+        }
+        if (mode == 1)
+          bufMgr.prefetch(&file, next);
+        for (std::uint32_t i = 0; i < batch; i++) {
+          bufMgr.readPage(&file, current[i], page);
+          Clock::time_point work = Clock::now() + std::chrono::microseconds(20);
+          while (Clock::now() < work) {
+          }
+          bufMgr.unPinPage(&file, current[i], false);
+        }
+      }
+      Clock::time_point end = Clock::now();
+      std::cout << "prefetch " << (mode ? "on " : "off") << ": "
+                << nsPerOp(start, end, ops) << " ns/page\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Duration of resize() steps on a pool of 8192 frames holding a 4096-page
+ * file, growing to [ops] frames and shrinking to 2048 (which evicts half the
+ * file, a quarter of it dirty), and the worst readPage() hit latency a
+ * thread working on 1024 hot pages sees during each step and outside them.
+ */
+void benchResize(std::uint64_t ops)
+{
+  const std::string filename = "bench.resize";
+  const PageId filePages = 4096;
+  const std::uint32_t maxFrames = std::max<std::uint32_t>(static_cast<std::uint32_t>(ops), 16384);
+  const std::uint32_t steps[] = {maxFrames, 8192, 2048, 8192};
+  {
+    File file = createBenchFile(filename, filePages);
+    BufMgrOptions options;
+    options.maxBufs = maxFrames;
+    BufMgr bufMgr(8192, options);
+    Page* page;
+    for (PageId i = 1; i <= filePages; i++) {
+      bufMgr.readPage(&file, i, page);
+      bufMgr.unPinPage(&file, i, i % 4 == 0);
+    }
+
+    std::atomic<int> phase(0);
+    std::atomic<bool> stop(false);
+    double worst[2] = {0, 0};
+    std::thread reader([&]() {
+      std::uint64_t seed = 3;
+      Page* threadPage;
+      while (!stop) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const PageId pageNo = 1 + (seed >> 33) % 1024;
+        const int during = phase;
+        Clock::time_point start = Clock::now();
+        bufMgr.readPage(&file, pageNo, threadPage);
+        const double latency = nsPerOp(start, Clock::now(), 1);
+        bufMgr.unPinPage(&file, pageNo, false);
+        worst[during] = std::max(worst[during], latency);
+      }
+    });
+
+    std::uint32_t from = 8192;
+    for (int s = 0; s < 4; s++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      worst[1] = 0;
+      phase = 1;
+      Clock::time_point start = Clock::now();
+      bufMgr.resize(steps[s]);
+      Clock::time_point end = Clock::now();
+      phase = 0;
+      std::cout << "resize " << from << " -> " << steps[s] << ": "
+                << nsPerOp(start, end, 1000000) << " ms, worst hit during "
+                << worst[1] / 1000 << " us\n";
+      from = steps[s];
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop = true;
+    reader.join();
+    std::cout << "resize worst hit outside resizes: " << worst[0] / 1000 << " us\n";
+  }
+  File::remove(filename);
+}
+
+/**
+ * Cost of flushFile() on a small file of 8 resident, clean pages while
+ * another file holds half of a pool of [ops] frames: the cost of finding the
+ * file's pages, without any writes.
+ */
+void benchFlushSmall(std::uint64_t ops)
+{
+  const std::string bigName = "bench.flush.big";
+  const std::string smallName = "bench.flush.small";
+  const std::uint32_t frames = static_cast<std::uint32_t>(ops);
+  const PageId smallPages = 8;
+  const int rounds = 100;
+  {
+    File big = createBenchFile(bigName, frames / 2);
+    File small = createBenchFile(smallName, smallPages);
+    BufMgr bufMgr(frames);
+    Page* page;
+    for (PageId i = 1; i <= frames / 2; i++) {
+      bufMgr.readPage(&big, i, page);
+      bufMgr.unPinPage(&big, i, false);
+    }
+    double total = 0;
+    for (int r = 0; r < rounds; r++) {
+      for (PageId i = 1; i <= smallPages; i++) {
+        bufMgr.readPage(&small, i, page);
+        bufMgr.unPinPage(&small, i, false);
+      }
+      Clock::time_point start = Clock::now();
+      bufMgr.flushFile(&small);
+      total += nsPerOp(start, Clock::now(), 1);
+    }
+    std::cout << "flush-small " << frames << " frames: " << total / rounds
+              << " ns/flushFile\n";
+  }
+  File::remove(bigName);
+  File::remove(smallName);
+}
+
+/**
+ * Cost of a resident page read and unpin through readPage()/unPinPage(),
+ * which looks the page up twice, versus a PinnedPage from pinPage(), which
+ * unpins by frame.
+ */
+void benchPinnedHit(std::uint64_t ops)
+{
+  const std::string filename = "bench.pinned";
+  const PageId filePages = 1024;
+  {
+    File file = createBenchFile(filename, filePages);
+    BufMgr bufMgr(filePages);
+    Page* page;
+    for (PageId i = 1; i <= filePages; i++) {
+      bufMgr.readPage(&file, i, page);
+      bufMgr.unPinPage(&file, i, false);
+    }
+    for (int pinned = 0; pinned < 2; pinned++) {
+      std::uint64_t seed = 7;
+      Clock::time_point start = Clock::now();
+      for (std::uint64_t i = 0; i < ops; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const PageId pageNo = 1 + (seed >> 33) % filePages;
+        if (pinned) {
+          PinnedPage handle = bufMgr.pinPage(&file, pageNo);
+        } else {
+          bufMgr.readPage(&file, pageNo, page);
+          bufMgr.unPinPage(&file, pageNo, false);
+        }
+      }
+      std::cout << "pinned-hit " << (pinned ? "pinPage:            " : "readPage/unPinPage: ")
+                << nsPerOp(start, Clock::now(), ops) << " ns/op\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Cost of readPage()/unPinPage() hits with event tracing off and on, and of
+ * the misses of a pool too small for the file; only meaningful in a build
+ * with make TRACE=1.
+ */
+void benchTracedHit(std::uint64_t ops)
+{
+#ifndef BADGERDB_TRACE
+  std::cout << "traced-hit: tracing not compiled in, build with make bench TRACE=1\n";
+#endif
+  const std::string filename = "bench.traced";
+  const PageId filePages = 1024;
+  {
+    File file = createBenchFile(filename, filePages);
+    for (int misses = 0; misses < 2; misses++) {
+      BufMgr bufMgr(misses ? filePages / 4 : filePages);
+      Page* page;
+      const std::uint64_t count = misses ? ops / 20 : ops;
+      for (int traced = 0; traced < 2; traced++) {
+        BufTrace::enable(traced);
+        std::uint64_t seed = 11;
+        Clock::time_point start = Clock::now();
+        for (std::uint64_t i = 0; i < count; i++) {
+          seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+          const PageId pageNo = 1 + (seed >> 33) % filePages;
+          bufMgr.readPage(&file, pageNo, page);
+          bufMgr.unPinPage(&file, pageNo, false);
+        }
+        Clock::time_point end = Clock::now();
+        BufTrace::enable(false);
+        std::cout << "traced-hit " << (misses ? "mostly misses" : "hits         ")
+                  << (traced ? " traced:   " : " untraced: ")
+                  << nsPerOp(start, end, count) << " ns/op\n";
+      }
+    }
+  }
+  BufTrace::clear();
+  File::remove(filename);
+}
+
+/**
+ * Throughput of File::readPage on one file from 1..8 threads, [ops] random
+ * reads per thread, while one more thread rewrites other pages of it.
+ */
+void benchFileRead(std::uint64_t ops)
+{
+  const std::string filename = "bench.read";
+  const PageId filePages = 1024;
+  {
+    File file = createBenchFile(filename, filePages);
+    for (int threads = 1; threads <= 8; threads *= 2) {
+      std::atomic<bool> done(false);
+      std::thread writer([&file, &done, filePages]() {
+        Page page = file.readPage(filePages);
+        while (!done.load())
+          file.writePage(page);
+      });
+      std::vector<std::thread> workers;
+      Clock::time_point start = Clock::now();
+      for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&file, ops, t, filePages]() {
+          std::uint64_t seed = t + 1;
+          Page page;
+          for (std::uint64_t i = 0; i < ops; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            file.readPage(1 + (seed >> 33) % (filePages - 1), page);
+          }
+        }));
+      }
+      for (int t = 0; t < threads; t++)
+        workers[t].join();
+      Clock::time_point end = Clock::now();
+      done = true;
+      writer.join();
+      const double seconds = std::chrono::duration<double>(end - start).count();
+      std::cout << "file-read " << threads << " threads: "
+                << (threads * ops) / seconds / 1e6 << " Mops/s\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Cost of random readPage misses and of flushFile() writing dirty pages,
+ * through the page cache and with direct I/O.
+ */
+void benchDirectIO(std::uint64_t ops)
+{
+  const std::string filename = "bench.direct";
+  const PageId filePages = 1024;
+  const char* names[] = {"cached", "direct"};
+  {
+    File file = createBenchFile(filename, filePages);
+    for (int direct = 0; direct < 2; direct++) {
+      if (!file.setDirectIO(direct == 1)) {
+        std::cout << "direct-io: the file system refused direct I/O\n";
+        break;
+      }
+      BufMgr bufMgr(64);
+      Page* page;
+      std::uint64_t seed = 1;
+      Clock::time_point start = Clock::now();
+      for (std::uint64_t i = 0; i < ops; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const PageId pageNo = 1 + (seed >> 33) % filePages;
+        bufMgr.readPage(&file, pageNo, page);
+        bufMgr.unPinPage(&file, pageNo, false);
+      }
+      std::cout << "direct-io " << names[direct] << " readPage miss: "
+                << nsPerOp(start, Clock::now(), ops) << " ns/op\n";
+
+      for (PageId i = 1; i <= 64; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const PageId pageNo = 1 + (seed >> 33) % filePages;
+        bufMgr.readPage(&file, pageNo, page);
+        bufMgr.unPinPage(&file, pageNo, true);
+      }
+      start = Clock::now();
+      bufMgr.flushFile(&file);
+      std::cout << "direct-io " << names[direct] << " flushFile: "
+                << nsPerOp(start, Clock::now(), 64) << " ns/page\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Cost of random and in-order readPage/unPinPage through a pool a quarter the
+ * size of the file, read with pread() into frames and from a mapping of it.
+ */
+void benchMappedRead(std::uint64_t ops)
+{
+  const std::string filename = "bench.mapped";
+  const PageId filePages = 1024;
+  createBenchFile(filename, filePages);
+  for (int mapped = 0; mapped < 2; mapped++) {
+    File file = mapped ? File::openMapped(filename) : File::open(filename);
+    const char* name = mapped ? "mmap" : "pread";
+    BufMgr bufMgr(filePages / 4);
+    Page* page;
+    std::uint64_t seed = 1;
+    Clock::time_point start = Clock::now();
+    for (std::uint64_t i = 0; i < ops; i++) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      const PageId pageNo = 1 + (seed >> 33) % filePages;
+      bufMgr.readPage(&file, pageNo, page);
+      bufMgr.unPinPage(&file, pageNo, false);
+    }
+    std::cout << "mapped-read " << name << " random: "
+              << nsPerOp(start, Clock::now(), ops) << " ns/op\n";
+
+    file.adviseAccess(ADVISE_SEQUENTIAL);
+    start = Clock::now();
+    for (std::uint64_t i = 0; i < ops; i++) {
+      const PageId pageNo = 1 + i % filePages;
+      bufMgr.readPage(&file, pageNo, page, SEQUENTIAL_SCAN);
+      bufMgr.unPinPage(&file, pageNo, false);
+    }
+    std::cout << "mapped-read " << name << " in order: "
+              << nsPerOp(start, Clock::now(), ops) << " ns/op\n";
+  }
+  File::remove(filename);
+}
+
+/**
+ * Per-page cost of File::allocatePage while a new file grows to [ops] pages
+ * (at most 200000), per quarter of the growth, and of reusing freed pages.
+ */
+void benchFileAlloc(std::uint64_t ops)
+{
+  const std::string filename = "bench.alloc";
+  const PageId filePages = std::min<std::uint64_t>(ops, 200000);
+  try {
+    File::remove(filename);
+  } catch(FileNotFoundException&) {
+  }
+  {
+    File file = File::create(filename);
+    file.setSyncMode(SYNC_FLUSH);
+    Page page;
+    for (int quarter = 1; quarter <= 4; quarter++) {
+      const PageId pages = filePages / 4;
+      Clock::time_point start = Clock::now();
+      for (PageId i = 0; i < pages; i++)
+        file.allocatePage(page);
+      std::cout << "file-alloc append, quarter " << quarter << ": "
+                << nsPerOp(start, Clock::now(), pages) << " ns/page\n";
+    }
+    const PageId freed = filePages / 10;
+    for (PageId i = 0; i < freed; i++)
+      file.deletePage(1 + i * 10);
+    Clock::time_point start = Clock::now();
+    for (PageId i = 0; i < freed; i++)
+      file.allocatePage(page);
+    std::cout << "file-alloc reuse: " << nsPerOp(start, Clock::now(), freed) << " ns/page\n";
+
+    // the page above a long free run, reused in turn with pages far below
+    const PageId run = filePages / 2;
+    for (PageId i = 0; i < freed; i++)
+      file.deletePage(run + i);
+    const PageId above = run + freed;
+    const PageId rounds = std::min<PageId>(freed, 1000);
+    start = Clock::now();
+    for (PageId i = 0; i < rounds; i++) {
+      file.deletePage(above);
+      file.deletePage(2 + i * 10);
+      file.allocatePage(page);
+      file.allocatePage(page);
+    }
+    std::cout << "file-alloc reuse above a " << freed << "-page free run: "
+              << nsPerOp(start, Clock::now(), rounds * 2) << " ns per delete and reuse\n";
+  }
+  File::remove(filename);
+}
+
+/**
+ * Per-page cost of writing the pages of a file in order, [ops] writes in
+ * passes over 1024 pages with a sync() after each pass, per sync mode.
+ */
+void benchFileWrite(std::uint64_t ops)
+{
+  const std::string filename = "bench.write";
+  const PageId filePages = 1024;
+  const SyncMode modes[] = {FLUSH_EACH_WRITE, SYNC_NONE, SYNC_FLUSH, SYNC_FDATASYNC, FSYNC_EACH_WRITE};
+  const char* names[] = {"flush-each-write", "none", "flush", "fdatasync", "fsync-each-write"};
+  {
+    File file = createBenchFile(filename, filePages);
+    std::vector<Page> pages;
+    for (PageId i = 1; i <= filePages; i++)
+      pages.push_back(file.readPage(i));
+    for (int m = 0; m < 5; m++) {
+      file.setSyncMode(modes[m]);
+      // fsync per write is too slow for many passes
+      const std::uint64_t writes = modes[m] == FSYNC_EACH_WRITE ? filePages : ops;
+      std::uint64_t done = 0;
+      Clock::time_point start = Clock::now();
+      while (done < writes) {
+        for (PageId i = 0; i < filePages && done < writes; i++, done++)
+          file.writePage(pages[i]);
+        file.sync();
+      }
+      std::cout << "file-write " << names[m] << ": "
+                << nsPerOp(start, Clock::now(), done) << " ns/page\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Per-page cost of writing back about 60% of a file's pages, dirtied at
+ * random, [ops] pages in all: with flushFile(), one page at a time, and with
+ * checkpoint(), in runs of adjacent pages and one page at a time.
+ */
+void benchCheckpoint(std::uint64_t ops)
+{
+  const std::string filename = "bench.checkpoint";
+  const PageId filePages = 1024;
+  const char* names[] = {"flushFile:         ", "checkpoint:        ", "checkpoint, 1-page:"};
+  {
+    File file = createBenchFile(filename, filePages);
+    BufMgr bufMgr(filePages);
+    Page* page;
+    for (int w = 0; w < 3; w++) {
+      std::uint64_t seed = 13;
+      std::uint64_t written = 0;
+      double total = 0;
+      while (written < ops) {
+        // in random order, which a scan would not be taken for
+        for (PageId i = 0; i < filePages; i++) {
+          seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+          const PageId pageNo = 1 + (seed >> 33) % filePages;
+          bufMgr.readPage(&file, pageNo, page);
+          bufMgr.unPinPage(&file, pageNo, true);
+        }
+        const std::uint64_t before = bufMgr.getBufStats().counters[DISK_WRITES];
+        Clock::time_point start = Clock::now();
+        if (w == 0) {
+          bufMgr.flushFile(&file);
+        } else {
+          CheckpointOptions options;
+          options.maxRunPages = w == 1 ? 64 : 1;
+          bufMgr.checkpoint(options);
+        }
+        total += nsPerOp(start, Clock::now(), 1);
+        written += bufMgr.getBufStats().counters[DISK_WRITES] - before;
+      }
+      std::cout << "checkpoint " << names[w] << " " << total / written << " ns/page\n";
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Time to bring back the pages of a full pool: warmUp() from a saved list
+ * of resident pages, versus the same pages read by readPage() misses in the
+ * random order a workload would touch them.
+ */
+void benchWarmUp(std::uint64_t ops)
+{
+  const std::string filename = "bench.warm";
+  const std::string listName = "bench.warm.list";
+  const PageId filePages = 1024;
+  {
+    File file = createBenchFile(filename, filePages);
+    std::vector<PageId> order;
+    for (PageId i = 1; i <= filePages; i++)
+      order.push_back(i);
+    std::uint64_t seed = 17;
+    for (std::size_t i = order.size() - 1; i > 0; i--) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      std::swap(order[i], order[(seed >> 33) % (i + 1)]);
+    }
+    Page* page;
+    {
+      BufMgr bufMgr(filePages);
+      for (PageId i = 0; i < filePages; i++) {
+        bufMgr.readPage(&file, order[i], page);
+        bufMgr.unPinPage(&file, order[i], false);
+      }
+      bufMgr.saveResidentPages(listName);
+    }
+
+    double cold = 0, warm = 0;
+    const int rounds = std::max<std::uint64_t>(1, ops / filePages);
+    std::uint32_t restored = 0;
+    for (int r = 0; r < rounds; r++) {
+      {
+        BufMgr bufMgr(filePages);
+        Clock::time_point start = Clock::now();
+        for (PageId i = 0; i < filePages; i++) {
+          bufMgr.readPage(&file, order[i], page);
+          bufMgr.unPinPage(&file, order[i], false);
+        }
+        cold += nsPerOp(start, Clock::now(), filePages);
+      }
+      {
+        BufMgr bufMgr(filePages);
+        std::map<std::string, File*> files;
+        files[filename] = &file;
+        bufMgr.warmUp(listName, files);
+        const WarmUpStatus status = bufMgr.waitForWarmUp();
+        restored = status.restored;
+        warm += double(status.elapsedNanos) / filePages;
+      }
+    }
+    std::cout << "warm-up readPage misses: " << cold / rounds << " ns/page\n"
+              << "warm-up warmUp():        " << warm / rounds << " ns/page, "
+              << restored << " pages restored\n";
+  }
+  std::remove(listName.c_str());
+  File::remove(filename);
+}
+
+/**
+ * Cost of touching one word in random frames of an arena of [ops] frames,
+ * per page backing: the TLB misses huge pages save.  Goes to the FrameArena
+ * directly, since filling a pool that large from a file takes too long.
+ */
+void benchHugePages(std::uint64_t ops)
+{
+  const std::uint32_t frames = static_cast<std::uint32_t>(ops);
+  const std::uint64_t accesses = 10000000;
+  const PageBacking backings[] = {NORMAL_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES};
+  const char* names[] = {"normal", "transparent", "explicit"};
+  for (int b = 0; b < 3; b++) {
+    FrameArena arena(frames, backings[b]);
+    Page* pool = arena.frames();
+    for (std::uint32_t i = 0; i < frames; i++)
+      std::memset(static_cast<void*>(pool + i), 0, Page::SIZE);
+
+    std::uint64_t seed = 5;
+    std::uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for (std::uint64_t i = 0; i < accesses; i++) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      const char* frame = reinterpret_cast<const char*>(pool + (seed >> 33) % frames);
+      sum += frame[(seed >> 20) % Page::SIZE];
+    }
+    Clock::time_point end = Clock::now();
+    volatile std::uint64_t sink = sum;
+    (void)sink;
+    std::cout << "huge-pages " << names[b] << " -> " << names[arena.backing()] << ": "
+              << nsPerOp(start, end, accesses) << " ns/access, "
+              << arena.hugePageBytes() / (1024 * 1024) << " MB in huge pages\n";
+  }
+}
+
+/**
+ * Per-page cost of fetching batches of 32 pages one readPage()/unPinPage()
+ * at a time versus with readPages()/unPinPages(): random pages that are all
+ * resident, and runs of consecutive pages that all miss.
+ */
+void benchBatchRead(std::uint64_t ops)
+{
+  const std::string filename = "bench.batch";
+  const PageId filePages = 1024;
+  const std::uint32_t batch = 32;
+  {
+    File file = createBenchFile(filename, filePages);
+    for (int misses = 0; misses < 2; misses++) {
+      for (int batched = 0; batched < 2; batched++) {
+        // a pool of one batch makes every run of pages miss
+        BufMgr bufMgr(misses ? batch : filePages);
+        std::vector<PageId> pageNos(batch);
+        std::vector<Page*> pages;
+        Page* page;
+        std::uint64_t seed = 3;
+        std::uint64_t done = 0;
+        Clock::time_point start = Clock::now();
+        for (; done < ops; done += batch) {
+          seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+          const PageId first = 1 + (seed >> 33) % (filePages - batch);
+          for (std::uint32_t i = 0; i < batch; i++) {
+            if (misses) {
+              pageNos[i] = first + i;
+            } else {
+              seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+              pageNos[i] = 1 + (seed >> 33) % filePages;
+            }
+          }
+          if (batched) {
+            bufMgr.readPages(&file, pageNos, pages);
+            bufMgr.unPinPages(&file, pageNos, false);
+          } else {
+            for (std::uint32_t i = 0; i < batch; i++) {
+              bufMgr.readPage(&file, pageNos[i], page);
+              bufMgr.unPinPage(&file, pageNos[i], false);
+            }
+          }
+        }
+        Clock::time_point end = Clock::now();
+        std::cout << "batch-read " << (misses ? "runs of misses" : "random hits   ")
+                  << (batched ? " readPages: " : " readPage:  ")
+                  << nsPerOp(start, end, done) << " ns/page\n";
+      }
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * A buffer pool simulated in memory, for replaying page reference traces
+ * through a ReplacementPolicy without any I/O.  Nothing is ever pinned.
+ */
+class SimulatedPool : public FrameEvictor
+{
+ public:
+  SimulatedPool(ReplacementPolicy& policy, const File* file, std::uint32_t frames, PageId pages)
+    : policy(policy), file(file), pageInFrame(frames, 0), frameOfPage(pages + 1, FrameId(NONE)),
+      refbits(frames, false), unused(frames), hits(0), misses(0) {}
+
+  void access(PageId pageNo)
+  {
+    FrameId frame = frameOfPage[pageNo];
+    if (frame != NONE) {
+      hits++;
+      refbits[frame] = true;
+      policy.pageAccessed(frame);
+      return;
+    }
+    misses++;
+    if (unused > 0)
+      frame = pageInFrame.size() - unused--;
+    else if (!policy.chooseVictim(*this, file, pageNo, frame))
+      throw std::runtime_error("no victim");
+    pageInFrame[frame] = pageNo;
+    frameOfPage[pageNo] = frame;
+    refbits[frame] = true;
+    policy.pageLoaded(frame, file, pageNo, false);
+  }
+
+  double hitRatio() const { return (double)hits / (hits + misses); }
+
+  bool isResident(const FrameId frame) const { return pageInFrame[frame] != 0; }
+  bool isPinned(const FrameId frame) const { return false; }
+  bool isReferenced(const FrameId frame) const { return refbits[frame]; }
+  bool clearReferenced(const FrameId frame)
+  {
+    const bool was = refbits[frame];
+    refbits[frame] = false;
+    return was;
+  }
+  bool tryEvict(const FrameId frame)
+  {
+    const PageId pageNo = pageInFrame[frame];
+    frameOfPage[pageNo] = NONE;
+    pageInFrame[frame] = 0;
+    policy.pageRemoved(frame, file, pageNo, true);
+    return true;
+  }
+
+ private:
+  static const FrameId NONE = 0xffffffff;
+  ReplacementPolicy& policy;
+  const File* file;
+  std::vector<PageId> pageInFrame;
+  std::vector<FrameId> frameOfPage;
+  std::vector<bool> refbits;
+  std::uint32_t unused;
+  std::uint64_t hits;
+  std::uint64_t misses;
+};
+
+/**
+ * Hit ratio of every replacement policy on three synthetic traces over a
+ * database ten times the size of the pool: a skewed one (80% of accesses to
+ * 20% of the pages), the same with a sequential scan of twice the pool size
+ * every 10000 accesses, and a loop over 1.25 times the pool size.
+ */
+void benchPolicyHits(std::uint64_t ops)
+{
+  const std::string filename = "bench.policy";
+  const std::uint32_t frames = 1024;
+  const PageId pages = frames * 10;
+  const char* traces[] = {"skewed", "skewed+scan", "loop"};
+  const ReplacementPolicyKind kinds[] = {CLOCK_POLICY, LRU_K_POLICY, TWO_Q_POLICY, ARC_POLICY};
+  {
+    File file = createBenchFile(filename, 0);
+    for (int k = 0; k < 4; k++) {
+      for (int t = 0; t < 3; t++) {
+        ReplacementPolicy* policy = ReplacementPolicy::create(kinds[k], frames);
+        SimulatedPool pool(*policy, &file, frames, pages);
+        std::uint64_t seed = 42;
+        PageId scanNext = 0;
+        for (std::uint64_t i = 0; i < ops; i++) {
+          seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+          const std::uint32_t r = seed >> 33;
+          PageId pageNo;
+          if (t == 2) {
+            pageNo = 1 + i % (frames + frames / 4);
+          } else if (t == 1 && i % 10000 < 2 * frames) {
+            pageNo = 1 + scanNext;
+            scanNext = (scanNext + 1) % pages;
+          } else if (r % 10 < 8) {
+            pageNo = 1 + (r / 10) % (pages / 5);
+          } else {
+            pageNo = 1 + (r / 10) % pages;
+          }
+          pool.access(pageNo);
+        }
+        std::cout << "policy-hits " << policy->name() << " " << traces[t] << ": "
+                  << pool.hitRatio() * 100 << "% hits\n";
+        delete policy;
+      }
+    }
+  }
+  File::remove(filename);
+}
+
+void usage()
+{
+  std::cerr << "usage: badgerdb_bench <benchmark> [ops]\n"
+            << "  hash-miss   BufHashTbl miss, throwing lookup vs probe\n"
+            << "  hash-hit    BufHashTbl hits and erase/insert churn at 1M entries\n"
+            << "  pool-create construct/destroy a BufMgr with [ops] frames\n"
+            << "  threaded-hit readPage hits from 1..32 threads, [ops] per thread\n"
+            << "  sharded-hit readPage throughput from 1..16 threads, one shard vs several\n"
+            << "  read-miss   BufMgr::readPage on a pool that always misses\n"
+            << "  scan-pollution hot page reads after a large scan, per access strategy\n"
+            << "  dirty-miss  readPage latency with every page dirtied, with and without the background writer\n"
+            << "  prefetch    batched random reads with computation, with and without prefetch()\n"
+            << "  batch-read  readPage vs readPages, per page, for hits and for runs of misses\n"
+            << "  resize      resize() steps up to [ops] frames and back, with a reader running\n"
+            << "  pinned-hit  readPage/unPinPage hits vs PinnedPage handles from pinPage\n"
+            << "  traced-hit  readPage hits and misses with event tracing off and on (make bench TRACE=1)\n"
+            << "  file-read   random File::readPage from 1..8 threads with a writer running\n"
+            << "  direct-io   readPage misses and flushFile, cached vs O_DIRECT\n"
+            << "  mapped-read readPage through a small pool, pread into frames vs File::openMapped\n"
+            << "  file-alloc  allocatePage while a file grows to [ops] pages, and reusing freed pages\n"
+            << "  file-write  in-order page writes with a sync() per pass, per File sync mode\n"
+            << "  checkpoint  write-back of random dirty pages, flushFile vs checkpoint\n"
+            << "  warm-up     refilling a pool with warmUp() from a saved list vs readPage misses\n"
+            << "  huge-pages  random frame accesses in an arena of [ops] frames, per page backing\n"
+            << "  flush-small flushFile of an 8-page clean file in a pool of [ops] frames\n"
+            << "  policy-hits hit ratio of each replacement policy on [ops]-access traces\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  const std::string name = argv[1];
+  const std::uint64_t ops = argc > 2 ? std::strtoull(argv[2], NULL, 10) : 1000000;
+
+  if (name == "hash-miss")
+    benchHashMiss(ops);
+  else if (name == "hash-hit")
+    benchHashHit(ops);
+  else if (name == "pool-create")
+    benchPoolCreate(ops);
+  else if (name == "threaded-hit")
+    benchThreadedHit(ops);
+  else if (name == "sharded-hit")
+    benchShardedHit(ops);
+  else if (name == "read-miss")
+    benchReadMiss(ops);
+  else if (name == "scan-pollution")
+    benchScanPollution(ops);
+  else if (name == "dirty-miss")
+    benchDirtyMiss(ops);
+  else if (name == "prefetch")
+    benchPrefetch(ops);
+  else if (name == "batch-read")
+    benchBatchRead(ops);
+  else if (name == "resize")
+    benchResize(ops);
+  else if (name == "pinned-hit")
+    benchPinnedHit(ops);
+  else if (name == "traced-hit")
+    benchTracedHit(ops);
+  else if (name == "file-read")
+    benchFileRead(ops);
+  else if (name == "direct-io")
+    benchDirectIO(ops);
+  else if (name == "mapped-read")
+    benchMappedRead(ops);
+  else if (name == "file-alloc")
+    benchFileAlloc(ops);
+  else if (name == "file-write")
+    benchFileWrite(ops);
+  else if (name == "checkpoint")
+    benchCheckpoint(ops);
+  else if (name == "warm-up")
+    benchWarmUp(ops);
+  else if (name == "huge-pages")
+    benchHugePages(ops);
+  else if (name == "flush-small")
+    benchFlushSmall(ops);
+  else if (name == "policy-hits")
+    benchPolicyHits(ops);
+  else {
+    usage();
+    return 1;
+  }
+  return 0;
+}
@@ -5,6 +5,8 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <iostream>
 #include "buffer.h"
@@ -15,100 +17,219 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+namespace {
+
+/**
+ * Finalizer from MurmurHash3; spreads every input bit over the whole word.
+ */
+inline std::uint64_t mix64(std::uint64_t key)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
 }
 
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+}
+
+std::uint64_t BufHashTbl::hash(const File* file, const PageId pageNo) const
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  std::uint64_t key = reinterpret_cast<std::uintptr_t>(file);
+  key = key * 0x9e3779b97f4a7c15ULL + pageNo;
+  return mix64(key);
 }
 
-BufHashTbl::~BufHashTbl()
+std::uint32_t BufHashTbl::probeDistance(const hashPartition& part, const std::uint32_t index) const
+{
+  const hashBucket& bucket = part.ht[index];
+  const std::uint32_t home = static_cast<std::uint32_t>(hash(bucket.file, bucket.pageNo));
+  return (index - home) & (part.HTSIZE - 1);
+}
+
+BufHashTbl::BufHashTbl(int htSize, int partitionCount)
+	: numPartitions(1)
+{
+  while (numPartitions < static_cast<std::uint32_t>(partitionCount))
+    numPartitions <<= 1;
+
+  const std::uint32_t perPartition = partitionEntries(htSize);
+  partitions = new hashPartition[numPartitions];
+  for (std::uint32_t p = 0; p < numPartitions; p++) {
+    partitions[p].numEntries = 0;
+    allocateSlots(partitions[p], perPartition);
+  }
+}
+
+std::uint32_t BufHashTbl::partitionEntries(const int htSize) const
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
+  const std::uint64_t entries = htSize > 0 ? htSize : 1;
+  std::uint64_t perPartition = entries;
+  if (numPartitions > 1) {
+    // entries do not spread perfectly evenly, so leave generous headroom
+    perPartition = entries / numPartitions;
+    perPartition += perPartition / 2 + 64;
+  }
+  return static_cast<std::uint32_t>(perPartition);
+}
+
+std::uint32_t BufHashTbl::slotsFor(const std::uint32_t maxEntries)
+{
+  // keep the load factor at or below 3/4
+  const std::uint64_t minSlots = (static_cast<std::uint64_t>(maxEntries) * 4 + 2) / 3 + 1;
+  std::uint32_t slots = 1;
+  while (slots < minSlots)
+    slots <<= 1;
+  return slots;
+}
+
+void BufHashTbl::allocateSlots(hashPartition& part, const std::uint32_t maxEntries)
+{
+  part.maxEntries = maxEntries;
+  part.HTSIZE = slotsFor(maxEntries);
+  part.ht = new hashBucket[part.HTSIZE];
+  for(std::uint32_t i = 0; i < part.HTSIZE; i++) {
+    part.ht[i].file = NULL;
+    part.ht[i].pageNo = Page::INVALID_NUMBER;
+    part.ht[i].frameNo = 0;
+  }
+}
+
+void BufHashTbl::resize(const int htSize)
+{
+  const std::uint32_t perPartition = partitionEntries(htSize);
+  for (std::uint32_t p = 0; p < numPartitions; p++) {
+    hashPartition& part = partitions[p];
+    std::lock_guard<std::mutex> guard(part.latch);
+    const std::uint32_t maxEntries = std::max(perPartition, part.numEntries);
+    if (slotsFor(maxEntries) == part.HTSIZE) {
+      // same number of slots: keep the entries where they are
+      part.maxEntries = maxEntries;
+      continue;
     }
+    hashBucket* oldSlots = part.ht;
+    const std::uint32_t oldSize = part.HTSIZE;
+    allocateSlots(part, maxEntries);
+    for (std::uint32_t i = 0; i < oldSize; i++)
+      if (oldSlots[i].file != NULL)
+        place(part, hash(oldSlots[i].file, oldSlots[i].pageNo), oldSlots[i]);
+    delete [] oldSlots;
   }
-  delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+BufHashTbl::~BufHashTbl()
 {
-  int index = hash(file, pageNo);
+  for (std::uint32_t p = 0; p < numPartitions; p++)
+    delete [] partitions[p].ht;
+  delete [] partitions;
+}
 
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+std::uint32_t BufHashTbl::find(const hashPartition& part, const std::uint64_t hashValue,
+                               const File* file, const PageId pageNo) const
+{
+  const std::uint32_t mask = part.HTSIZE - 1;
+  std::uint32_t index = static_cast<std::uint32_t>(hashValue) & mask;
+  for (std::uint32_t dist = 0; ; dist++, index = (index + 1) & mask) {
+    const hashBucket& bucket = part.ht[index];
+    if (bucket.file == NULL)
+      return part.HTSIZE;
+    if (bucket.file == file && bucket.pageNo == pageNo)
+      return index;
+    // Robin Hood invariant: had the entry been here, it would have displaced
+    // this one, so it is not in the table.
+    if (probeDistance(part, index) < dist)
+      return part.HTSIZE;
   }
+}
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
+void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  insert(hash(file, pageNo), file, pageNo, frameNo);
+}
+
+void BufHashTbl::insert(const std::uint64_t hashValue, const File* file, const PageId pageNo,
+                        const FrameId frameNo)
+{
+  hashPartition& part = partitionFor(hashValue);
+  const std::uint32_t existing = find(part, hashValue, file, pageNo);
+  if (existing != part.HTSIZE)
+  	throw HashAlreadyPresentException(part.ht[existing].file->filename(), part.ht[existing].pageNo, part.ht[existing].frameNo);
+
+  if (part.numEntries >= part.maxEntries)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  const hashBucket entry = {file, pageNo, frameNo};
+  place(part, hashValue, entry);
+  part.numEntries++;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+void BufHashTbl::place(hashPartition& part, const std::uint64_t hashValue, hashBucket entry)
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
+  const std::uint32_t mask = part.HTSIZE - 1;
+  std::uint32_t index = static_cast<std::uint32_t>(hashValue) & mask;
+  std::uint32_t dist = 0;
+  while (part.ht[index].file != NULL) {
+    // take the slot from any entry that is closer to home than we are
+    const std::uint32_t existingDist = probeDistance(part, index);
+    if (existingDist < dist) {
+      std::swap(entry, part.ht[index]);
+      dist = existingDist;
     }
-    tmpBuc = tmpBuc->next;
+    index = (index + 1) & mask;
+    dist++;
   }
+  part.ht[index] = entry;
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (!probe(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::probe(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  return probe(hash(file, pageNo), file, pageNo, frameNo);
+}
+
+bool BufHashTbl::probe(const std::uint64_t hashValue, const File* file, const PageId pageNo,
+                       FrameId &frameNo)
+{
+  const hashPartition& part = partitionFor(hashValue);
+  const std::uint32_t index = find(part, hashValue, file, pageNo);
+  if (index == part.HTSIZE)
+    return false;
+
+  frameNo = part.ht[index].frameNo; // return frameNo by reference
+  return true;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
+  if (!erase(file, pageNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
-
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
-
-      delete tmpBuc;
-      return;
-    }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
-    }
+bool BufHashTbl::erase(const File* file, const PageId pageNo) {
+
+  const std::uint64_t hashValue = hash(file, pageNo);
+  hashPartition& part = partitionFor(hashValue);
+  std::uint32_t index = find(part, hashValue, file, pageNo);
+  if (index == part.HTSIZE)
+    return false;
+
+  // shift the rest of the cluster back by one so no tombstone is needed
+  const std::uint32_t mask = part.HTSIZE - 1;
+  std::uint32_t next = (index + 1) & mask;
+  while (part.ht[next].file != NULL && probeDistance(part, next) > 0) {
+    part.ht[index] = part.ht[next];
+    index = next;
+    next = (next + 1) & mask;
   }
-
-  throw HashNotFoundException(file->filename(), pageNo);
+  part.ht[index].file = NULL;
+  part.ht[index].pageNo = Page::INVALID_NUMBER;
+  part.numEntries--;
+  return true;
 }
 
 }
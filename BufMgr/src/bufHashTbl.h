@@ -7,18 +7,24 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
+
 #include "file.h"
 
 namespace badgerdb {
 
 /**
 * @brief Declarations for buffer pool hash table
+*
+* Entries are stored inline in one flat array, so a slot is exactly
+* 16 bytes and four of them share a cache line.
 */
 struct hashBucket {
 	/**
-	 * pointer a file object (more on this below)
+	 * pointer a file object (more on this below), NULL if the slot is empty
 	 */
-	File *file;
+	const File *file;
 
 	/**
 	 * page number within a file
@@ -29,45 +35,202 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
+};
+
+static_assert(sizeof(hashBucket) == 16, "hashBucket should be 16 bytes");
+
+
+/**
+* @brief One independently latched partition of the buffer pool hash table
+*/
+struct hashPartition {
+	/**
+	 * Latch protecting every slot of this partition
+	 */
+  std::mutex latch;
 
 	/**
-	 * Next node in the hash table
+	 *	Size of this partition (number of slots, always a power of two)
 	 */
-	hashBucket*   next;
+  std::uint32_t HTSIZE;
+
+	/**
+	 *	Maximum number of entries this partition can hold
+	 */
+  std::uint32_t maxEntries;
+
+	/**
+	 *	Number of entries currently in this partition
+	 */
+  std::uint32_t numEntries;
+
+	/**
+	 * Slots of this partition
+	 */
+  hashBucket*  ht;
+
+	/**
+	 * Keeps neighbouring latches off the same cache line
+	 */
+  char pad[64];
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* Open-addressed table using Robin Hood linear probing.  Deletion shifts the
+* following entries back instead of leaving tombstones, and the slot arrays are
+* allocated once in the constructor, so insert and remove never allocate.
+*
+* The table is split into partitions by hash value, each with its own latch.
+* Every operation on an entry must be made while holding latch(file, pageNo)
+* for that entry; operations on different partitions may run concurrently.
+* BufMgr holds the latch across the lookup and the change to the frame it
+* finds, which is what makes pinning and eviction atomic.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Number of partitions (always a power of two)
 	 */
-  int HTSIZE;
+  std::uint32_t numPartitions;
+
 	/**
-	 * Actual Hash table object
+	 * Array of partitions
 	 */
-  hashBucket**  ht;
+  hashPartition*  partitions;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns the 64 bit hash of file and pageNo; the high half selects the
+	 * partition and the low half the slot within it
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  std::uint64_t hash(const File* file, const PageId pageNo) const;
+
+	/**
+	 * returns the partition holding (file, pageNo)
+	 */
+  hashPartition& partitionFor(const std::uint64_t hashValue) const
+  {
+    return partitions[(hashValue >> 32) & (numPartitions - 1)];
+  }
+
+	/**
+	 * returns how far the entry in slot index is from the slot it hashes to
+	 *
+	 * @param part   	Partition holding the entry
+	 * @param index  	Slot holding a valid entry
+	 * @return  			Probe distance of that entry.
+	 */
+  std::uint32_t probeDistance(const hashPartition& part, const std::uint32_t index) const;
+
+	/**
+	 * returns the slot of part holding (file, pageNo), or part.HTSIZE if there is none
+	 *
+	 * @param part   	Partition (file, pageNo) hashes to
+	 * @param hashValue	hash(file, pageNo)
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Slot index.
+	 */
+  std::uint32_t find(const hashPartition& part, const std::uint64_t hashValue,
+                     const File* file, const PageId pageNo) const;
+
+	/**
+	 * returns the number of entries each partition gets room for when the
+	 * table has to hold htSize entries
+	 */
+  std::uint32_t partitionEntries(const int htSize) const;
+
+	/**
+	 * returns the number of slots, a power of two, that holds maxEntries
+	 * entries at a load factor of at most 3/4
+	 */
+  static std::uint32_t slotsFor(const std::uint32_t maxEntries);
+
+	/**
+	 * gives part an empty slot array with room for maxEntries entries at a
+	 * load factor of at most 3/4
+	 */
+  static void allocateSlots(hashPartition& part, const std::uint32_t maxEntries);
+
+	/**
+	 * places an entry known not to be in part, which has a free slot
+	 *
+	 * @param part   	Partition the entry hashes to
+	 * @param hashValue	hash of the entry
+	 * @param entry  	Entry to place
+	 */
+  void place(hashPartition& part, const std::uint64_t hashValue, hashBucket entry);
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize  Maximum number of entries the table has to hold (the
+	 *                number of frames in the buffer pool); the slot arrays are
+	 *                sized so the load factor stays at or below 3/4.
+	 * @param partitionCount  Number of independently latched partitions,
+	 *                rounded up to a power of two.  With more than one
+	 *                partition each one gets room for 1.5 times its even share
+	 *                of htSize.
+	 */
+	BufHashTbl(const int htSize, const int partitionCount = 1);  // constructor
+
+	/**
+   * Returns the latch that must be held while operating on (file, pageNo).
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  std::mutex& latch(const File* file, const PageId pageNo)
+  {
+    return partitionFor(hash(file, pageNo)).latch;
+  }
+
+	/**
+   * Returns the hash of (file, pageNo).  The overloads below take it instead
+   * of hashing the key again, so a batch of operations hashes each key once.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  std::uint64_t hashOf(const File* file, const PageId pageNo) const
+  {
+    return hash(file, pageNo);
+  }
+
+	/**
+   * Returns the partition number of a key with the given hash; keys with the
+   * same partition number share a latch.
+	 */
+  std::uint32_t partitionOf(const std::uint64_t hashValue) const
+  {
+    return (hashValue >> 32) & (numPartitions - 1);
+  }
+
+	/**
+   * Returns the latch of a key with the given hash.
 	 */
-	BufHashTbl(const int htSize);  // constructor
+  std::mutex& latch(const std::uint64_t hashValue)
+  {
+    return partitionFor(hashValue).latch;
+  }
+
+	/**
+   * Resizes the table to hold htSize entries, as the constructor would have
+   * sized it, one partition at a time under its latch; other partitions stay
+   * usable meanwhile.  A partition never shrinks below the entries it holds.
+   * The caller must not hold any latch of the table.
+	 *
+	 * @param htSize  New maximum number of entries
+	 */
+  void resize(const int htSize);
 
 	/**
    * Destructor of BufHashTbl class
@@ -81,10 +244,16 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the partition of the entry is full
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
+	/**
+   * As insert() above, given hashValue == hashOf(file, pageNo).
+	 */
+  void insert(const std::uint64_t hashValue, const File* file, const PageId pageNo,
+              const FrameId frameNo);
+
 	/**
    * Check if (file, pageNo) is currently in the buffer pool (ie. in
    * the hash table).
@@ -96,6 +265,24 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table) without throwing when it is not.  A miss is the normal
+   * outcome on a cold pool, so BufMgr uses this rather than lookup().
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the entry is found
+   * @return True if the page entry was found, false otherwise
+	 */
+  bool probe(const File* file, const PageId pageNo, FrameId &frameNo);
+
+	/**
+   * As probe() above, given hashValue == hashOf(file, pageNo).
+	 */
+  bool probe(const std::uint64_t hashValue, const File* file, const PageId pageNo,
+             FrameId &frameNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -104,6 +291,15 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Delete entry (file,pageNo) from hash table if it is present.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+   * @return True if an entry was deleted, false if none was present
+	 */
+  bool erase(const File* file, const PageId pageNo);
 };
 
 }
@@ -0,0 +1,210 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "bufStats.h"
+
+namespace badgerdb {
+
+namespace {
+
+const char* COUNTER_NAMES[BUF_COUNTERS] = {
+  "hits", "misses", "allocs", "disk_reads", "disk_writes", "evictions",
+  "dirty_evictions", "pin_waits", "read_bytes", "written_bytes",
+  "mapped_pins"
+};
+
+const char* HISTOGRAM_NAMES[BUF_HISTOGRAMS] = {
+  "read_hit_latency_ns", "read_miss_latency_ns", "write_latency_ns", "sweep_length"
+};
+
+// Stripe of the calling thread, handed out round robin
+std::atomic<std::uint32_t> nextStripe(0);
+thread_local std::uint32_t threadStripe = ~0u;
+thread_local std::uint32_t hitsSinceSample = 0;
+
+// Writes a label value with backslashes, quotes and newlines escaped
+void writeLabel(std::ostream& out, const std::string& value)
+{
+  for (std::size_t i = 0; i < value.size(); i++) {
+    if (value[i] == '\\' || value[i] == '"')
+      out << '\\' << value[i];
+    else if (value[i] == '\n')
+      out << "\\n";
+    else
+      out << value[i];
+  }
+}
+
+}
+
+int Histogram::bucketOf(const std::uint64_t value)
+{
+  int bucket = 0;
+  for (std::uint64_t v = value; v != 0 && bucket < BUCKETS - 1; v >>= 1)
+    bucket++;
+  return bucket;
+}
+
+std::uint64_t Histogram::upperBound(const int bucket)
+{
+  return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+}
+
+std::uint64_t Histogram::percentile(const double q) const
+{
+  if (count == 0)
+    return 0;
+  const std::uint64_t rank = q >= 1 ? count : std::uint64_t(q * count) + 1;
+  std::uint64_t seen = 0;
+  for (int b = 0; b < BUCKETS; b++) {
+    seen += buckets[b];
+    if (seen >= rank)
+      return upperBound(b);
+  }
+  return upperBound(BUCKETS - 1);
+}
+
+void Histogram::clear()
+{
+  std::memset(buckets, 0, sizeof(buckets));
+  count = sum = 0;
+}
+
+double BufStats::hitRatio() const
+{
+  const std::uint64_t reads = counters[HITS] + counters[MISSES];
+  return reads ? double(counters[HITS]) / reads : 0;
+}
+
+void BufStats::exportText(std::ostream& out) const
+{
+  for (int c = 0; c < BUF_COUNTERS; c++) {
+    out << "# TYPE badgerdb_buffer_" << COUNTER_NAMES[c] << "_total counter\n"
+        << "badgerdb_buffer_" << COUNTER_NAMES[c] << "_total " << counters[c] << "\n";
+  }
+
+  for (int h = 0; h < BUF_HISTOGRAMS; h++) {
+    const Histogram& histogram = histograms[h];
+    const std::string name = std::string("badgerdb_buffer_") + HISTOGRAM_NAMES[h];
+    out << "# TYPE " << name << " histogram\n";
+    int last = Histogram::BUCKETS - 1;
+    while (last > 0 && histogram.buckets[last] == 0)
+      last--;
+    std::uint64_t cumulative = 0;
+    for (int b = 0; b <= last; b++) {
+      cumulative += histogram.buckets[b];
+      out << name << "_bucket{le=\"" << Histogram::upperBound(b) << "\"} " << cumulative << "\n";
+    }
+    out << name << "_bucket{le=\"+Inf\"} " << histogram.count << "\n"
+        << name << "_sum " << histogram.sum << "\n"
+        << name << "_count " << histogram.count << "\n";
+  }
+
+  const char* fileMetrics[] = {"file_reads", "file_writes", "file_evictions"};
+  for (int m = 0; m < 3; m++) {
+    out << "# TYPE badgerdb_buffer_" << fileMetrics[m] << "_total counter\n";
+    for (std::map<std::string, FileStats>::const_iterator it = files.begin();
+         it != files.end(); ++it) {
+      const std::uint64_t value = m == 0 ? it->second.reads
+                                : m == 1 ? it->second.writes : it->second.evictions;
+      out << "badgerdb_buffer_" << fileMetrics[m] << "_total{file=\"";
+      writeLabel(out, it->first);
+      out << "\"} " << value << "\n";
+    }
+  }
+}
+
+void BufStats::clear()
+{
+  accesses = diskreads = diskwrites = 0;
+  for (int c = 0; c < BUF_COUNTERS; c++)
+    counters[c] = 0;
+  for (int h = 0; h < BUF_HISTOGRAMS; h++)
+    histograms[h].clear();
+  files.clear();
+}
+
+BufStatsCollector::BufStatsCollector()
+{
+  clear();
+}
+
+BufStatsCollector::Stripe& BufStatsCollector::stripe()
+{
+  if (threadStripe == ~0u)
+    threadStripe = nextStripe.fetch_add(1, std::memory_order_relaxed);
+  return stripes[threadStripe % STRIPES];
+}
+
+void BufStatsCollector::record(const BufHistogram histogram, const std::uint64_t value)
+{
+  Stripe& s = stripe();
+  s.buckets[histogram][Histogram::bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  s.sums[histogram].fetch_add(value, std::memory_order_relaxed);
+}
+
+void BufStatsCollector::addFile(const std::string& name, const std::uint64_t reads,
+                                const std::uint64_t writes, const std::uint64_t evictions)
+{
+  std::lock_guard<std::mutex> guard(filesLatch);
+  FileStats& file = files[name];
+  file.reads += reads;
+  file.writes += writes;
+  file.evictions += evictions;
+}
+
+bool BufStatsCollector::sampleHit()
+{
+  if (++hitsSinceSample < HIT_SAMPLE_INTERVAL)
+    return false;
+  hitsSinceSample = 0;
+  return true;
+}
+
+void BufStatsCollector::snapshot(BufStats& stats) const
+{
+  stats.clear();
+  for (int s = 0; s < STRIPES; s++) {
+    const Stripe& stripe = stripes[s];
+    for (int c = 0; c < BUF_COUNTERS; c++)
+      stats.counters[c] += stripe.counters[c].load(std::memory_order_relaxed);
+    for (int h = 0; h < BUF_HISTOGRAMS; h++) {
+      Histogram& histogram = stats.histograms[h];
+      for (int b = 0; b < Histogram::BUCKETS; b++) {
+        const std::uint64_t n = stripe.buckets[h][b].load(std::memory_order_relaxed);
+        histogram.buckets[b] += n;
+        histogram.count += n;
+      }
+      histogram.sum += stripe.sums[h].load(std::memory_order_relaxed);
+    }
+  }
+  stats.accesses = stats.counters[HITS] + stats.counters[MISSES] + stats.counters[ALLOCS];
+  stats.diskreads = stats.counters[DISK_READS] + stats.counters[ALLOCS];
+  stats.diskwrites = stats.counters[DISK_WRITES];
+
+  std::lock_guard<std::mutex> guard(filesLatch);
+  stats.files = files;
+}
+
+void BufStatsCollector::clear()
+{
+  for (int s = 0; s < STRIPES; s++) {
+    Stripe& stripe = stripes[s];
+    for (int c = 0; c < BUF_COUNTERS; c++)
+      stripe.counters[c].store(0, std::memory_order_relaxed);
+    for (int h = 0; h < BUF_HISTOGRAMS; h++) {
+      for (int b = 0; b < Histogram::BUCKETS; b++)
+        stripe.buckets[h][b].store(0, std::memory_order_relaxed);
+      stripe.sums[h].store(0, std::memory_order_relaxed);
+    }
+  }
+  std::lock_guard<std::mutex> guard(filesLatch);
+  files.clear();
+}
+
+}
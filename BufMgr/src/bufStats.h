@@ -0,0 +1,256 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace badgerdb {
+
+/**
+* @brief Event counters kept by BufStatsCollector
+*/
+enum BufCounter {
+  HITS,             // readPage() and friends finding the page resident
+  MISSES,           // ... having to read it in
+  ALLOCS,           // pages allocated with allocPage()
+  DISK_READS,       // pages read from files, prefetches included
+  DISK_WRITES,      // pages written back
+  EVICTIONS,        // pages evicted to make room
+  DIRTY_EVICTIONS,  // ... of which had to be written back first
+  PIN_WAITS,        // pins that waited for another thread's read or write
+  BYTES_READ,
+  BYTES_WRITTEN,
+  MAPPED_PINS,      // pins of pages of mapped files, served from the mapping
+  BUF_COUNTERS
+};
+
+/**
+* @brief Distributions kept by BufStatsCollector
+*/
+enum BufHistogram {
+  HIT_LATENCY,      // ns per readPage() hit, sampled
+  MISS_LATENCY,     // ns per readPage() miss, read included
+  WRITE_LATENCY,    // ns per page write-back
+  SWEEP_LENGTH,     // clock hand steps per victim found
+  BUF_HISTOGRAMS
+};
+
+/**
+* @brief Distribution of values in power-of-two buckets
+*
+* Bucket 0 counts zeros and bucket b > 0 values from 2^(b-1) to 2^b - 1.
+*/
+struct Histogram
+{
+	/**
+   * Number of buckets, enough for 2^46 ns (about 20 hours)
+	 */
+  static const int BUCKETS = 48;
+
+  std::uint64_t buckets[BUCKETS];
+
+	/**
+   * Number and sum of the values
+	 */
+  std::uint64_t count;
+  std::uint64_t sum;
+
+	/**
+   * Returns the bucket value belongs in
+	 */
+  static int bucketOf(const std::uint64_t value);
+
+	/**
+   * Returns the largest value bucket counts
+	 */
+  static std::uint64_t upperBound(const int bucket);
+
+	/**
+   * Returns the upper bound of the bucket holding the q-quantile, for q from
+   * 0 to 1, or 0 if the histogram is empty
+	 */
+  std::uint64_t percentile(const double q) const;
+
+	/**
+   * Returns the mean of the values, 0 if there are none
+	 */
+  double mean() const { return count ? double(sum) / count : 0; }
+
+	/**
+   * Clear all values
+	 */
+  void clear();
+
+  Histogram() { clear(); }
+};
+
+/**
+* @brief I/O of one file through the buffer pool
+*/
+struct FileStats
+{
+  std::uint64_t reads;
+  std::uint64_t writes;
+  std::uint64_t evictions;
+
+  FileStats() : reads(0), writes(0), evictions(0) {}
+};
+
+/**
+* @brief Snapshot of buffer pool usage statistics, from BufMgr::getBufStats()
+*/
+struct BufStats
+{
+	/**
+   * Total number of accesses to buffer pool: hits, misses and allocations
+	 */
+  std::uint64_t accesses;
+
+	/**
+   * Number of pages read from disk (including allocs)
+	 */
+  std::uint64_t diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::uint64_t diskwrites;
+
+	/**
+   * Event counts, indexed by BufCounter
+	 */
+  std::uint64_t counters[BUF_COUNTERS];
+
+	/**
+   * Distributions, indexed by BufHistogram
+	 */
+  Histogram histograms[BUF_HISTOGRAMS];
+
+	/**
+   * Reads, writes and evictions per file name
+	 */
+  std::map<std::string, FileStats> files;
+
+	/**
+   * Returns the fraction of reads that hit, 0 if there were none
+	 */
+  double hitRatio() const;
+
+	/**
+   * Writes the statistics in the Prometheus text exposition format, one
+   * badgerdb_buffer_* metric per line, histograms with cumulative buckets.
+	 */
+  void exportText(std::ostream& out) const;
+
+	/**
+   * Clear all values
+	 */
+  void clear();
+
+	/**
+   * Constructor of BufStats class
+	 */
+  BufStats()
+  {
+		clear();
+  }
+};
+
+/**
+* @brief Counters a BufMgr updates on its hot paths
+*
+* Each thread updates one of STRIPES stripes of counters, chosen when it
+* first records something, so threads rarely share a cache line; snapshot()
+* adds the stripes up.  Updates are relaxed atomic adds, so a snapshot taken
+* while the pool is busy may be a little inconsistent across counters.
+* Per-file counts are kept under a latch, and only updated along with disk
+* I/O, whose cost dwarfs it.
+*/
+class BufStatsCollector
+{
+ private:
+	/**
+   * Counters of a group of threads, padded to keep stripes off each other's
+   * cache lines
+	 */
+  struct Stripe
+  {
+    std::atomic<std::uint64_t> counters[BUF_COUNTERS];
+    std::atomic<std::uint64_t> buckets[BUF_HISTOGRAMS][Histogram::BUCKETS];
+    std::atomic<std::uint64_t> sums[BUF_HISTOGRAMS];
+    char padding[64];
+  };
+
+  static const int STRIPES = 16;
+
+  Stripe stripes[STRIPES];
+
+	/**
+   * Counts per file name, guarded by filesLatch
+	 */
+  std::map<std::string, FileStats> files;
+  mutable std::mutex filesLatch;
+
+	/**
+   * Returns the stripe of the calling thread
+	 */
+  Stripe& stripe();
+
+  BufStatsCollector(const BufStatsCollector&);
+  BufStatsCollector& operator=(const BufStatsCollector&);
+
+ public:
+	/**
+   * Hit latency is timed for one hit in HIT_SAMPLE_INTERVAL per thread, so
+   * hits do not pay for reading the clock
+	 */
+  static const std::uint32_t HIT_SAMPLE_INTERVAL = 64;
+
+  BufStatsCollector();
+
+	/**
+   * Adds n to a counter
+	 */
+  void add(const BufCounter counter, const std::uint64_t n = 1)
+  {
+    stripe().counters[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+
+	/**
+   * Adds a value to a histogram
+	 */
+  void record(const BufHistogram histogram, const std::uint64_t value);
+
+	/**
+   * Adds to the counts of a file
+	 */
+  void addFile(const std::string& name, const std::uint64_t reads,
+               const std::uint64_t writes, const std::uint64_t evictions);
+
+	/**
+   * Returns true for the hits of the calling thread that are to be timed
+	 */
+  static bool sampleHit();
+
+	/**
+   * Adds up all stripes into stats
+	 */
+  void snapshot(BufStats& stats) const;
+
+	/**
+   * Zeroes every counter
+	 */
+  void clear();
+};
+
+}
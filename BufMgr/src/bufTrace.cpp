@@ -0,0 +1,246 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "bufTrace.h"
+
+namespace badgerdb {
+
+namespace {
+
+const char* KIND_NAMES[TRACE_KINDS] = {
+  "pin", "unpin", "hit", "miss", "evict", "sweep", "write-back",
+  "file-read", "file-write", "file-alloc"
+};
+
+// Written at the start of saved traces
+const char TRACE_MAGIC[8] = {'B', 'D', 'B', 'T', 'R', 'C', '0', '1'};
+
+/**
+ * Events of one thread at a time.  Only the owning thread writes events and
+ * head; head counts events ever written, so the ring holds the last
+ * min(head, RING_EVENTS) of them.
+ */
+struct Ring
+{
+  TraceEvent events[BufTrace::RING_EVENTS];
+  std::atomic<std::uint64_t> head;
+  std::uint32_t thread;
+  bool owned;
+};
+
+// Every ring ever made, and the threads given one, guarded by ringsLatch;
+// rings are never freed
+std::mutex ringsLatch;
+std::vector<Ring*> rings;
+std::uint32_t threadCount = 0;
+
+// Clock ticks and steady clock nanoseconds when the first ring was made,
+// guarded by ringsLatch; events() converts ticks to time from there
+std::uint64_t originTicks = 0;
+std::uint64_t originNanos = 0;
+
+std::uint64_t steadyNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Ring of the calling thread, NULL until its first event
+thread_local Ring* threadRing = NULL;
+
+/**
+ * Gives the calling thread a ring on its first event, and gives it back
+ * when the thread exits.
+ */
+struct RingOwner
+{
+  Ring* ring;
+
+  RingOwner() : ring(NULL) {}
+
+  ~RingOwner()
+  {
+    if (ring != NULL) {
+      std::lock_guard<std::mutex> guard(ringsLatch);
+      ring->owned = false;
+    }
+  }
+};
+
+thread_local RingOwner owner;
+
+Ring& acquireRing()
+{
+  std::lock_guard<std::mutex> guard(ringsLatch);
+  Ring* ring = NULL;
+  for (std::size_t i = 0; i < rings.size() && ring == NULL; i++) {
+    if (!rings[i]->owned)
+      ring = rings[i];
+  }
+  if (ring == NULL) {
+    if (rings.empty()) {
+      originTicks = BufTrace::now();
+      originNanos = steadyNanos();
+    }
+    ring = new Ring;
+    ring->head = 0;
+    rings.push_back(ring);
+  }
+  ring->owned = true;
+  ring->thread = ++threadCount;
+  // owner is only touched here, so the fast path needs no TLS init check
+  owner.ring = ring;
+  threadRing = ring;
+  return *ring;
+}
+
+}
+
+std::atomic<bool> BufTrace::recording(false);
+
+void BufTrace::enable(const bool on)
+{
+  recording = on;
+}
+
+std::uint64_t BufTrace::now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return steadyNanos();
+#endif
+}
+
+void BufTrace::record(const TraceKind kind, const std::uint64_t start,
+                      const PageId pageNo, const std::uint32_t frame)
+{
+  Ring& ring = threadRing ? *threadRing : acquireRing();
+  const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+  TraceEvent& event = ring.events[head & (RING_EVENTS - 1)];
+  if (start == 0) {
+    event.start = now();
+    event.duration = 0;
+  } else {
+    event.start = start;
+    event.duration = std::min<std::uint64_t>(now() - start, ~0u);
+  }
+  event.pageNo = pageNo;
+  event.frame = frame;
+  event.kind = kind;
+  event.reserved = 0;
+  event.thread = ring.thread;
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void BufTrace::events(std::vector<TraceEvent>& out)
+{
+  out.clear();
+  {
+    std::lock_guard<std::mutex> guard(ringsLatch);
+    for (std::size_t r = 0; r < rings.size(); r++) {
+      const Ring& ring = *rings[r];
+      const std::uint64_t head = ring.head.load(std::memory_order_acquire);
+      const std::uint64_t first = head > RING_EVENTS ? head - RING_EVENTS : 0;
+      for (std::uint64_t i = first; i < head; i++)
+        out.push_back(ring.events[i & (RING_EVENTS - 1)]);
+    }
+
+    // from clock ticks to nanoseconds, at the rate seen since the first ring
+    const std::uint64_t ticks = now() - originTicks;
+    const std::uint64_t nanos = steadyNanos() - originNanos;
+    const double rate = ticks ? double(nanos) / ticks : 1;
+    for (std::size_t i = 0; i < out.size(); i++) {
+      out[i].start = originNanos + std::int64_t(double(std::int64_t(out[i].start - originTicks)) * rate);
+      out[i].duration = std::uint32_t(out[i].duration * rate);
+    }
+  }
+  std::stable_sort(out.begin(), out.end(), [](const TraceEvent& a, const TraceEvent& b) {
+      return a.start < b.start;
+    });
+}
+
+void BufTrace::clear()
+{
+  std::lock_guard<std::mutex> guard(ringsLatch);
+  for (std::size_t r = 0; r < rings.size(); r++)
+    rings[r]->head = 0;
+}
+
+bool BufTrace::save(const std::string& path)
+{
+  std::vector<TraceEvent> recorded;
+  events(recorded);
+  std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  if (!recorded.empty())
+    out.write(reinterpret_cast<const char*>(&recorded[0]), recorded.size() * sizeof(TraceEvent));
+  return bool(out);
+}
+
+bool BufTrace::load(const std::string& path, std::vector<TraceEvent>& out)
+{
+  out.clear();
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char magic[sizeof(TRACE_MAGIC)];
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0)
+    return false;
+  TraceEvent event;
+  while (in.read(reinterpret_cast<char*>(&event), sizeof(event)))
+    out.push_back(event);
+  return in.eof() && in.gcount() == 0;
+}
+
+void BufTrace::writeChromeJson(const std::vector<TraceEvent>& events, std::ostream& out)
+{
+  const std::uint64_t origin = events.empty() ? 0 : events[0].start;
+  const std::ios::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  // microseconds, to the nanosecond
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (std::size_t i = 0; i < events.size(); i++) {
+    const TraceEvent& event = events[i];
+    const double ts = double(event.start - origin) / 1000;
+    out << (i ? ",\n" : "\n") << "{\"name\":\"" << kindName(event.kind)
+        << "\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << ts;
+    if (event.duration != 0 || (event.kind != TRACE_UNPIN && event.kind != TRACE_HIT &&
+                                event.kind != TRACE_EVICT))
+      out << ",\"ph\":\"X\",\"dur\":" << double(event.duration) / 1000;
+    else
+      out << ",\"ph\":\"i\",\"s\":\"t\"";
+    out << ",\"args\":{";
+    const char* separator = "";
+    if (event.pageNo != TraceEvent::NONE) {
+      out << "\"page\":" << event.pageNo;
+      separator = ",";
+    }
+    if (event.frame != TraceEvent::NONE)
+      out << separator << (event.kind == TRACE_FILE_READ || event.kind == TRACE_FILE_WRITE ||
+                               event.kind == TRACE_PIN ? "\"pages\":" : "\"frame\":") << event.frame;
+    out << "}}";
+  }
+  out << "\n]}\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+
+const char* BufTrace::kindName(const std::uint16_t kind)
+{
+  return kind < TRACE_KINDS ? KIND_NAMES[kind] : "unknown";
+}
+
+}
@@ -0,0 +1,203 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Kinds of events BufTrace records
+*/
+enum TraceKind {
+  TRACE_PIN,          // span: a batch pinned by readPages(); frame holds the page count
+  TRACE_UNPIN,
+  TRACE_HIT,          // readPage()/pinPage() finding the page resident
+  TRACE_MISS,         // span: readPage()/pinPage() missing, until the page is read in
+  TRACE_EVICT,        // a victim evicted, after its write-back if it was dirty
+  TRACE_SWEEP,        // span: looking for a victim, evicting it included
+  TRACE_WRITE_BACK,   // span: a page written back by the buffer manager
+  TRACE_FILE_READ,    // span: File reading pages; frame holds the page count
+  TRACE_FILE_WRITE,   // span: File writing a page, or a run; frame holds a run's page count
+  TRACE_FILE_ALLOC,   // span: File allocating a page
+  TRACE_KINDS
+};
+
+/**
+* @brief One traced event, as kept in the rings and in saved traces
+*/
+struct TraceEvent
+{
+	/**
+   * Start and duration in clock ticks in the rings, and in nanoseconds of
+   * the steady clock once copied out by BufTrace::events(); duration is 0
+   * for instants
+	 */
+  std::uint64_t start;
+  std::uint32_t duration;
+
+	/**
+   * Page and frame the event is about; NONE where there is none
+	 */
+  PageId pageNo;
+  std::uint32_t frame;
+
+	/**
+   * TraceKind of the event
+	 */
+  std::uint16_t kind;
+  std::uint16_t reserved;
+
+	/**
+   * Thread that recorded the event, numbered from 1 in order of first event
+	 */
+  std::uint32_t thread;
+
+  static const std::uint32_t NONE = ~0u;
+};
+
+/**
+* @brief Per-thread rings of timestamped events from BufMgr and File
+*
+* Compiled in only with -DBADGERDB_TRACE (make TRACE=1); otherwise the
+* BUF_TRACE_* macros expand to nothing and cost nothing.  When compiled in,
+* recording is still off until enable(true).
+*
+* Each thread writes its own ring of RING_EVENTS events, overwriting its
+* oldest ones, with no locks or atomic read-modify-writes; a lock is only
+* taken the first time a thread records an event, to register its ring.
+* Rings outlive their threads and are handed to new threads, so a dump
+* still holds what exited threads recorded.  Events recorded while events()
+* copies the rings may come out torn, so take dumps when the pool is quiet
+* or ignore the newest events.
+*/
+class BufTrace
+{
+ private:
+	/**
+   * True while events are being recorded
+	 */
+  static std::atomic<bool> recording;
+
+ public:
+	/**
+   * Events kept per thread; a power of two
+	 */
+  static const std::uint32_t RING_EVENTS = 1 << 16;
+
+	/**
+   * Turns recording on or off
+	 */
+  static void enable(const bool on);
+
+	/**
+   * Returns true if events are being recorded
+	 */
+  static bool enabled() { return recording.load(std::memory_order_relaxed); }
+
+	/**
+   * Returns the clock events are timed with: the time stamp counter on x86,
+   * which is cheaper to read than the steady clock, and the steady clock in
+   * nanoseconds elsewhere
+	 */
+  static std::uint64_t now();
+
+	/**
+   * Records an event that started at start and lasted until now, or an
+   * instant if start is 0
+	 */
+  static void record(const TraceKind kind, const std::uint64_t start,
+                     const PageId pageNo, const std::uint32_t frame);
+
+	/**
+   * Copies the events of all rings, ordered by start
+	 */
+  static void events(std::vector<TraceEvent>& out);
+
+	/**
+   * Drops all recorded events
+	 */
+  static void clear();
+
+	/**
+   * Writes the recorded events to a file, for tools/traceDump to convert
+   *
+   * @return False if the file could not be written
+	 */
+  static bool save(const std::string& path);
+
+	/**
+   * Reads events written by save()
+   *
+   * @return False if the file could not be read or is not a trace
+	 */
+  static bool load(const std::string& path, std::vector<TraceEvent>& out);
+
+	/**
+   * Writes events in the Chrome trace event JSON format, for
+   * chrome://tracing or Perfetto; spans become complete ("X") events and
+   * instants thread-scoped instant ("i") events.
+	 */
+  static void writeChromeJson(const std::vector<TraceEvent>& events, std::ostream& out);
+
+	/**
+   * Returns the name of a kind of event
+	 */
+  static const char* kindName(const std::uint16_t kind);
+};
+
+/**
+* @brief Records a span from its construction to its destruction
+*/
+class TraceScope
+{
+ private:
+  TraceKind kind;
+  std::uint64_t start;
+  PageId pageNo;
+
+ public:
+	/**
+   * Frame to record, which may be set once it is known
+	 */
+  std::uint32_t frame;
+
+  TraceScope(const TraceKind kind, const PageId pageNo, const std::uint32_t frame)
+    : kind(kind), start(BufTrace::enabled() ? BufTrace::now() : 0), pageNo(pageNo), frame(frame)
+  {
+  }
+
+  ~TraceScope()
+  {
+    if (start != 0)
+      BufTrace::record(kind, start, pageNo, frame);
+  }
+};
+
+}
+
+#ifdef BADGERDB_TRACE
+#define BUF_TRACE_EVENT(kind, pageNo, frame) \
+  do { \
+    if (::badgerdb::BufTrace::enabled()) \
+      ::badgerdb::BufTrace::record(kind, 0, pageNo, frame); \
+  } while (0)
+#define BUF_TRACE_SCOPE(name, kind, pageNo, frame) \
+  ::badgerdb::TraceScope name(kind, pageNo, frame)
+#define BUF_TRACE_FRAME(name, value) ((name).frame = (value))
+#else
+#define BUF_TRACE_EVENT(kind, pageNo, frame) do {} while (0)
+#define BUF_TRACE_SCOPE(name, kind, pageNo, frame) do {} while (0)
+#define BUF_TRACE_FRAME(name, value) do {} while (0)
+#endif
@@ -5,226 +5,1899 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <iostream>
+#include <thread>
 #include "buffer.h"
+#include "bufTrace.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/file_read_only_exception.h"
 
 namespace badgerdb { 
 
-  BufMgr::BufMgr(std::uint32_t bufs)
-    : numBufs(bufs) {
-    bufDescTable = new BufDesc[bufs];
+  namespace {
 
-    for (FrameId i = 0; i < bufs; i++) 
+    // Partitions of the hash table: enough to spread latch contention, but
+    // each large enough that entries spread evenly over them.
+    int hashPartitions(std::uint32_t bufs)
+    {
+      int partitions = 1;
+      while (partitions < 64 && bufs / (partitions * 2) >= 512)
+	partitions *= 2;
+      return partitions;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::uint64_t nanosSince(const Clock::time_point start)
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    // Files whose access patterns one access partition keeps track of at a
+    // time
+    const std::size_t maxTrackedFiles = 4;
+
+    // Pages a miss may skip and still continue a sequential run; a scan
+    // skips the pages it finds already resident
+    const PageId maxRunGap = 8;
+
+    // Pages warmUp() reads per batch, at most; each batch is read in file
+    // and page order
+    const std::size_t warmUpBatch = 256;
+
+    // Hashes each page of a batch once and returns the batch indexes grouped
+    // by hash table partition, as (partition << 32 | index) so that plain
+    // integer order is the grouping; batches are usually in order already.
+    void partitionOrder(const BufHashTbl& table, const File* file,
+			const std::vector<PageId>& pageNos,
+			std::vector<std::uint64_t>& hashes, std::vector<std::uint64_t>& order)
+    {
+      const std::size_t count = pageNos.size();
+      hashes.resize(count);
+      order.resize(count);
+      bool sorted = true;
+      for(std::size_t i = 0; i < count; i++) {
+	hashes[i] = table.hashOf(file, pageNos[i]);
+	order[i] = std::uint64_t(table.partitionOf(hashes[i])) << 32 | i;
+	sorted = sorted && (i == 0 || order[i - 1] < order[i]);
+      }
+      if(!sorted) {
+	std::sort(order.begin(), order.end());
+      }
+    }
+
+  }
+
+  thread_local std::uint32_t BufMgr::Shard::sweepSteps = 0;
+
+  BufMgr::BufMgr(std::uint32_t bufs, const BufMgrOptions& options)
+    : numBufs(bufs), maxBufs(std::max(bufs, options.maxBufs)),
+      residentLinks(maxBufs), dirtyLinks(maxBufs), writerStop(false),
+      cleanFrameTarget(std::min(options.cleanFrameTarget, bufs)),
+      writerIntervalMs(options.writerIntervalMs),
+      prefetchThreads(std::max<std::uint32_t>(1, options.prefetchThreads)),
+      prefetchStop(false), warmUpStop(false), warmUpPath(options.warmUpPath) {
+    bufDescTable = new BufDesc[maxBufs];
+
+    for (FrameId i = 0; i < maxBufs; i++) 
       {
   	bufDescTable[i].frameNo = i;
   	bufDescTable[i].valid = false;
       }
 
-    bufPool = new Page[bufs];
+    // a power of two, each shard with at least one frame
+    std::uint32_t shardCount = options.shards != 0 ? options.shards : topology.groupCount();
+    std::uint32_t count = 1;
+    while (count * 2 <= shardCount && count * 2 <= maxBufs)
+      count *= 2;
+    shardFrames = (maxBufs + count - 1) / count;
+    while (count > 1 && (count - 1) * shardFrames >= maxBufs) {
+      count /= 2;
+      shardFrames = (maxBufs + count - 1) / count;
+    }
+
+    frameArena = new FrameArena(maxBufs, options.pageBacking);
+    bufPool = frameArena->frames();
+
+    // every partition belongs to one shard
+    hashTable = new BufHashTbl (bufs, std::max<int>(hashPartitions(maxBufs), count));  // allocate the buffer hash table
+
+    shards.resize(count);
+    std::vector<std::uint32_t> targets;
+    shardTargets(bufs, targets);
+    for (std::uint32_t s = 0; s < count; s++) {
+      shards[s] = new Shard(*this, s * shardFrames, std::min(shardFrames, maxBufs - s * shardFrames),
+			    targets[s], options.policy, s % topology.groupCount());
+      touchFrames(*shards[s], shards[s] -> freeFrames);
+    }
 
-    int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-    hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+    // rings must leave most of the pool to everybody else
+    ringOptions[0] = options.scanRingFrames;
+    ringOptions[1] = options.bulkWriteRingFrames;
+    ringFrames[0] = std::min(ringOptions[0], bufs / 8);
+    ringFrames[1] = std::min(ringOptions[1], bufs / 8);
+    sequentialRunLength = options.sequentialRunLength;
 
-    clockHand = bufs - 1;
+    if(options.backgroundWriter && cleanFrameTarget > 0) {
+      writerThread = std::thread(&BufMgr::runWriter, this);
+    }
   }
 
   BufMgr::~BufMgr() {
-    for(FrameId i = 0; i < numBufs; i++) {
-      if(bufDescTable[i].dirty) {
-	// flush file containing page
-	// page validity checked in flushFile()
-	flushFile(bufDescTable[i].file); 
+    stopWarmUp();
+    {
+      std::lock_guard<std::mutex> guard(prefetchLatch);
+      prefetchStop = true;
+    }
+    prefetchWake.notify_all();
+    for(std::size_t i = 0; i < prefetchers.size(); i++) {
+      prefetchers[i].join();
+    }
+
+    if(writerThread.joinable()) {
+      {
+	std::lock_guard<std::mutex> guard(writerLatch);
+	writerStop = true;
+      }
+      writerWake.notify_one();
+      writerThread.join();
+    }
+
+    // what is resident now is what the next pool should start with
+    if(!warmUpPath.empty()) {
+      saveResidentPages(warmUpPath);
+    }
+
+    // flush every file with dirty pages; page validity checked in flushFile()
+    std::vector<const File*> dirtyFiles;
+    for(std::map<const File*, FileFrames>::const_iterator it = fileFrames.begin();
+	it != fileFrames.end(); ++it) {
+      if(!it -> second.dirty.empty()) {
+	dirtyFiles.push_back(it -> first);
       }
     }
+    for(std::size_t i = 0; i < dirtyFiles.size(); i++) {
+      flushFile(dirtyFiles[i]);
+    }
 
     delete[] bufDescTable;
-    delete[] bufPool;
+    delete frameArena;
     delete hashTable;
+    for(std::size_t s = 0; s < shards.size(); s++) {
+      delete shards[s];
+    }
+  }
+
+  BufMgr::Shard::Shard(BufMgr& mgr, const FrameId first, const std::uint32_t frames,
+		       const std::uint32_t bufs, const ReplacementPolicyKind kind,
+		       const std::uint32_t group)
+    : mgr(mgr), first(first), frames(frames), numBufs(bufs), group(group), freeCount(bufs)
+  {
+    // hand out low frames first
+    freeFrames.reserve(bufs);
+    for (FrameId i = first + bufs; i > first; i--)
+      freeFrames.push_back(i - 1);
+    retiredFrames.reserve(frames - bufs);
+    for (FrameId i = first + frames; i > first + bufs; i--) {
+      retiredFrames.push_back(i - 1);
+      mgr.bufDescTable[i - 1].retired = true;
+    }
+
+    policy = ReplacementPolicy::create(kind, frames);
+    if (frames != bufs)
+      poolResized();
+  }
+
+  BufMgr::Shard::~Shard()
+  {
+    delete policy;
+  }
+
+  bool BufMgr::Shard::takeFree(FrameId& frame)
+  {
+    if(freeCount == 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> guard(freeLatch);
+    if(freeFrames.empty()) {
+      return false;
+    }
+    frame = freeFrames.back();
+    freeFrames.pop_back();
+    freeCount--;
+    mgr.bufDescTable[frame].Clear();
+    mgr.bufDescTable[frame].pinCnt = 1;
+    return true;
+  }
+
+  bool BufMgr::Shard::evict(FrameId& frame, const File* file, const PageId pageNo)
+  {
+    FrameId victim;
+    BUF_TRACE_SCOPE(trace, TRACE_SWEEP, pageNo, TraceEvent::NONE);
+    sweepSteps = 0;
+    const bool found = policy -> chooseVictim(*this, file, pageNo, victim);
+    // only the clock policy sweeps
+    if(sweepSteps != 0) {
+      mgr.bufStats.record(SWEEP_LENGTH, sweepSteps);
+    }
+    if(!found) {
+      return false;
+    }
+    frame = first + victim;
+    BUF_TRACE_FRAME(trace, frame);
+    return true;
+  }
+
+  void BufMgr::Shard::poolResized()
+  {
+    // retiredFrames is in descending order, so walk it from the back
+    std::vector<FrameId> inPool;
+    inPool.reserve(numBufs);
+    std::vector<FrameId>::const_reverse_iterator retired = retiredFrames.rbegin();
+    for (FrameId i = 0; i < frames; i++) {
+      if (retired != retiredFrames.rend() && *retired == first + i) {
+	++retired;
+      } else {
+	inPool.push_back(i);
+      }
+    }
+    policy -> poolResized(inPool);
+  }
+
+  void BufMgr::Shard::take(const std::uint32_t count, std::vector<FrameId>& frames)
+  {
+    std::uint32_t taken = 0;
+    {
+      std::lock_guard<std::mutex> guard(freeLatch);
+      taken = std::min<std::size_t>(freeFrames.size(), count);
+      frames.insert(frames.end(), freeFrames.end() - taken, freeFrames.end());
+      freeFrames.resize(freeFrames.size() - taken);
+      freeCount -= taken;
+    }
+    FrameId frame;
+    for(; taken < count && evict(frame, NULL, Page::INVALID_NUMBER); taken++) {
+      frames.push_back(frame);
+    }
+  }
+
+  void BufMgr::Shard::upcomingVictims(const std::uint32_t count, std::vector<FrameId>& frames)
+  {
+    const std::size_t start = frames.size();
+    policy -> upcomingVictims(*this, count + start, frames);
+    for(std::size_t i = start; i < frames.size(); i++) {
+      frames[i] += first;
+    }
+  }
+
+  void BufMgr::shardTargets(const std::uint32_t total, std::vector<std::uint32_t>& targets) const
+  {
+    // even shares first; only the last shard can be short of room
+    const std::uint32_t count = shards.size();
+    targets.assign(count, 0);
+    std::uint32_t left = total;
+    for(std::uint32_t s = 0; s < count; s++) {
+      const std::uint32_t room = std::min(shardFrames, maxBufs - s * shardFrames);
+      targets[s] = std::min(room, total / count + (s < total % count ? 1 : 0));
+      left -= targets[s];
+    }
+    for(std::uint32_t s = 0; s < count && left > 0; s++) {
+      const std::uint32_t room = std::min(shardFrames, maxBufs - s * shardFrames);
+      const std::uint32_t more = std::min(left, room - targets[s]);
+      targets[s] += more;
+      left -= more;
+    }
+  }
+
+  void BufMgr::touchFrames(const Shard& shard, const std::vector<FrameId>& frames)
+  {
+    if(!topology.numa() || frames.empty()) {
+      return;
+    }
+    std::thread toucher([this, &shard, &frames]() {
+      topology.runOn(shard.group);
+      for(std::size_t i = 0; i < frames.size(); i++) {
+	std::memset(static_cast<void*>(bufPool + frames[i]), 0, Page::SIZE);
+      }
+    });
+    toucher.join();
   }
 
-  void BufMgr::advanceClock()
+  void BufMgr::pageMapped(const FrameId frame, const File* file, const PageId pageNo,
+			  const bool cold)
   {
-    //advance clock
-    //if goes out of bounds, cycle back
-    clockHand++;
-    clockHand = clockHand % numBufs;
+    shardOf(frame).loaded(frame, file, pageNo, cold);
+    std::lock_guard<std::mutex> guard(fileFramesLatch);
+    fileFrames[file].resident.pushFront(residentLinks, frame);
+  }
+
+  void BufMgr::pageUnmapped(const FrameId frame, const File* file, const PageId pageNo,
+			    const bool evicted)
+  {
+    shardOf(frame).removed(frame, file, pageNo, evicted);
+    const bool dirty = bufDescTable[frame].dirty.exchange(false);
+    std::lock_guard<std::mutex> guard(fileFramesLatch);
+    std::map<const File*, FileFrames>::iterator it = fileFrames.find(file);
+    it -> second.resident.remove(residentLinks, frame);
+    if(dirty) {
+      it -> second.dirty.remove(dirtyLinks, frame);
+    }
+    if(it -> second.resident.empty()) {
+      fileFrames.erase(it);
+    }
   }
 
-  void BufMgr::allocBuf(FrameId & frame) 
+  void BufMgr::setDirty(const FrameId frame, const bool dirty)
   {
-    // cycle at most twice for pages with refbit==true
-    for(uint32_t i = 0; i < 2*numBufs; i++) {
-      advanceClock();
+    BufDesc& desc = bufDescTable[frame];
+    if(desc.dirty.exchange(dirty) == dirty) {
+      return;
+    }
+    std::lock_guard<std::mutex> guard(fileFramesLatch);
+    FileFrames& frames = fileFrames[desc.file];
+    if(dirty) {
+      frames.dirty.pushFront(dirtyLinks, frame);
+    } else {
+      frames.dirty.remove(dirtyLinks, frame);
+    }
+  }
 
-      //if the frame is not valid
-      if(!(bufDescTable[clockHand].valid)) {
-	//return
-	frame = clockHand;
+  void BufMgr::residentFrames(const File* file,
+			      std::vector<std::pair<PageId, FrameId> >& frames)
+  {
+    frames.clear();
+    {
+      std::lock_guard<std::mutex> guard(fileFramesLatch);
+      std::map<const File*, FileFrames>::const_iterator it = fileFrames.find(file);
+      if(it == fileFrames.end()) {
 	return;
       }
-          
-      // clear refbit
-      if(bufDescTable[clockHand].refbit) {
-	bufDescTable[clockHand].refbit = false;
-	continue;
+      frames.reserve(it -> second.resident.size());
+      for(FrameId i = it -> second.resident.front(); i != IndexLinks::NONE;
+	  i = residentLinks.next[i]) {
+	frames.push_back(std::make_pair(PageId(bufDescTable[i].pageNo), i));
       }
-      else {
-	// if not pinned
-	if(bufDescTable[clockHand].pinCnt == 0) {
-	  // if dirty
-	  if(bufDescTable[clockHand].dirty) {
-            //write page back
-	    bufDescTable[clockHand].file -> writePage(bufPool[clockHand]);
-	  }
-	  //remove from hash table
-	  try {
-	    hashTable -> remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-	  } catch(HashNotFoundException e) {
-	    //do nothing
-	  }
-          //return frame
-	  frame = clockHand;
-	  return;
-	}
+    }
+    std::sort(frames.begin(), frames.end());
+  }
+
+  void BufMgr::releaseFrame(const FrameId frame)
+  {
+    bufDescTable[frame].Clear();
+    Shard& shard = shardOf(frame);
+    std::lock_guard<std::mutex> guard(shard.freeLatch);
+    shard.freeFrames.push_back(frame);
+    shard.freeCount++;
+  }
+
+  void BufMgr::allocBuf(FrameId & frame, const File* file, const PageId pageNo) 
+  {
+    // the page's own shard first; a page number not known yet goes to the
+    // shard local to the caller
+    const std::uint32_t mask = shards.size() - 1;
+    const std::uint32_t home = file != NULL && pageNo != Page::INVALID_NUMBER ?
+      shardFor(file, pageNo) : homeShard();
+
+    // use a frame nobody has touched yet, if there is one
+    if(takeFreeBuf(frame, file, pageNo)) {
+      return;
+    }
+
+    // otherwise have the replacement policy evict a page
+    for(std::uint32_t i = 0; i <= mask; i++) {
+      if(shards[(home + i) & mask] -> evict(frame, file, pageNo)) {
+	return;
       }
     }
     //too many allocations	  
     throw BufferExceededException();
   }
 
-  void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+  bool BufMgr::takeFreeBuf(FrameId & frame, const File* file, const PageId pageNo)
   {
-    // frame id
-    FrameId frame;
+    const std::uint32_t mask = shards.size() - 1;
+    const std::uint32_t home = file != NULL && pageNo != Page::INVALID_NUMBER ?
+      shardFor(file, pageNo) : homeShard();
+    for(std::uint32_t i = 0; i <= mask; i++) {
+      if(shards[(home + i) & mask] -> takeFree(frame)) {
+	return true;
+      }
+    }
+    return false;
+  }
+
+  void BufMgr::allocRingBuf(FrameId & frame, const File* file, const PageId pageNo,
+			    const AccessStrategy strategy)
+  {
+    const int r = strategy == BULK_WRITE ? 1 : 0;
+    if(ringFrames[r] == 0) {
+      allocBuf(frame, file, pageNo);
+      return;
+    }
+
+    // take the next slot of the ring; the ring fills up before it is recycled
+    std::uint32_t slot;
+    bool recycle = false;
+    FrameId candidate = 0;
+    PageId candidatePage = Page::INVALID_NUMBER;
+    AccessPartition& partition = accessPartitionOf(file);
+    {
+      std::lock_guard<std::mutex> guard(partition.latch);
+      if(partition.files.size() >= maxTrackedFiles &&
+	 partition.files.find(file) == partition.files.end()) {
+	partition.files.clear();
+      }
+      AccessRing& ring = partition.files[file].rings[r];
+      if(ring.frames.size() < ringFrames[r]) {
+	slot = ring.frames.size();
+	ring.frames.push_back(0);
+	ring.pages.push_back(PageId(Page::INVALID_NUMBER));
+      } else {
+	slot = ring.next;
+	ring.next = (ring.next + 1) % ring.frames.size();
+	candidate = ring.frames[slot];
+	candidatePage = ring.pages[slot];
+	recycle = true;
+      }
+    }
+
+    // a frame that was evicted and given to another page, or whose page
+    // somebody else pinned since, is left alone; it is theirs now
+    BufDesc& desc = bufDescTable[candidate];
+    if(!(recycle && desc.valid && desc.file == file && candidatePage != Page::INVALID_NUMBER &&
+	 desc.pageNo == candidatePage && !desc.refbit && desc.pinCnt == 0 &&
+	 tryEvict(candidate))) {
+      allocBuf(frame, file, pageNo);
+      candidate = frame;
+    }
+    frame = candidate;
+
+    std::lock_guard<std::mutex> guard(partition.latch);
+    AccessRing& ring = partition.files[file].rings[r];
+    if(slot < ring.frames.size()) {
+      ring.frames[slot] = frame;
+      ring.pages[slot] = pageNo;
+    }
+  }
+
+  void BufMgr::ringPageSet(const File* file, const FrameId frame, const PageId pageNo,
+			   const AccessStrategy strategy)
+  {
+    AccessPartition& partition = accessPartitionOf(file);
+    std::lock_guard<std::mutex> guard(partition.latch);
+    std::map<const File*, FileAccess>::iterator it = partition.files.find(file);
+    if(it == partition.files.end()) {
+      return;
+    }
+    AccessRing& ring = it -> second.rings[strategy == BULK_WRITE ? 1 : 0];
+    for(std::uint32_t i = 0; i < ring.frames.size(); i++) {
+      if(ring.frames[i] == frame) {
+	ring.pages[i] = pageNo;
+	return;
+      }
+    }
+  }
+
+  AccessStrategy BufMgr::detectStrategy(const File* file, const PageId pageNo)
+  {
+    if(sequentialRunLength == 0) {
+      return NORMAL_ACCESS;
+    }
+    AccessPartition& partition = accessPartitionOf(file);
+    std::lock_guard<std::mutex> guard(partition.latch);
+    if(partition.files.size() >= maxTrackedFiles &&
+       partition.files.find(file) == partition.files.end()) {
+      partition.files.clear();
+    }
+    FileAccess& access = partition.files[file];
+    if(pageNo > access.lastMiss && pageNo <= access.lastMiss + maxRunGap) {
+      access.run++;
+    } else if(pageNo != access.lastMiss) {
+      access.run = 0;
+    }
+    access.lastMiss = pageNo;
+    return access.run >= sequentialRunLength ? SEQUENTIAL_SCAN : NORMAL_ACCESS;
+  }
+
+  bool BufMgr::isResident(const FrameId frame) const
+  {
+    return bufDescTable[frame].valid;
+  }
+
+  bool BufMgr::isPinned(const FrameId frame) const
+  {
+    return bufDescTable[frame].pinCnt != 0;
+  }
+
+  bool BufMgr::isReferenced(const FrameId frame) const
+  {
+    return bufDescTable[frame].refbit;
+  }
+
+  bool BufMgr::clearReferenced(const FrameId frame)
+  {
+    return bufDescTable[frame].refbit.exchange(false);
+  }
+
+  bool BufMgr::tryEvict(const FrameId frame)
+  {
+    BufDesc& desc = bufDescTable[frame];
+    File* file = desc.file;
+    const PageId pageNo = desc.pageNo;
+    if(file == NULL) {
+      return false;
+    }
+    std::unique_lock<std::mutex> guard(hashTable -> latch(file, pageNo));
+
+    // make sure the frame still holds that page and nobody pinned it
+    FrameId mapped;
+    if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame ||
+       desc.pinCnt != 0) {
+      return false;
+    }
+
+    // if dirty
+    if(desc.dirty) {
+      // the background writer is falling behind
+      if(writerThread.joinable()) {
+	writerWake.notify_one();
+      }
+      //write page back
+      if(!writeBackAndEvict(frame, file, pageNo, guard)) {
+	return false;
+      }
+      BUF_TRACE_EVENT(TRACE_EVICT, pageNo, frame);
+      bufStats.add(EVICTIONS);
+      bufStats.add(DIRTY_EVICTIONS);
+      bufStats.addFile(file -> filename(), 0, 0, 1);
+      return true;
+    }
+
+    //remove from hash table
+    hashTable -> erase(file, pageNo);
+    pageUnmapped(frame, file, pageNo, true);
+    desc.Clear();
+    desc.pinCnt = 1;
+    guard.unlock();
+    BUF_TRACE_EVENT(TRACE_EVICT, pageNo, frame);
+    bufStats.add(EVICTIONS);
+    bufStats.addFile(file -> filename(), 0, 0, 1);
+    return true;
+  }
+
+  bool BufMgr::writeBackAndEvict(const FrameId frame, File* file, const PageId pageNo,
+				 std::unique_lock<std::mutex>& guard)
+  {
+    BufDesc& desc = bufDescTable[frame];
+    desc.pinCnt++;
+    desc.evicting = true;
+    setDirty(frame, false);
+    guard.unlock();
+
+    bool writeFailed = false;
     try {
-      // get frame id
-      hashTable->lookup(file, pageNo, frame);
-      bufDescTable[frame].refbit = true;
-      bufDescTable[frame].pinCnt++;
-    } catch(HashNotFoundException e) {
-      // allocate new frame
-      // @throws BufferExceededException If no such buffer is found which can be allocated
-      allocBuf(frame);
-      
-      // read page from file
-      // @throws  InvalidPageException  If the page is free (unused) and
-      //                                allow_free is false.
-      bufPool[frame] = file -> readPage(pageNo);
+      writeFrame(file, frame);
+    } catch(...) {
+      writeFailed = true;
+      guard.lock();
+      desc.evicting = false;
+      FrameId mapped;
+      if(hashTable -> probe(file, pageNo, mapped) && mapped == frame) {
+	setDirty(frame, true);
+	desc.pinCnt--;
+	throw;
+      }
+    }
 
-      // update pool
-      // @throws HashAlreadyPresentException
-      // @throws HashTableException (optional) if could not create a new bucket as running of memory
-      hashTable -> insert(file, pageNo, frame);
+    if(!writeFailed) {
+      guard.lock();
+      desc.evicting = false;
+    }
 
-      bufDescTable[frame].Set(file, pageNo);
-      
+    // the page may have been disposed of while it was being written
+    FrameId mapped;
+    if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame) {
+      desc.Clear();
+      desc.pinCnt = 1;
+      return true;
     }
-    // return pointer to the page
-    page = &bufPool[frame];
+
+    // somebody pinned or modified it meanwhile; leave it resident
+    if(desc.pinCnt != 1 || desc.dirty) {
+      desc.pinCnt--;
+      return false;
+    }
+
+    hashTable -> erase(file, pageNo);
+    pageUnmapped(frame, file, pageNo, true);
+    desc.Clear();
+    desc.pinCnt = 1;
+    return true;
   }
-	
-  void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
+
+  bool BufMgr::cleanFrame(const FrameId frame)
   {
-    // frame id
-    FrameId frame;
+    BufDesc& desc = bufDescTable[frame];
+    File* file = desc.file;
+    const PageId pageNo = desc.pageNo;
+    if(file == NULL || !desc.dirty) {
+      return false;
+    }
+    std::unique_lock<std::mutex> guard(hashTable -> latch(file, pageNo));
+    FrameId mapped;
+    if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame ||
+       desc.pinCnt != 0 || !desc.dirty || desc.evicting) {
+      return false;
+    }
+
+    // hold a pin for the write, like writeBackAndEvict(); a thread that
+    // modifies the page meanwhile marks it dirty again when it unpins
+    desc.pinCnt++;
+    desc.evicting = true;
+    setDirty(frame, false);
+    guard.unlock();
+
+    bool written = true;
     try {
-      // get frame id
-      hashTable -> lookup(file, pageNo, frame);
+      writeFrame(file, frame);
+    } catch(...) {
+      written = false;
+    }
+
+    guard.lock();
+    desc.evicting = false;
+    if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame) {
+      // disposed of meanwhile; the frame is ours to free
+      guard.unlock();
+      releaseFrame(frame);
+      return written;
+    }
+    if(!written) {
+      setDirty(frame, true);
+    }
+    desc.pinCnt--;
+    return written;
+  }
 
-      if(bufDescTable[frame].pinCnt == 0) {
-	throw PageNotPinnedException(file -> filename(), pageNo, frame);
+  void BufMgr::runWriter()
+  {
+    std::vector<FrameId> candidates;
+    candidates.reserve(cleanFrameTarget);
+    std::unique_lock<std::mutex> guard(writerLatch);
+    while(!writerStop) {
+      guard.unlock();
+      candidates.clear();
+      for(std::size_t s = 0; s < shards.size(); s++) {
+	shards[s] -> upcomingVictims(std::max<std::uint32_t>(1, cleanFrameTarget / shards.size()),
+				     candidates);
+      }
+      std::uint32_t written = 0;
+      for(std::size_t i = 0; i < candidates.size(); i++) {
+	if(cleanFrame(candidates[i])) {
+	  written++;
+	}
       }
+      guard.lock();
 
-      // decrement pin
-      bufDescTable[frame].pinCnt--;
-      
-      if (dirty) {
-	bufDescTable[frame].dirty = dirty;
+      // keep going while there is work, otherwise sleep until a miss wakes us
+      if(written == 0 && !writerStop) {
+	writerWake.wait_for(guard, std::chrono::milliseconds(writerIntervalMs));
       }
-    } catch(HashNotFoundException e) {
-      // do nothing
     }
   }
 
-  void BufMgr::flushFile(const File* file) 
+  void BufMgr::runPrefetcher()
+  {
+    std::unique_lock<std::mutex> guard(prefetchLatch);
+    for(;;) {
+      while(!prefetchStop && prefetchQueue.empty()) {
+	prefetchWake.wait(guard);
+      }
+      if(prefetchQueue.empty()) {
+	return;
+      }
+      const PrefetchRequest request = prefetchQueue.front();
+      prefetchQueue.pop_front();
+      const bool read = !prefetchStop;
+      guard.unlock();
+      finishPrefetch(request, read);
+      guard.lock();
+    }
+  }
+
+  void BufMgr::runWarmUp(std::vector<WarmUpPage> pages)
   {
-    // pointer to page in buffer pool
-    BufDesc* page;    
-    for(FrameId i = 0; i < numBufs; i++) {
-      page = &bufDescTable[i];
-      // if page belongs to the file
-      if(page -> file == file) {
-	// if not valid
-	if(!(page -> valid)) {
-	  throw BadBufferException(page -> frameNo, page -> dirty, page ->  valid, page -> refbit);
-	}
-	// if pinned
-	if(page -> pinCnt != 0) {
-	  throw PagePinnedException(file -> filename(), page -> pageNo, page -> frameNo);
-	}
-	// if dirty
-	if(page -> dirty) {
-	  // write to disk
-	  page -> file -> writePage(bufPool[i]);
-	  // remove from hash table
-	  // @throws HashNotFoundException
-	  try {
-	    hashTable -> remove(file, page -> pageNo);
-	  } catch(HashNotFoundException e) {
-	    // do nothing
+    const Clock::time_point start = Clock::now();
+    std::vector<PageId> pageNos;
+    std::vector<Page*> read;
+    std::size_t next = 0;
+    bool full = false;
+    while(next < pages.size() && !warmUpStop && !full) {
+      // fill free frames only; evicting pages in use to make room would undo
+      // the warm-up of the pages before, or push out the foreground's pages
+      std::uint32_t free = 0;
+      for(std::size_t s = 0; s < shards.size(); s++) {
+	free += shards[s] -> freeCount;
+      }
+      if(free == 0) {
+	break;
+      }
+      const std::size_t end = std::min(pages.size(),
+				       next + std::min<std::size_t>(free, warmUpBatch));
+      std::sort(pages.begin() + next, pages.begin() + end,
+		[](const WarmUpPage& a, const WarmUpPage& b) {
+		  return a.file != b.file ? a.file < b.file : a.pageNo < b.pageNo;
+		});
+
+      std::uint32_t restored = 0;
+      for(std::size_t i = next; i < end && !full; ) {
+	File* file = pages[i].file;
+	pageNos.clear();
+	for(; i < end && pages[i].file == file; i++) {
+	  FrameId frame;
+	  std::lock_guard<std::mutex> guard(hashTable -> latch(file, pages[i].pageNo));
+	  if(!hashTable -> probe(file, pages[i].pageNo, frame)) {
+	    pageNos.push_back(pages[i].pageNo);
+	  }
+	}
+	if(pageNos.empty()) {
+	  continue;
+	}
+	try {
+	  readPages(file, pageNos, read, false);
+	  unPinPages(file, pageNos, false);
+	  restored += pageNos.size();
+	} catch(const BufferExceededException&) {
+	  // foreground misses took the free frames meanwhile; what was read
+	  // before they ran out stays
+	  full = true;
+	  for(std::size_t p = 0; p < pageNos.size(); p++) {
+	    FrameId frame;
+	    std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNos[p]));
+	    if(hashTable -> probe(file, pageNos[p], frame)) {
+	      restored++;
+	    }
+	  }
+	} catch(...) {
+	  // a page deleted since the list was saved fails the whole batch;
+	  // read the rest one by one
+	  for(std::size_t p = 0; p < pageNos.size() && !full; p++) {
+	    try {
+	      readPages(file, std::vector<PageId>(1, pageNos[p]), read, false);
+	      unPinPage(file, pageNos[p], false);
+	      restored++;
+	    } catch(const BufferExceededException&) {
+	      full = true;
+	    } catch(...) {
+	      // deleted; counted as skipped below
+	    }
 	  }
-	  bufDescTable[i].Clear(); 
 	}
       }
+      // the rest were resident already, deleted, or left once the frames ran out
+      const std::uint32_t skipped = end - next - restored;
+      next = end;
+
+      std::lock_guard<std::mutex> guard(warmUpLatch);
+      warmUpProgress.restored += restored;
+      warmUpProgress.skipped += skipped;
+      warmUpProgress.elapsedNanos = nanosSince(start);
     }
+
+    std::lock_guard<std::mutex> guard(warmUpLatch);
+    warmUpProgress.skipped += pages.size() - next;
+    warmUpProgress.elapsedNanos = nanosSince(start);
+    warmUpProgress.running = false;
   }
 
-  void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+  void BufMgr::stopWarmUp()
   {
-    // allocate empty page
-    Page newpage = file -> allocatePage();
+    if(warmUpThread.joinable()) {
+      warmUpStop = true;
+      warmUpThread.join();
+      warmUpStop = false;
+    }
+  }
 
-    // get page number
-    pageNo = newpage.page_number();
+  void BufMgr::finishPrefetch(const PrefetchRequest& request, const bool read)
+  {
+    BufDesc& desc = bufDescTable[request.frame];
+    if(read) {
+      try {
+	readFrame(request.file, request.pageNo, request.frame);
+	// both under the latch, so the frame is never seen unpinned while loading
+	std::lock_guard<std::mutex> guard(hashTable -> latch(request.file, request.pageNo));
+	desc.loading.store(false, std::memory_order_release);
+	desc.pinCnt--;
+	return;
+      } catch(...) {
+      }
+    }
 
-    // insert into frame in the buffer pool
-    FrameId frame;
-    allocBuf(frame);
-    bufPool[frame] = newpage;
-    bufDescTable[frame].Set(file, pageNo);
-    
-    // insert to hash table
-    // @throws HashAlreadyPresentException if the corresponding page already exists in the hash table
-    // @throws HashTableException (optional) if could not create a new bucket as running of memory
-    hashTable -> insert(file, pageNo, frame);
+    {
+      std::lock_guard<std::mutex> guard(hashTable -> latch(request.file, request.pageNo));
+      hashTable -> erase(request.file, request.pageNo);
+      pageUnmapped(request.frame, request.file, request.pageNo, false);
+      desc.valid = false;
+    }
+    desc.loading.store(false, std::memory_order_release);
+    if(--desc.pinCnt == 0) {
+      releaseFrame(request.frame);
+    }
+  }
 
-    // return pointer to page
-    page = &bufPool[frame];
+  bool BufMgr::waitForIo(const FrameId frame, const File* file, const PageId pageNo,
+			 std::unique_lock<std::mutex>& guard)
+  {
+    FrameId mapped;
+    while(bufDescTable[frame].evicting || bufDescTable[frame].loading) {
+      guard.unlock();
+      std::this_thread::yield();
+      guard.lock();
+      if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame) {
+	return false;
+      }
+    }
+    return true;
   }
 
-  void BufMgr::disposePage(File* file, const PageId PageNo)
+  bool BufMgr::pinResident(File* file, const PageId pageNo, FrameId& frame, const bool touch)
   {
-    // identify frame
-    FrameId frame;
-    try {
-      hashTable -> lookup(file, PageNo, frame);
+    for(;;) {
+      {
+	std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+	if(!hashTable -> probe(file, pageNo, frame)) {
+	  return false;
+	}
+	bufDescTable[frame].pinCnt++;
+	if(touch) {
+	  bufDescTable[frame].refbit = true;
+	  shardOf(frame).accessed(frame);
+	}
+      }
+
+      // wait for another thread to finish reading the page in
+      BufDesc& desc = bufDescTable[frame];
+      if(desc.loading.load(std::memory_order_acquire)) {
+	bufStats.add(PIN_WAITS);
+	while(desc.loading.load(std::memory_order_acquire)) {
+	  std::this_thread::yield();
+	}
+      }
+      if(desc.valid) {
+	return true;
+      }
 
-      // remove from buffer pool
-      bufDescTable[frame].Clear();
+      // the read failed; the last thread to let go of the frame frees it
+      if(--desc.pinCnt == 0) {
+	releaseFrame(frame);
+      }
+    }
+  }
 
-      // remove from hash table
-      hashTable -> remove(file, PageNo);
-    } catch(HashNotFoundException e) {
-      // do nothing
+  void BufMgr::readPage(File* file, const PageId pageNo, Page*& page,
+			const AccessStrategy strategy)
+  {
+    if(file -> mapped()) {
+      page = const_cast<Page*>(file -> mappedPage(pageNo));
+      bufStats.add(MAPPED_PINS);
+      return;
+    }
+    page = &bufPool[pinFrame(file, pageNo, strategy)];
+  }
+
+  PinnedPage BufMgr::pinPage(File* file, const PageId pageNo, const AccessStrategy strategy)
+  {
+    if(file -> mapped()) {
+      // nothing to unpin, so the handle has no manager
+      Page* page = const_cast<Page*>(file -> mappedPage(pageNo));
+      bufStats.add(MAPPED_PINS);
+      return PinnedPage(NULL, page, 0, pageNo);
+    }
+    const FrameId frame = pinFrame(file, pageNo, strategy);
+    return PinnedPage(this, &bufPool[frame], frame, pageNo);
+  }
+
+  FrameId BufMgr::pinFrame(File* file, const PageId pageNo, const AccessStrategy strategy)
+  {
+    // frame id
+    FrameId frame;
+    const bool timed = BufStatsCollector::sampleHit();
+    const Clock::time_point start = timed ? Clock::now() : Clock::time_point();
+    if(pinResident(file, pageNo, frame, strategy == NORMAL_ACCESS)) {
+      BUF_TRACE_EVENT(TRACE_HIT, pageNo, frame);
+      bufStats.add(HITS);
+      if(timed) {
+	bufStats.record(HIT_LATENCY, nanosSince(start));
+      }
+      return frame;
+    }
+
+    const Clock::time_point missStart = Clock::now();
+    BUF_TRACE_SCOPE(trace, TRACE_MISS, pageNo, TraceEvent::NONE);
+    do {
+      AccessStrategy access = strategy;
+      if(access == NORMAL_ACCESS) {
+	access = detectStrategy(file, pageNo);
+      }
+
+      // allocate new frame
+      // @throws BufferExceededException If no such buffer is found which can be allocated
+      if(access == NORMAL_ACCESS) {
+	allocBuf(frame, file, pageNo);
+      } else {
+	allocRingBuf(frame, file, pageNo, access);
+      }
+      BufDesc& desc = bufDescTable[frame];
+
+      // update pool, so others wait for our read instead of reading it too
+      // @throws HashTableException if the hash table partition is full
+      try {
+	std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+	FrameId existing;
+	if(!hashTable -> probe(file, pageNo, existing)) {
+	  hashTable -> insert(file, pageNo, frame);
+	  desc.Set(file, pageNo);
+	  desc.loading = true;
+	  if(access != NORMAL_ACCESS) {
+	    // leave it for the ring to reuse
+	    desc.refbit = false;
+	  }
+	  pageMapped(frame, file, pageNo, access != NORMAL_ACCESS);
+	}
+      } catch(...) {
+	releaseFrame(frame);
+	throw;
+      }
+      if(!desc.loading) {
+	// another thread got there first
+	releaseFrame(frame);
+	continue;
+      }
+
+      // read page from file straight into the frame, without any latch held
+      // @throws  InvalidPageException  If the page is free (unused) and
+      //                                allow_free is false.
+      try {
+	readFrame(file, pageNo, frame);
+      } catch(...) {
+	{
+	  std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+	  hashTable -> erase(file, pageNo);
+	  pageUnmapped(frame, file, pageNo, false);
+	  desc.valid = false;
+	}
+	desc.loading.store(false, std::memory_order_release);
+	if(--desc.pinCnt == 0) {
+	  releaseFrame(frame);
+	}
+	throw;
+      }
+      desc.loading.store(false, std::memory_order_release);
+      break;
+    } while(!pinResident(file, pageNo, frame, strategy == NORMAL_ACCESS));
+    BUF_TRACE_FRAME(trace, frame);
+    bufStats.add(MISSES);
+    bufStats.record(MISS_LATENCY, nanosSince(missStart));
+    return frame;
+  }
+
+  void BufMgr::readFrame(File* file, const PageId pageNo, const FrameId frame)
+  {
+    file -> readPage(pageNo, bufPool[frame]);
+    bufStats.add(DISK_READS);
+    bufStats.add(BYTES_READ, Page::SIZE);
+    bufStats.addFile(file -> filename(), 1, 0, 0);
+  }
+
+  void BufMgr::writeFrame(File* file, const FrameId frame)
+  {
+    const Clock::time_point start = Clock::now();
+    BUF_TRACE_SCOPE(trace, TRACE_WRITE_BACK, bufPool[frame].page_number(), frame);
+    file -> writePage(bufPool[frame]);
+    bufStats.record(WRITE_LATENCY, nanosSince(start));
+    bufStats.add(DISK_WRITES);
+    bufStats.add(BYTES_WRITTEN, Page::SIZE);
+    bufStats.addFile(file -> filename(), 0, 1, 0);
+  }
+	
+  void BufMgr::prefetch(File* file, const std::vector<PageId>& pageNos)
+  {
+    if(file -> mapped()) {
+      for(std::size_t i = 0; i < pageNos.size(); i++) {
+	file -> adviseAccess(ADVISE_WILLNEED, pageNos[i], 1);
+      }
+      return;
+    }
+
+    // in file order, so the reads sweep the disk once
+    std::vector<PageId> pages(pageNos);
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+    for(std::size_t i = 0; i < pages.size(); i++) {
+      const PageId pageNo = pages[i];
+      FrameId frame;
+      {
+	std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+	if(hashTable -> probe(file, pageNo, frame)) {
+	  continue;
+	}
+      }
+
+      // a prefetch is only a hint; never fail because the pool is full
+      try {
+	allocBuf(frame, file, pageNo);
+      } catch(BufferExceededException&) {
+	return;
+      }
+
+      // map it loading, as a readPage() miss does, with the pin held by the request
+      BufDesc& desc = bufDescTable[frame];
+      try {
+	std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+	FrameId existing;
+	if(!hashTable -> probe(file, pageNo, existing)) {
+	  hashTable -> insert(file, pageNo, frame);
+	  desc.Set(file, pageNo);
+	  desc.loading = true;
+	  desc.refbit = false;
+	  pageMapped(frame, file, pageNo, true);
+	}
+      } catch(...) {
+	releaseFrame(frame);
+	throw;
+      }
+      if(!desc.loading) {
+	releaseFrame(frame);
+	continue;
+      }
+
+      const PrefetchRequest request = {file, pageNo, frame};
+      {
+	std::lock_guard<std::mutex> guard(prefetchLatch);
+	if(prefetchers.empty()) {
+	  for(std::uint32_t t = 0; t < prefetchThreads; t++) {
+	    prefetchers.push_back(std::thread(&BufMgr::runPrefetcher, this));
+	  }
+	}
+	prefetchQueue.push_back(request);
+      }
+      prefetchWake.notify_one();
+    }
+  }
+
+  void BufMgr::prefetch(File* file, const PageId first, const PageId count)
+  {
+    if(file -> mapped()) {
+      if(count != 0) {
+	file -> adviseAccess(ADVISE_WILLNEED, first, count);
+      }
+      return;
+    }
+    std::vector<PageId> pageNos;
+    pageNos.reserve(count);
+    for(PageId pageNo = first; pageNo < first + count; pageNo++) {
+      pageNos.push_back(pageNo);
+    }
+    prefetch(file, pageNos);
+  }
+
+  void BufMgr::readPages(File* file, const std::vector<PageId>& pageNos,
+			 std::vector<Page*>& pages)
+  {
+    readPages(file, pageNos, pages, true);
+  }
+
+  void BufMgr::readPages(File* file, const std::vector<PageId>& pageNos,
+			 std::vector<Page*>& pages, const bool evict)
+  {
+    enum { MISSING, PINNED, LOADING };
+    const std::size_t count = pageNos.size();
+    if(file -> mapped()) {
+      std::vector<Page*> views(count);
+      for(std::size_t i = 0; i < count; i++) {
+	views[i] = const_cast<Page*>(file -> mappedPage(pageNos[i]));
+      }
+      bufStats.add(MAPPED_PINS, count);
+      pages.swap(views);
+      return;
+    }
+    std::vector<std::uint64_t> hashes, order;
+    BUF_TRACE_SCOPE(trace, TRACE_PIN, count ? pageNos[0] : TraceEvent::NONE, count);
+    partitionOrder(*hashTable, file, pageNos, hashes, order);
+    std::vector<FrameId> frames(count);
+    std::vector<char> state(count, MISSING);
+
+    // pin what is resident, one latch acquisition per partition
+    std::vector<std::size_t> misses;
+    for(std::size_t g = 0; g < count; ) {
+      const std::uint64_t partition = order[g] >> 32;
+      std::lock_guard<std::mutex> guard(hashTable -> latch(hashes[std::uint32_t(order[g])]));
+      for(; g < count && (order[g] >> 32) == partition; g++) {
+	const std::size_t i = std::uint32_t(order[g]);
+	if(hashTable -> probe(hashes[i], file, pageNos[i], frames[i])) {
+	  bufDescTable[frames[i]].pinCnt++;
+	  bufDescTable[frames[i]].refbit = true;
+	  shardOf(frames[i]).accessed(frames[i]);
+	  state[i] = PINNED;
+	} else {
+	  misses.push_back(i);
+	}
+      }
+    }
+    bufStats.add(HITS, count - misses.size());
+    bufStats.add(MISSES, misses.size());
+
+    // map the misses in page number order, as readPage() does
+    std::sort(misses.begin(), misses.end(), [&](std::size_t a, std::size_t b) {
+	return pageNos[a] < pageNos[b];
+      });
+    std::exception_ptr error;
+    for(std::size_t m = 0; m < misses.size() && !error; m++) {
+      const std::size_t i = misses[m];
+      FrameId frame;
+      try {
+	if(evict) {
+	  allocBuf(frame, file, pageNos[i]);
+	} else if(!takeFreeBuf(frame, file, pageNos[i])) {
+	  throw BufferExceededException();
+	}
+      } catch(...) {
+	error = std::current_exception();
+	break;
+      }
+      {
+	std::lock_guard<std::mutex> guard(hashTable -> latch(hashes[i]));
+	FrameId existing;
+	if(hashTable -> probe(hashes[i], file, pageNos[i], existing)) {
+	  // read by another thread meanwhile, or a duplicate in this batch
+	  bufDescTable[existing].pinCnt++;
+	  bufDescTable[existing].refbit = true;
+	  shardOf(existing).accessed(existing);
+	  frames[i] = existing;
+	  state[i] = PINNED;
+	} else {
+	  hashTable -> insert(hashes[i], file, pageNos[i], frame);
+	  bufDescTable[frame].Set(file, pageNos[i]);
+	  bufDescTable[frame].loading = true;
+	  pageMapped(frame, file, pageNos[i], false);
+	  frames[i] = frame;
+	  state[i] = LOADING;
+	}
+      }
+      if(state[i] != LOADING) {
+	releaseFrame(frame);
+      }
+    }
+
+    // read runs of consecutive pages with one call each, without any latch held
+    std::vector<Page*> run;
+    for(std::size_t m = 0; m < misses.size(); ) {
+      if(state[misses[m]] != LOADING) {
+	m++;
+	continue;
+      }
+      std::size_t end = m + 1;
+      run.assign(1, &bufPool[frames[misses[m]]]);
+      while(end < misses.size() && state[misses[end]] == LOADING &&
+	    pageNos[misses[end]] == pageNos[misses[end - 1]] + 1) {
+	run.push_back(&bufPool[frames[misses[end]]]);
+	end++;
+      }
+      bool failed = false;
+      try {
+	file -> readPages(pageNos[misses[m]], run.size(), &run[0]);
+	bufStats.add(DISK_READS, run.size());
+	bufStats.add(BYTES_READ, run.size() * Page::SIZE);
+	bufStats.addFile(file -> filename(), run.size(), 0, 0);
+      } catch(...) {
+	failed = true;
+	if(!error) {
+	  error = std::current_exception();
+	}
+      }
+      for(; m < end; m++) {
+	const std::size_t i = misses[m];
+	BufDesc& desc = bufDescTable[frames[i]];
+	if(failed) {
+	  std::lock_guard<std::mutex> guard(hashTable -> latch(hashes[i]));
+	  hashTable -> erase(file, pageNos[i]);
+	  pageUnmapped(frames[i], file, pageNos[i], false);
+	  desc.valid = false;
+	  state[i] = MISSING;
+	}
+	desc.loading.store(false, std::memory_order_release);
+	if(failed && --desc.pinCnt == 0) {
+	  releaseFrame(frames[i]);
+	} else if(!failed) {
+	  state[i] = PINNED;
+	}
+      }
+    }
+
+    // pages other threads were reading; a failed read is retried on our own
+    for(std::size_t i = 0; i < count && !error; i++) {
+      if(state[i] != PINNED) {
+	continue;
+      }
+      BufDesc& desc = bufDescTable[frames[i]];
+      if(desc.loading.load(std::memory_order_acquire)) {
+	bufStats.add(PIN_WAITS);
+	while(desc.loading.load(std::memory_order_acquire)) {
+	  std::this_thread::yield();
+	}
+      }
+      if(desc.valid) {
+	continue;
+      }
+      if(--desc.pinCnt == 0) {
+	releaseFrame(frames[i]);
+      }
+      state[i] = MISSING;
+      try {
+	if(evict) {
+	  Page* page;
+	  readPage(file, pageNos[i], page);
+	  frames[i] = page - bufPool;
+	} else {
+	  std::vector<Page*> retried;
+	  readPages(file, std::vector<PageId>(1, pageNos[i]), retried, false);
+	  frames[i] = retried[0] - bufPool;
+	}
+	state[i] = PINNED;
+      } catch(...) {
+	error = std::current_exception();
+      }
+    }
+
+    if(error) {
+      // all or nothing: let go of whatever this call pinned
+      for(std::size_t i = 0; i < count; i++) {
+	if(state[i] != PINNED) {
+	  continue;
+	}
+	// a duplicate of a page whose read failed holds the last pin
+	BufDesc& desc = bufDescTable[frames[i]];
+	bool release;
+	{
+	  std::lock_guard<std::mutex> guard(hashTable -> latch(hashes[i]));
+	  release = --desc.pinCnt == 0 && !desc.valid;
+	}
+	if(release) {
+	  releaseFrame(frames[i]);
+	}
+      }
+      std::rethrow_exception(error);
+    }
+
+    pages.resize(count);
+    for(std::size_t i = 0; i < count; i++) {
+      pages[i] = &bufPool[frames[i]];
+    }
+  }
+
+  void BufMgr::unPinPages(File* file, const std::vector<PageId>& pageNos, const bool dirty)
+  {
+    if(file -> mapped()) {
+      if(dirty) {
+	throw FileReadOnlyException(file -> filename());
+      }
+      return;
+    }
+    const std::size_t count = pageNos.size();
+    std::vector<std::uint64_t> hashes, order;
+    partitionOrder(*hashTable, file, pageNos, hashes, order);
+
+    bool notPinned = false;
+    PageId notPinnedPage = 0;
+    FrameId notPinnedFrame = 0;
+    for(std::size_t g = 0; g < count; ) {
+      const std::uint64_t partition = order[g] >> 32;
+      std::lock_guard<std::mutex> guard(hashTable -> latch(hashes[std::uint32_t(order[g])]));
+      for(; g < count && (order[g] >> 32) == partition; g++) {
+	const std::size_t i = std::uint32_t(order[g]);
+	FrameId frame;
+	if(!hashTable -> probe(hashes[i], file, pageNos[i], frame)) {
+	  continue;
+	}
+	BufDesc& desc = bufDescTable[frame];
+	if(desc.userPins() == 0) {
+	  if(!notPinned) {
+	    notPinned = true;
+	    notPinnedPage = pageNos[i];
+	    notPinnedFrame = frame;
+	  }
+	  continue;
+	}
+	if(dirty) {
+	  setDirty(frame, true);
+	}
+	desc.pinCnt--;
+      }
+    }
+    if(notPinned) {
+      throw PageNotPinnedException(file -> filename(), notPinnedPage, notPinnedFrame);
+    }
+  }
+
+  void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
+  {
+    if(file -> mapped()) {
+      if(dirty) {
+	throw FileReadOnlyException(file -> filename());
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+
+    // frame id
+    FrameId frame;
+    // get frame id, nothing to do if the page is not in the pool
+    if(!hashTable -> probe(file, pageNo, frame)) {
+      return;
+    }
+
+    BufDesc& desc = bufDescTable[frame];
+    if(desc.userPins() == 0) {
+      throw PageNotPinnedException(file -> filename(), pageNo, frame);
+    }
+
+    // mark dirty before the pin is dropped, so an evictor cannot miss it
+    if (dirty) {
+      setDirty(frame, true);
+    }
+
+    BUF_TRACE_EVENT(TRACE_UNPIN, pageNo, frame);
+    // decrement pin
+    desc.pinCnt--;
+  }
+
+  void BufMgr::unPinFrame(const FrameId frame, const bool dirty)
+  {
+    BufDesc& desc = bufDescTable[frame];
+    BUF_TRACE_EVENT(TRACE_UNPIN, desc.pageNo, frame);
+    // dirty marks are kept in step with write-backs by the page's latch
+    if (dirty) {
+      std::lock_guard<std::mutex> guard(hashTable -> latch(desc.file, desc.pageNo));
+      setDirty(frame, true);
+      desc.pinCnt--;
+      return;
+    }
+    desc.pinCnt--;
+  }
+
+  void BufMgr::flushFile(const File* file) 
+  {
+    std::vector<std::pair<PageId, FrameId> > frames;
+    residentFrames(file, frames);
+    for(std::size_t f = 0; f < frames.size(); f++) {
+      const PageId pageNo = frames[f].first;
+      const FrameId i = frames[f].second;
+      // pointer to page in buffer pool
+      BufDesc* page = &bufDescTable[i];
+      std::unique_lock<std::mutex> guard(hashTable -> latch(file, pageNo));
+      FrameId mapped;
+      if(!hashTable -> probe(file, pageNo, mapped) || mapped != i) {
+	continue;
+      }
+      // let a read or write-back in progress finish, so none is left
+      // running on the file when this returns
+      if(!waitForIo(i, file, pageNo, guard)) {
+	continue;
+      }
+      // if not valid
+      if(!(page -> valid)) {
+	throw BadBufferException(page -> frameNo, page -> dirty, page ->  valid, page -> refbit);
+      }
+      // if pinned
+      if(page -> userPins() != 0) {
+	throw PagePinnedException(file -> filename(), pageNo, page -> frameNo);
+      }
+      // if dirty
+      if(page -> dirty) {
+	// write to disk and remove from the pool
+	if(writeBackAndEvict(i, page -> file, pageNo, guard)) {
+	  guard.unlock();
+	  releaseFrame(i);
+	}
+      }
+    }
+    // a sync barrier as the file's sync mode has it
+    file -> sync();
+  }
+
+  bool BufMgr::saveResidentPages(const std::string& path)
+  {
+    // hold off resize(), which changes numBufs and retires frames
+    std::unique_lock<std::mutex> resizeGuard(resizeLatch);
+
+    // rank the unpinned pages of each shard by how soon its policy would
+    // evict them; pages it would not evict at all are the hottest
+    std::vector<std::uint16_t> hotness(maxBufs, WarmUpList::HOTTEST);
+    std::vector<FrameId> victims;
+    for(std::size_t s = 0; s < shards.size(); s++) {
+      victims.clear();
+      shards[s] -> upcomingVictims(shards[s] -> numBufs, victims);
+      for(std::size_t k = 0; k < victims.size(); k++) {
+	hotness[victims[k]] = k * WarmUpList::HOTTEST / victims.size();
+      }
+    }
+
+    WarmUpList list;
+    std::map<std::string, std::uint32_t> fileIndex;
+    {
+      std::lock_guard<std::mutex> guard(fileFramesLatch);
+      for(std::map<const File*, FileFrames>::const_iterator it = fileFrames.begin();
+	  it != fileFrames.end(); ++it) {
+	std::map<std::string, std::uint32_t>::iterator index = fileIndex.find(it -> first -> filename());
+	if(index == fileIndex.end()) {
+	  index = fileIndex.insert(std::make_pair(it -> first -> filename(), list.files.size())).first;
+	  list.files.push_back(it -> first -> filename());
+	}
+	for(FrameId i = it -> second.resident.front(); i != IndexLinks::NONE;
+	    i = residentLinks.next[i]) {
+	  const WarmUpEntry entry = {index -> second, bufDescTable[i].pageNo, hotness[i], 0};
+	  list.entries.push_back(entry);
+	}
+      }
+    }
+    resizeGuard.unlock();
+    return list.save(path);
+  }
+
+  bool BufMgr::warmUp(const std::string& path, const std::map<std::string, File*>& files)
+  {
+    WarmUpList list;
+    if(!list.load(path)) {
+      return false;
+    }
+    stopWarmUp();
+
+    std::vector<File*> listed(list.files.size(), NULL);
+    for(std::size_t f = 0; f < list.files.size(); f++) {
+      std::map<std::string, File*>::const_iterator it = files.find(list.files[f]);
+      if(it != files.end()) {
+	listed[f] = it -> second;
+      }
+    }
+    std::vector<WarmUpPage> pages;
+    pages.reserve(list.entries.size());
+    for(std::size_t e = 0; e < list.entries.size(); e++) {
+      const WarmUpEntry& entry = list.entries[e];
+      if(listed[entry.file] != NULL) {
+	const WarmUpPage page = {listed[entry.file], entry.pageNo, entry.hotness};
+	pages.push_back(page);
+      }
+    }
+    std::stable_sort(pages.begin(), pages.end(), [](const WarmUpPage& a, const WarmUpPage& b) {
+	return a.hotness > b.hotness;
+      });
+
+    {
+      std::lock_guard<std::mutex> guard(warmUpLatch);
+      warmUpProgress = WarmUpStatus();
+      warmUpProgress.running = true;
+      warmUpProgress.listed = pages.size();
+    }
+    warmUpThread = std::thread(&BufMgr::runWarmUp, this, std::move(pages));
+    return true;
+  }
+
+  WarmUpStatus BufMgr::getWarmUpStatus()
+  {
+    std::lock_guard<std::mutex> guard(warmUpLatch);
+    return warmUpProgress;
+  }
+
+  WarmUpStatus BufMgr::waitForWarmUp()
+  {
+    if(warmUpThread.joinable()) {
+      warmUpThread.join();
+    }
+    return getWarmUpStatus();
+  }
+
+  const Page* BufMgr::claimDirty(const CheckpointPage& page, Page* copy,
+				 std::vector<FrameId>& held)
+  {
+    BufDesc& desc = bufDescTable[page.frame];
+    std::lock_guard<std::mutex> guard(hashTable -> latch(page.file, page.pageNo));
+    FrameId mapped;
+    if(!hashTable -> probe(page.file, page.pageNo, mapped) || mapped != page.frame ||
+       !desc.dirty || desc.evicting || desc.loading) {
+      return NULL;
+    }
+    if(desc.pinCnt != 0) {
+      if(copy == NULL) {
+	return NULL;
+      }
+      // whoever holds the pin marks the page dirty again if they change it
+      *copy = bufPool[page.frame];
+      setDirty(page.frame, false);
+      return copy;
+    }
+    desc.pinCnt++;
+    desc.evicting = true;
+    setDirty(page.frame, false);
+    held.push_back(page.frame);
+    return &bufPool[page.frame];
+  }
+
+  void BufMgr::releaseClaimed(const std::vector<CheckpointPage>& run,
+			      const std::vector<FrameId>& held, const bool written)
+  {
+    std::size_t h = 0;
+    for(std::size_t i = 0; i < run.size(); i++) {
+      const bool pinned = h < held.size() && held[h] == run[i].frame;
+      h += pinned ? 1 : 0;
+      BufDesc& desc = bufDescTable[run[i].frame];
+      std::unique_lock<std::mutex> guard(hashTable -> latch(run[i].file, run[i].pageNo));
+      FrameId mapped;
+      const bool resident = hashTable -> probe(run[i].file, run[i].pageNo, mapped) &&
+	mapped == run[i].frame;
+      if(pinned) {
+	desc.evicting = false;
+	if(!resident) {
+	  // disposed of meanwhile; the frame is ours to free
+	  guard.unlock();
+	  releaseFrame(run[i].frame);
+	  continue;
+	}
+	desc.pinCnt--;
+      }
+      if(resident && !written) {
+	setDirty(run[i].frame, true);
+      }
+    }
+  }
+
+  std::uint32_t BufMgr::checkpoint(const CheckpointOptions& options)
+  {
+    std::vector<CheckpointPage> dirty;
+    {
+      std::lock_guard<std::mutex> guard(fileFramesLatch);
+      for(std::map<const File*, FileFrames>::const_iterator it = fileFrames.begin();
+	  it != fileFrames.end(); ++it) {
+	for(FrameId i = it -> second.dirty.front(); i != IndexLinks::NONE;
+	    i = dirtyLinks.next[i]) {
+	  const CheckpointPage page = {bufDescTable[i].file, bufDescTable[i].pageNo, i};
+	  dirty.push_back(page);
+	}
+      }
+    }
+    std::sort(dirty.begin(), dirty.end(), [](const CheckpointPage& a, const CheckpointPage& b) {
+	return a.file != b.file ? a.file < b.file : a.pageNo < b.pageNo;
+      });
+
+    const std::uint32_t maxRun = std::max<std::uint32_t>(1, options.maxRunPages);
+    std::vector<Page> copies(options.copyPinned ? maxRun : 0);
+    std::vector<CheckpointPage> run;
+    std::vector<const Page*> images;
+    std::vector<FrameId> held;
+    std::vector<File*> synced;
+    const Clock::time_point start = Clock::now();
+    std::uint64_t bytes = 0;
+    std::uint32_t written = 0;
+
+    for(std::size_t i = 0; i < dirty.size();) {
+      // claim adjacent pages of one file until one cannot be written
+      File* file = dirty[i].file;
+      const PageId first = dirty[i].pageNo;
+      run.clear();
+      images.clear();
+      held.clear();
+      while(i < dirty.size() && dirty[i].file == file &&
+	    dirty[i].pageNo == first + run.size() && run.size() < maxRun) {
+	const Page* image = claimDirty(dirty[i++], options.copyPinned ?
+				       &copies[run.size()] : NULL, held);
+	if(image == NULL) {
+	  break;
+	}
+	run.push_back(dirty[i - 1]);
+	images.push_back(image);
+      }
+      if(run.empty()) {
+	continue;
+      }
+
+      const Clock::time_point runStart = Clock::now();
+      try {
+	file -> writePages(first, run.size(), &images[0]);
+      } catch(...) {
+	releaseClaimed(run, held, false);
+	throw;
+      }
+      releaseClaimed(run, held, true);
+      const std::uint64_t perPage = nanosSince(runStart) / run.size();
+      for(std::size_t p = 0; p < run.size(); p++) {
+	bufStats.record(WRITE_LATENCY, perPage);
+      }
+      bufStats.add(DISK_WRITES, run.size());
+      bufStats.add(BYTES_WRITTEN, run.size() * Page::SIZE);
+      bufStats.addFile(file -> filename(), 0, run.size(), 0);
+      written += run.size();
+      if(synced.empty() || synced.back() != file) {
+	synced.push_back(file);
+      }
+
+      // stay under the rate by sleeping until the bytes so far are due
+      bytes += run.size() * Page::SIZE;
+      if(options.maxBytesPerSecond != 0) {
+	const std::uint64_t due = bytes * 1000000000.0 / options.maxBytesPerSecond;
+	const std::uint64_t elapsed = nanosSince(start);
+	if(due > elapsed) {
+	  std::this_thread::sleep_for(std::chrono::nanoseconds(due - elapsed));
+	}
+      }
+    }
+
+    for(std::size_t f = 0; f < synced.size(); f++) {
+      synced[f] -> sync();
+    }
+    return written;
+  }
+
+  void BufMgr::dropFile(const File* file)
+  {
+    std::vector<std::pair<PageId, FrameId> > frames;
+    residentFrames(file, frames);
+    // look for pins before dropping anything, so a pinned page does not
+    // leave the file half dropped with its dirty pages lost
+    for(std::size_t f = 0; f < frames.size(); f++) {
+      const PageId pageNo = frames[f].first;
+      const FrameId frame = frames[f].second;
+      std::unique_lock<std::mutex> guard(hashTable -> latch(file, pageNo));
+      FrameId mapped;
+      if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame ||
+	 !waitForIo(frame, file, pageNo, guard)) {
+	continue;
+      }
+      if(bufDescTable[frame].userPins() != 0) {
+	throw PagePinnedException(file -> filename(), pageNo, frame);
+      }
+    }
+
+    {
+      // its access pattern and rings go with it
+      AccessPartition& partition = accessPartitionOf(file);
+      std::lock_guard<std::mutex> guard(partition.latch);
+      partition.files.erase(file);
+    }
+
+    for(std::size_t f = 0; f < frames.size(); f++) {
+      const PageId pageNo = frames[f].first;
+      const FrameId frame = frames[f].second;
+      {
+	std::unique_lock<std::mutex> guard(hashTable -> latch(file, pageNo));
+	FrameId mapped;
+	if(!hashTable -> probe(file, pageNo, mapped) || mapped != frame ||
+	   !waitForIo(frame, file, pageNo, guard)) {
+	  continue;
+	}
+	if(bufDescTable[frame].userPins() != 0) {
+	  throw PagePinnedException(file -> filename(), pageNo, frame);
+	}
+	hashTable -> erase(file, pageNo);
+	pageUnmapped(frame, file, pageNo, false);
+      }
+      releaseFrame(frame);
+    }
+  }
+
+  void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page,
+			 const AccessStrategy strategy) 
+  {
+    const FrameId frame = pinNewFrame(file, strategy);
+    pageNo = bufPool[frame].page_number();
+    page = &bufPool[frame];
+  }
+
+  PinnedPage BufMgr::pinNewPage(File* file, const AccessStrategy strategy)
+  {
+    const FrameId frame = pinNewFrame(file, strategy);
+    return PinnedPage(this, &bufPool[frame], frame, bufPool[frame].page_number());
+  }
+
+  FrameId BufMgr::pinNewFrame(File* file, const AccessStrategy strategy)
+  {
+    // get a frame first, so a full pool does not leave an allocated page
+    // behind in the file
+    FrameId frame;
+    if(strategy == NORMAL_ACCESS) {
+      allocBuf(frame);
+    } else {
+      allocRingBuf(frame, file, Page::INVALID_NUMBER, strategy);
+    }
+
+    // allocate empty page directly in the frame
+    try {
+      file -> allocatePage(bufPool[frame]);
+    } catch(...) {
+      releaseFrame(frame);
+      throw;
+    }
+
+    bufStats.add(ALLOCS);
+
+    // get page number
+    const PageId pageNo = bufPool[frame].page_number();
+
+    // insert to hash table
+    // @throws HashAlreadyPresentException if the corresponding page already exists in the hash table
+    // @throws HashTableException if the hash table partition is full
+    try {
+      std::lock_guard<std::mutex> guard(hashTable -> latch(file, pageNo));
+      hashTable -> insert(file, pageNo, frame);
+      bufDescTable[frame].Set(file, pageNo);
+      if(strategy != NORMAL_ACCESS) {
+	bufDescTable[frame].refbit = false;
+      }
+      pageMapped(frame, file, pageNo, strategy != NORMAL_ACCESS);
+    } catch(...) {
+      releaseFrame(frame);
+      throw;
+    }
+    if(strategy != NORMAL_ACCESS) {
+      ringPageSet(file, frame, pageNo, strategy);
+    }
+    return frame;
+  }
+
+  void BufMgr::disposePage(File* file, const PageId PageNo)
+  {
+    bool freed = false;
+    // identify frame
+    FrameId frame;
+    {
+      std::unique_lock<std::mutex> guard(hashTable -> latch(file, PageNo));
+      // a write-back or prefetch of the page must not land after the delete
+      if(hashTable -> probe(file, PageNo, frame) &&
+	 waitForIo(frame, file, PageNo, guard)) {
+	if(bufDescTable[frame].userPins() != 0) {
+	  throw PagePinnedException(file -> filename(), PageNo, frame);
+	}
+
+	// remove from hash table
+	hashTable -> erase(file, PageNo);
+	pageUnmapped(frame, file, PageNo, false);
+	freed = true;
+      }
+    }
+    // remove from buffer pool
+    if(freed) {
+      releaseFrame(frame);
+    }
+    // delete page from file
+    file -> deletePage(PageNo);
+  }
+
+  void BufMgr::resize(const std::uint32_t newNumBufs)
+  {
+    if(newNumBufs == 0 || newNumBufs > maxBufs) {
+      throw BufferExceededException();
+    }
+    std::lock_guard<std::mutex> guard(resizeLatch);
+    const std::uint32_t oldNumBufs = numBufs;
+    if(newNumBufs == oldNumBufs) {
+      return;
+    }
+
+    std::vector<std::uint32_t> targets;
+    shardTargets(newNumBufs, targets);
+    const std::uint32_t count = shards.size();
+
+    if(newNumBufs > oldNumBufs) {
+      // the table needs room for the pages of the new frames before they are handed out
+      hashTable -> resize(newNumBufs);
+
+      // bring shards up to their share; a shard that kept more than its share
+      // on an earlier shrink leaves the rest to the others
+      std::uint32_t needed = newNumBufs - oldNumBufs;
+      for(int pass = 0; pass < 2; pass++) {
+	for(std::uint32_t s = 0; s < count && needed > 0; s++) {
+	  Shard& shard = *shards[s];
+	  std::uint32_t grow = std::min<std::size_t>(needed, shard.retiredFrames.size());
+	  if(pass == 0) {
+	    grow = std::min(grow, targets[s] > shard.numBufs ? targets[s] - shard.numBufs : 0);
+	  }
+	  if(grow == 0) {
+	    continue;
+	  }
+	  const std::vector<FrameId> added(shard.retiredFrames.end() - grow, shard.retiredFrames.end());
+	  shard.retiredFrames.resize(shard.retiredFrames.size() - grow);
+	  touchFrames(shard, added);
+	  shard.numBufs += grow;
+	  shard.poolResized();
+	  for(std::size_t i = 0; i < added.size(); i++) {
+	    bufDescTable[added[i]].retired = false;
+	  }
+	  {
+	    std::lock_guard<std::mutex> freeGuard(shard.freeLatch);
+	    shard.freeFrames.insert(shard.freeFrames.end(), added.begin(), added.end());
+	    shard.freeCount += grow;
+	  }
+	  needed -= grow;
+	}
+      }
+      numBufs = newNumBufs;
+    } else {
+      // take free frames first, then evict the way a miss does, so pinned
+      // pages are never touched; shards that cannot give their share have
+      // the rest taken from the others
+      std::vector<std::vector<FrameId> > taken(count);
+      std::uint32_t needed = oldNumBufs - newNumBufs;
+      for(int pass = 0; pass < 2; pass++) {
+	for(std::uint32_t s = 0; s < count && needed > 0; s++) {
+	  Shard& shard = *shards[s];
+	  std::uint32_t want = std::min<std::uint32_t>(needed, shard.numBufs - taken[s].size());
+	  if(pass == 0) {
+	    want = std::min(want, shard.numBufs > targets[s] ? shard.numBufs - targets[s] : 0);
+	  }
+	  const std::size_t before = taken[s].size();
+	  shard.take(want, taken[s]);
+	  needed -= taken[s].size() - before;
+	}
+      }
+      if(needed > 0) {
+	for(std::uint32_t s = 0; s < count; s++) {
+	  for(std::size_t i = 0; i < taken[s].size(); i++) {
+	    releaseFrame(taken[s][i]);
+	  }
+	}
+	throw BufferExceededException();
+      }
+
+      numBufs = newNumBufs;
+      for(std::uint32_t s = 0; s < count; s++) {
+	Shard& shard = *shards[s];
+	std::vector<FrameId>& frames = taken[s];
+	if(frames.empty()) {
+	  continue;
+	}
+	std::sort(frames.begin(), frames.end(), std::greater<FrameId>());
+	std::size_t run = 0;
+	for(std::size_t i = 0; i < frames.size(); i++) {
+	  bufDescTable[frames[i]].Clear();
+	  bufDescTable[frames[i]].retired = true;
+	  // one call for each run of consecutive frames
+	  if(i + 1 == frames.size() || frames[i + 1] != frames[i] - 1) {
+	    frameArena -> release(frames[i], i - run + 1);
+	    run = i + 1;
+	  }
+	}
+	std::vector<FrameId> merged(shard.retiredFrames.size() + frames.size());
+	std::merge(shard.retiredFrames.begin(), shard.retiredFrames.end(), frames.begin(), frames.end(),
+		   merged.begin(), std::greater<FrameId>());
+	shard.retiredFrames.swap(merged);
+	shard.numBufs -= frames.size();
+	shard.poolResized();
+      }
+      hashTable -> resize(newNumBufs);
+    }
+
+    // rings are capped by the pool size; the old ones are forgotten
+    std::vector<std::unique_lock<std::mutex> > accessGuards;
+    for(std::uint32_t p = 0; p < accessPartitionCount; p++) {
+      accessGuards.push_back(std::unique_lock<std::mutex>(accessPartitions[p].latch));
+    }
+    ringFrames[0] = std::min(ringOptions[0], newNumBufs / 8);
+    ringFrames[1] = std::min(ringOptions[1], newNumBufs / 8);
+    for(std::uint32_t p = 0; p < accessPartitionCount; p++) {
+      std::map<const File*, FileAccess>& files = accessPartitions[p].files;
+      for(std::map<const File*, FileAccess>::iterator it = files.begin(); it != files.end(); ++it) {
+	it -> second.rings[0] = AccessRing();
+	it -> second.rings[1] = AccessRing();
+      }
     }
-    // delete page from file
-    file -> deletePage(PageNo);
   }
 
   void BufMgr::printSelf(void) 
@@ -232,9 +1905,11 @@ namespace badgerdb {
     BufDesc* tmpbuf;
     int validFrames = 0;
   
-    for (std::uint32_t i = 0; i < numBufs; i++)
+    for (std::uint32_t i = 0; i < maxBufs; i++)
       {
   	tmpbuf = &(bufDescTable[i]);
+	if (tmpbuf->retired)
+	  continue;
 	std::cout << "FrameNo:" << i << " ";
 	tmpbuf->Print();
 
@@ -7,8 +7,24 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "file.h"
 #include "bufHashTbl.h"
+#include "bufStats.h"
+#include "frameArena.h"
+#include "pinnedPage.h"
+#include "poolTopology.h"
+#include "warmUp.h"
+#include "policies/indexList.h"
+#include "policies/replacementPolicy.h"
 
 namespace badgerdb {
 
@@ -19,6 +35,11 @@ class BufMgr;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* Fields are atomics so they can be read by scans (flushFile(), printSelf())
+* without latching.  Changes to the pin count and to the page a frame holds
+* are only made while holding the hash table latch of that page, or by the
+* thread that owns a frame which is not in the hash table.
 */
 class BufDesc {
 
@@ -28,12 +49,12 @@ class BufDesc {
 	/**
    * Pointer to file to which corresponding frame is assigned
 	 */
-  File* file;
+  std::atomic<File*> file;
 
 	/**
    * Page within file to which corresponding frame is assigned
 	 */
-  PageId pageNo;
+  std::atomic<PageId> pageNo;
 
 	/**
    * Frame number of the frame, in the buffer pool, being used
@@ -43,22 +64,42 @@ class BufDesc {
 	/**
    * Number of times this page has been pinned
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
 	 */
-  bool dirty;
+  std::atomic<bool> dirty;
 
 	/**
    * True if page is valid
 	 */
-  bool valid;
+  std::atomic<bool> valid;
+
+	/**
+   * Has this buffer frame been reference recently.  Set on every pin; the
+   * clock replacement policy clears it as the hand passes.
+	 */
+  std::atomic<bool> refbit;
+
+	/**
+   * True while the page is being read from disk into the frame, by a
+   * readPage() miss or a prefetch; threads that pin the page meanwhile wait
+   * for it to clear
+	 */
+  std::atomic<bool> loading;
 
 	/**
-   * Has this buffer frame been reference recently
+   * True while BufMgr is writing the page back, to evict it or from the
+   * background writer.  The write-back holds one of the pins counted in pinCnt.
 	 */
-  bool refbit;
+  std::atomic<bool> evicting;
+
+	/**
+   * True while the frame is reserved for the buffer pool but not part of it
+   * (see BufMgr::resize()); left alone by Clear()
+	 */
+  std::atomic<bool> retired;
 
 	/**
    * Initialize buffer frame for a new user
@@ -71,6 +112,8 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    loading = false;
+    evicting = false;
   };
 
 	/**
@@ -90,11 +133,20 @@ class BufDesc {
     refbit = true;
   }
 
+	/**
+	 * Number of pins held by callers, not counting a write-back in progress
+	 */
+  int userPins() const
+  {
+    return pinCnt - (evicting ? 1 : 0);
+  }
+
   void Print()
 	{
-		if(file)
+		File* filePtr = file;
+		if(filePtr)
 		{
-			std::cout << "file:" << file->filename() << " ";
+			std::cout << "file:" << filePtr->filename() << " ";
 			std::cout << "pageNo:" << pageNo << " ";
 		}
 		else
@@ -111,64 +163,355 @@ class BufDesc {
 	 */
   BufDesc()
 	{
+    retired = false;
   	Clear();
   }
 };
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief How a caller is going to use the pages it reads or allocates
+*/
+enum AccessStrategy {
+	/**
+	 * Pages compete for the whole buffer pool under the replacement policy
+	 */
+  NORMAL_ACCESS,
+
+	/**
+	 * Pages are read once, in order; they are read into a small ring of frames
+	 * that is recycled, instead of evicting pages other callers need
+	 */
+  SEQUENTIAL_SCAN,
+
+	/**
+	 * Pages are allocated and written once; like SEQUENTIAL_SCAN, with a larger
+	 * ring so write-backs are spread out
+	 */
+  BULK_WRITE
+};
+
+
+/**
+* @brief Settings a BufMgr is constructed with
 */
-struct BufStats
+struct BufMgrOptions
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Page replacement policy.  Policies other than clock take a latch of
+   * their shard on every hit.
+	 */
+  ReplacementPolicyKind policy;
+
+	/**
+   * Frames in the ring of each file read with SEQUENTIAL_SCAN.  Capped at an
+   * eighth of the pool; 0 makes scans use the pool like NORMAL_ACCESS.
+	 */
+  std::uint32_t scanRingFrames;
+
+	/**
+   * Frames in the ring of each file written with BULK_WRITE, capped likewise
+	 */
+  std::uint32_t bulkWriteRingFrames;
+
+	/**
+   * Misses on ascending pages of one file, at most a few pages apart, after
+   * which further NORMAL_ACCESS reads of it are treated as SEQUENTIAL_SCAN,
+   * until a miss breaks the run.  0 disables the detection.
+	 */
+  std::uint32_t sequentialRunLength;
+
+	/**
+   * Run a background writer thread, which writes out dirty pages the
+   * replacement policy is about to evict so misses rarely have to
+   * write a page back themselves
+	 */
+  bool backgroundWriter;
+
+	/**
+   * Number of upcoming victims the background writer keeps clean
+	 */
+  std::uint32_t cleanFrameTarget;
+
+	/**
+   * Milliseconds the background writer sleeps when it finds nothing to do;
+   * a miss that has to write back a dirty page wakes it early
+	 */
+  std::uint32_t writerIntervalMs;
+
+	/**
+   * Threads reading pages requested with prefetch(), started by the first call
+	 */
+  std::uint32_t prefetchThreads;
+
+	/**
+   * Number of shards the pool is split into, each with its own range of
+   * frames, free list, replacement policy and hash table partitions, and
+   * each page belonging to one of them by its hash.  0 means one per NUMA
+   * node, whose CPUs then first touch the shard's memory, or one per group
+   * of PoolTopology::CPUS_PER_GROUP CPUs without NUMA.  Rounded down to a
+   * power of two no larger than the pool.
+	 */
+  std::uint32_t shards;
+
+	/**
+   * Number of frames BufMgr::resize() may grow the pool to; 0 or less than
+   * the initial size means the initial size.  Address space for them is
+   * reserved up front, but memory only as frames join the pool; frame
+   * descriptors and replacement policy state are allocated for all of them.
 	 */
-  int accesses;
+  std::uint32_t maxBufs;
 
 	/**
-   * Number of pages read from disk (including allocs)
+   * Kind of pages backing the frames.  Huge pages cut TLB misses when
+   * accesses spread over a large pool; explicit ones need pages reserved in
+   * /proc/sys/vm/nr_hugepages.  Where the kind asked for is not available
+   * the pool falls back to transparent and then normal pages, which
+   * BufMgr::getPageBacking() tells.
 	 */
-  int diskreads;
+  PageBacking pageBacking;
 
 	/**
-   * Number of pages written back to disk
+   * File the destructor saves the list of resident pages to, for
+   * BufMgr::warmUp() to read back after a restart; empty saves nothing
 	 */
-  int diskwrites;
+  std::string warmUpPath;
 
 	/**
-   * Clear all values 
+   * Constructor of BufMgrOptions class; defaults to clock replacement
 	 */
-  void clear()
+  BufMgrOptions()
+    : policy(CLOCK_POLICY), scanRingFrames(32), bulkWriteRingFrames(128),
+      sequentialRunLength(16), backgroundWriter(false), cleanFrameTarget(64),
+      writerIntervalMs(20), prefetchThreads(1), shards(1), maxBufs(0),
+      pageBacking(NORMAL_PAGES)
   {
-		accesses = diskreads = diskwrites = 0;
   }
-      
+};
+
+
+/**
+* @brief Settings of one BufMgr::checkpoint()
+*/
+struct CheckpointOptions
+{
+	/**
+   * Also write pinned pages, from a copy taken under the latch of the page;
+   * otherwise they are skipped and stay dirty
+	 */
+  bool copyPinned;
+
+	/**
+   * Most adjacent pages written with one call
+	 */
+  std::uint32_t maxRunPages;
+
+	/**
+   * Most bytes written per second, kept to by sleeping between runs; 0 writes
+   * as fast as the files take them
+	 */
+  std::uint64_t maxBytesPerSecond;
+
 	/**
-   * Constructor of BufStats class 
+   * Constructor of CheckpointOptions class; defaults to unpinned pages in
+   * runs of up to 64, unthrottled
 	 */
-  BufStats()
+  CheckpointOptions()
+    : copyPinned(false), maxRunPages(64), maxBytesPerSecond(0)
   {
-		clear();
   }
 };
 
 
+/**
+* @brief Progress of a BufMgr::warmUp()
+*/
+struct WarmUpStatus
+{
+	/**
+   * True while pages are still being read
+	 */
+  bool running;
+
+	/**
+   * Pages listed for the files warmUp() was given
+	 */
+  std::uint32_t listed;
+
+	/**
+   * Pages read into the pool
+	 */
+  std::uint32_t restored;
+
+	/**
+   * Pages not read: resident already, gone from their file, or left over
+   * when the pool had no free frame left
+	 */
+  std::uint32_t skipped;
+
+	/**
+   * Time taken, so far if still running
+	 */
+  std::uint64_t elapsedNanos;
+
+  WarmUpStatus() : running(false), listed(0), restored(0), skipped(0), elapsedNanos(0) {}
+};
+
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* All public methods may be called concurrently from several threads.  Hits
+* take only the latch of the page's hash table partition; misses read from
+* disk without holding any latch of the buffer pool.  Page contents are not
+* latched: threads sharing a pinned page must coordinate their own access to
+* it, and a page may be written back while another thread is modifying it (it
+* stays dirty and is written again later).
 */
-class BufMgr 
+class BufMgr
 {
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * A slice of the buffer pool: a contiguous range of frames with its own
+   * free list and replacement policy, so threads missing on different shards
+   * share no latch or clock hand.  The policy numbers the frames of the
+   * shard from 0; the shard translates.
+	 */
+  class Shard : public FrameEvictor
+  {
+   public:
+	/**
+	 * Constructor of Shard class; frames from first to first + bufs - 1 start
+	 * out free, the rest retired
+	 */
+    Shard(BufMgr& mgr, const FrameId first, const std::uint32_t frames,
+          const std::uint32_t bufs, const ReplacementPolicyKind kind,
+          const std::uint32_t group);
+    ~Shard();
+
+	/**
+	 * BufMgr the shard belongs to
 	 */
-  FrameId clockHand;
+    BufMgr& mgr;
 
 	/**
-   * Number of frames in the buffer pool
+	 * First frame of the shard, and number of frames reserved for it
 	 */
-  std::uint32_t numBufs;
+    FrameId first;
+    std::uint32_t frames;
+
+	/**
+	 * Number of its frames in the pool; changed only by resize()
+	 */
+    std::uint32_t numBufs;
+
+	/**
+	 * Topology group whose CPUs first touch the shard's frames
+	 */
+    std::uint32_t group;
+
+	/**
+	 * Frames that hold no page and are not owned by any thread, and their
+	 * number, readable without freeLatch
+	 */
+    std::vector<FrameId> freeFrames;
+    std::atomic<std::uint32_t> freeCount;
+
+	/**
+	 * Protects freeFrames
+	 */
+    std::mutex freeLatch;
+
+	/**
+	 * Reserved frames that are not in the pool, the lowest last; protected
+	 * by BufMgr::resizeLatch
+	 */
+    std::vector<FrameId> retiredFrames;
+
+	/**
+	 * Decides which page of the shard to evict when it has no free frame
+	 */
+    ReplacementPolicy *policy;
+
+	/**
+	 * Takes a free frame for the caller, as allocBuf() returns it
+	 *
+	 * @return False if the shard has no free frame
+	 */
+    bool takeFree(FrameId& frame);
+
+	/**
+	 * Has the policy evict a page of the shard, as allocBuf() does
+	 *
+	 * @return False if no page could be evicted
+	 */
+    bool evict(FrameId& frame, const File* file, const PageId pageNo);
+
+	/**
+	 * Takes up to count frames out of use, free ones first, appending them
+	 * to frames, as resize() needs
+	 */
+    void take(const std::uint32_t count, std::vector<FrameId>& frames);
+
+	/**
+	 * Notifications for the policy about a frame of the shard
+	 */
+    void loaded(const FrameId frame, const File* file, const PageId pageNo, const bool cold)
+    {
+      policy -> pageLoaded(frame - first, file, pageNo, cold);
+    }
+    void accessed(const FrameId frame)
+    {
+      policy -> pageAccessed(frame - first);
+    }
+    void removed(const FrameId frame, const File* file, const PageId pageNo, const bool evicted)
+    {
+      policy -> pageRemoved(frame - first, file, pageNo, evicted);
+    }
+
+	/**
+	 * Appends up to count frames the policy expects to evict next to frames
+	 */
+    void upcomingVictims(const std::uint32_t count, std::vector<FrameId>& frames);
+
+	/**
+	 * Tells the policy which of the shard's frames are in the pool, after
+	 * numBufs or retiredFrames changed
+	 */
+    void poolResized();
+
+	/**
+	 * Clock hand steps taken by the calling thread in its last evict(),
+	 * counted through isResident()
+	 */
+    static thread_local std::uint32_t sweepSteps;
+
+	/**
+	 * FrameEvictor operations, forwarded to BufMgr
+	 */
+    bool isResident(const FrameId frame) const { sweepSteps++; return mgr.isResident(first + frame); }
+    bool isPinned(const FrameId frame) const { return mgr.isPinned(first + frame); }
+    bool isReferenced(const FrameId frame) const { return mgr.isReferenced(first + frame); }
+    bool clearReferenced(const FrameId frame) { return mgr.clearReferenced(first + frame); }
+    bool tryEvict(const FrameId frame) { return mgr.tryEvict(first + frame); }
+  };
+
+	/**
+   * Number of frames in the buffer pool; changed only by resize()
+	 */
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+   * Number of frames reserved for the buffer pool, which bufDescTable, the
+   * frame arena and the replacement policy are sized for
+	 */
+  std::uint32_t maxBufs;
+
+	/**
+   * Serializes resize(); protects the shards' retiredFrames and numBufs,
+   * which saveResidentPages() reads under it
+	 */
+  std::mutex resizeLatch;
 	
 	/**
    * Hash table mapping (File, page) to frame
@@ -181,33 +524,504 @@ class BufMgr
   BufDesc *bufDescTable;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Memory backing 'bufPool', one contiguous region for all frames
 	 */
-  BufStats bufStats;
+  FrameArena *frameArena;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * CPUs and memory nodes of the machine
 	 */
-  void advanceClock();
+  PoolTopology topology;
+
+	/**
+   * Shards of the pool, a power of two of them; shard i owns the frames from
+   * i * shardFrames on, and the pages whose hash table partition is i modulo
+   * the number of shards
+	 */
+  std::vector<Shard*> shards;
+  std::uint32_t shardFrames;
+
+	/**
+   * Returns the shard a frame belongs to
+	 */
+  Shard& shardOf(const FrameId frame) const
+  {
+    return *shards[frame / shardFrames];
+  }
+
+	/**
+   * Returns the number of the shard a page belongs to
+	 */
+  std::uint32_t shardFor(const File* file, const PageId pageNo) const
+  {
+    return hashTable -> partitionOf(hashTable -> hashOf(file, pageNo)) & (shards.size() - 1);
+  }
+
+	/**
+   * Returns the number of the shard local to the CPU the caller runs on
+	 */
+  std::uint32_t homeShard() const
+  {
+    return topology.currentGroup() & (shards.size() - 1);
+  }
+
+	/**
+   * Splits a pool of total frames evenly over the shards, within what each
+   * has reserved
+	 */
+  void shardTargets(const std::uint32_t total, std::vector<std::uint32_t>& targets) const;
+
+	/**
+   * On NUMA machines, touches the memory of frames of a shard from a CPU of
+   * its node, so the kernel places it there
+	 */
+  void touchFrames(const Shard& shard, const std::vector<FrameId>& frames);
+
+	/**
+   * Frames recycled by SEQUENTIAL_SCAN or BULK_WRITE accesses to one file
+	 */
+  struct AccessRing {
+    std::vector<FrameId> frames;
+    // page each frame was taken for, so a frame that has since been given
+    // to another page is not recycled
+    std::vector<PageId> pages;
+    std::uint32_t next;
+
+    AccessRing() : next(0) {}
+  };
+
+	/**
+   * Access pattern of one file: its sequential run of misses and its rings
+	 */
+  struct FileAccess {
+    PageId lastMiss;
+    std::uint32_t run;
+    AccessRing rings[2];
+
+    FileAccess() : lastMiss(Page::INVALID_NUMBER), run(0) {}
+  };
+
+	/**
+   * Access patterns of recently used files hashed to one partition, and the
+   * latch protecting them.  Only hints: forgotten wholesale when a partition
+   * grows large, and checked against the frames before use.
+	 */
+  struct AccessPartition {
+    std::map<const File*, FileAccess> files;
+    std::mutex latch;
+  };
+
+	/**
+   * Number of access partitions; misses on files in different partitions
+   * do not wait for each other
+	 */
+  static const std::uint32_t accessPartitionCount = 16;
+
+  AccessPartition accessPartitions[accessPartitionCount];
+
+	/**
+   * Returns the access partition of a file
+	 */
+  AccessPartition& accessPartitionOf(const File* file)
+  {
+    return accessPartitions[(hashTable -> hashOf(file, 0) >> 32) % accessPartitionCount];
+  }
+
+	/**
+   * Frames holding pages of one file, and those of them that are dirty
+	 */
+  struct FileFrames {
+    IndexList resident;
+    IndexList dirty;
+  };
+
+	/**
+   * Frames of every file with pages in the pool, so that flushing or dropping
+   * a file takes time in proportion to its pages rather than to the pool.  A
+   * frame is on its file's resident list while it is in the hash table, and
+   * on the dirty list while it is also dirty.
+	 */
+  std::map<const File*, FileFrames> fileFrames;
+  IndexLinks residentLinks;
+  IndexLinks dirtyLinks;
+
+	/**
+   * Protects fileFrames and the links.  Taken while holding a hash table
+   * latch, never the other way around.
+	 */
+  std::mutex fileFramesLatch;
+
+	/**
+   * Ring sizes for SEQUENTIAL_SCAN and BULK_WRITE, as asked for in
+   * BufMgrOptions and as capped for the current pool size, and the run
+   * length that turns on SEQUENTIAL_SCAN
+	 */
+  std::uint32_t ringOptions[2];
+  std::atomic<std::uint32_t> ringFrames[2];
+  std::uint32_t sequentialRunLength;
+
+	/**
+   * Background writer thread, if BufMgrOptions::backgroundWriter is set
+	 */
+  std::thread writerThread;
+
+	/**
+   * Protects writerStop; writerWake is signalled with it
+	 */
+  std::mutex writerLatch;
+  std::condition_variable writerWake;
+
+	/**
+   * Tells the background writer to exit
+	 */
+  bool writerStop;
+
+	/**
+   * Settings of the background writer, from BufMgrOptions
+	 */
+  std::uint32_t cleanFrameTarget;
+  std::uint32_t writerIntervalMs;
+
+	/**
+   * A page prefetch() mapped into a frame and that still has to be read.
+   * The request holds a pin on the frame until the read is done.
+	 */
+  struct PrefetchRequest {
+    File* file;
+    PageId pageNo;
+    FrameId frame;
+  };
+
+	/**
+   * Reads waiting for a prefetch thread, and the threads
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+  std::vector<std::thread> prefetchers;
+  std::uint32_t prefetchThreads;
+
+	/**
+   * Protects prefetchQueue, prefetchers and prefetchStop; prefetchWake is
+   * signalled with it
+	 */
+  std::mutex prefetchLatch;
+  std::condition_variable prefetchWake;
+
+	/**
+   * Tells the prefetch threads to drop their queue and exit
+	 */
+  bool prefetchStop;
+
+	/**
+   * A page warmUp() is to read
+	 */
+  struct WarmUpPage {
+    File* file;
+    PageId pageNo;
+    std::uint16_t hotness;
+  };
+
+	/**
+   * Thread reading the pages of a warmUp(), and whether it is to stop early
+	 */
+  std::thread warmUpThread;
+  std::atomic<bool> warmUpStop;
+
+	/**
+   * Progress of the last warmUp(), guarded by warmUpLatch
+	 */
+  WarmUpStatus warmUpProgress;
+  std::mutex warmUpLatch;
+
+	/**
+   * File the destructor saves resident pages to, from BufMgrOptions
+	 */
+  std::string warmUpPath;
+
+	/**
+   * Maintains Buffer pool usage statistics 
+	 */
+  BufStatsCollector bufStats;
 
 	/**
 	 * Allocate a free frame.  
 	 *
+	 * The frame is returned invalid, not in the hash table, with a pin count of
+	 * one that belongs to the caller; the caller either fills it and inserts it
+	 * into the hash table or hands it back with releaseFrame().
+	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param file   	File of the page the frame is for, if known; passed on to the policy
+	 * @param pageNo  Page number of the page the frame is for
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, const File* file = NULL,
+                const PageId pageNo = Page::INVALID_NUMBER);
+
+	/**
+	 * As allocBuf(), but only takes a frame that holds no page; never evicts.
+	 *
+	 * @return False if no shard has a free frame
+	 */
+  bool takeFreeBuf(FrameId & frame, const File* file = NULL,
+                   const PageId pageNo = Page::INVALID_NUMBER);
+
+	/**
+	 * As the public readPages(); with evict false the misses only take free
+	 * frames, so no resident page is evicted for them.  Pages read before the
+	 * free frames run out stay resident, unpinned.
+	 *
+	 * @throws BufferExceededException If evict is false and the free frames ran out
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages,
+                 const bool evict);
+
+	/**
+	 * Allocate a frame for a SEQUENTIAL_SCAN or BULK_WRITE access, reusing the
+	 * next frame of the file's ring if it still holds the page the ring put
+	 * there, unpinned and used by nobody else; otherwise as allocBuf(), and
+	 * the frame joins the ring.
+	 *
+	 * @param frame   	Frame ID of allocated frame returned via this variable
+	 * @param file   	File the frame is for
+	 * @param pageNo  Page number the frame is for, if known
+	 * @param strategy  SEQUENTIAL_SCAN or BULK_WRITE
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  void allocRingBuf(FrameId & frame, const File* file, const PageId pageNo,
+                    const AccessStrategy strategy);
+
+	/**
+	 * Records the page a frame from allocRingBuf() was taken for, once it is
+	 * known; pages allocated in the frame only get their number afterwards.
+	 *
+	 * @param file   	File the frame is for
+	 * @param frame   	Frame ID returned by allocRingBuf()
+	 * @param pageNo  Page number now in the frame
+	 * @param strategy  SEQUENTIAL_SCAN or BULK_WRITE
+	 */
+  void ringPageSet(const File* file, const FrameId frame, const PageId pageNo,
+                   const AccessStrategy strategy);
+
+	/**
+	 * Records a miss on a NORMAL_ACCESS read and returns SEQUENTIAL_SCAN if it
+	 * extends a long enough run of misses on ascending, nearly consecutive pages
+	 * of the file (a scan skips the pages that are already resident).
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number that missed
+	 */
+  AccessStrategy detectStrategy(const File* file, const PageId pageNo);
+
+	/**
+	 * Records that frame now holds (file, pageNo), just inserted into the
+	 * hash table: tells the replacement policy and adds the frame to the
+	 * file's frames.  Called with the latch of the page held.
+	 *
+	 * @param cold    True if the page is not expected to be used again soon
+	 */
+  void pageMapped(const FrameId frame, const File* file, const PageId pageNo,
+                  const bool cold);
+
+	/**
+	 * Records that (file, pageNo), just erased from the hash table, no longer
+	 * occupies frame, and clears its dirty flag.  Called with the latch of the
+	 * page held.
+	 *
+	 * @param evicted True if the page is leaving to make room for another
+	 */
+  void pageUnmapped(const FrameId frame, const File* file, const PageId pageNo,
+                    const bool evicted);
+
+	/**
+	 * Sets the dirty flag of a frame in the hash table, keeping the dirty
+	 * frames of its file up to date.  Called with the latch of its page held.
+	 */
+  void setDirty(const FrameId frame, const bool dirty);
+
+	/**
+	 * Returns the (page number, frame) pairs of the file's resident pages in
+	 * page number order.  Only a snapshot: each must be checked again under
+	 * the latch of its page.
+	 */
+  void residentFrames(const File* file, std::vector<std::pair<PageId, FrameId> >& frames);
+
+	/**
+	 * Puts a frame owned by the caller (see allocBuf()) back on the free list.
+	 *
+	 * @param frame   	Frame to release
+	 */
+  void releaseFrame(const FrameId frame);
+
+	/**
+	 * Writes back a dirty, unpinned page and evicts it from its frame.  Called
+	 * with guard holding the hash table latch of the page; the latch is dropped
+	 * during the write, so other threads may pin the page meanwhile, in which
+	 * case it stays resident.
+	 *
+	 * @param frame   	Frame holding the page
+	 * @param file   	File of the page
+	 * @param pageNo  Page number of the page
+	 * @param guard   Holds the latch of (file, pageNo); held again on return
+	 * @return True if the frame was evicted and is now owned by the caller, as with allocBuf()
+	 */
+  bool writeBackAndEvict(const FrameId frame, File* file, const PageId pageNo,
+                         std::unique_lock<std::mutex>& guard);
+
+	/**
+	 * Writes back the page in a frame if it is dirty and unpinned, leaving it
+	 * resident.  Used by the background writer.
+	 *
+	 * @param frame   	Frame to clean
+	 * @return True if the page was written
+	 */
+  bool cleanFrame(const FrameId frame);
+
+	/**
+	 * A dirty page found by checkpoint()
+	 */
+  struct CheckpointPage {
+    File* file;
+    PageId pageNo;
+    FrameId frame;
+  };
+
+	/**
+	 * Takes a dirty page for checkpoint() to write and marks it clean.  An
+	 * unpinned page is pinned for the write, as cleanFrame() does, and its frame
+	 * appended to held; a pinned one is copied to copy, unless that is NULL.
+	 *
+	 * @return The page image to write, NULL if the page is not to be written
+	 */
+  const Page* claimDirty(const CheckpointPage& page, Page* copy,
+                         std::vector<FrameId>& held);
+
+	/**
+	 * Drops the pins claimDirty() took for a run of checkpoint() once it is
+	 * written, and marks the pages of the run dirty again if the write failed.
+	 */
+  void releaseClaimed(const std::vector<CheckpointPage>& run,
+                      const std::vector<FrameId>& held, const bool written);
+
+	/**
+	 * Body of the background writer thread: cleans the policy's upcoming
+	 * victims until the destructor stops it.
+	 */
+  void runWriter();
+
+	/**
+	 * Body of a prefetch thread: reads queued pages until the destructor stops it.
+	 */
+  void runPrefetcher();
+
+	/**
+	 * Body of the warm-up thread: reads the pages, hottest first, in batches
+	 * sorted by file and page number, into free frames only; it stops at the
+	 * first page that finds none.
+	 */
+  void runWarmUp(std::vector<WarmUpPage> pages);
+
+	/**
+	 * Stops the warm-up thread, if any, and waits for it.
+	 */
+  void stopWarmUp();
+
+	/**
+	 * Completes a prefetch request: reads the page into its frame and drops
+	 * the request's pin, or, if the read fails or read is false, removes the
+	 * page from the pool as a failed readPage() does.
+	 *
+	 * @param request Request to complete
+	 * @param read    False to abandon the request without reading
+	 */
+  void finishPrefetch(const PrefetchRequest& request, const bool read);
+
+	/**
+	 * Waits until a read or write-back of (file, pageNo) in frame, if any, is
+	 * over.  Called with guard holding the latch of the page; it is dropped
+	 * while waiting and held again on return.
+	 *
+	 * @return True if the frame still holds the page
+	 */
+  bool waitForIo(const FrameId frame, const File* file, const PageId pageNo,
+                 std::unique_lock<std::mutex>& guard);
+
+	/**
+	 * Pins the page if it is in the buffer pool, waiting for the read if another
+	 * thread is still bringing it in.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frame   	Frame holding the page, returned via this variable
+	 * @param touch   True to count this as a use of the page (set its refbit
+	 *                and tell the replacement policy)
+	 * @return True if the page was found and pinned
+	 */
+  bool pinResident(File* file, const PageId pageNo, FrameId& frame, const bool touch);
+
+	/**
+	 * Does the work of readPage() and pinPage(): pins the page, reading it in
+	 * on a miss.
+	 *
+	 * @return Frame holding the page
+	 */
+  FrameId pinFrame(File* file, const PageId pageNo, const AccessStrategy strategy);
+
+	/**
+	 * Does the work of allocPage() and pinNewPage(): allocates a page in the
+	 * file and pins it in a frame.
+	 *
+	 * @return Frame holding the page
+	 */
+  FrameId pinNewFrame(File* file, const AccessStrategy strategy);
+
+	/**
+	 * Reads a page of a file into a frame, counting the read in the statistics.
+	 *
+	 * @throws  InvalidPageException  If the page is not used in the file
+	 */
+  void readFrame(File* file, const PageId pageNo, const FrameId frame);
+
+	/**
+	 * Writes the page in a frame back to its file, timing the write in the
+	 * statistics.
+	 */
+  void writeFrame(File* file, const FrameId frame);
+
+	/**
+	 * Drops a pin held by a PinnedPage.  The pin keeps the frame from changing
+	 * hands, so the page is not looked up; only marking it dirty takes the
+	 * latch of its hash table partition.
+	 *
+	 * @param frame   	Frame holding the page
+	 * @param dirty		True if the page needs to be marked dirty
+	 */
+  void unPinFrame(const FrameId frame, const bool dirty);
+
+  friend class PinnedPage;
+
+	/**
+	 * FrameEvictor operations used by the replacement policies, through the shards
+	 */
+  bool isResident(const FrameId frame) const;
+  bool isPinned(const FrameId frame) const;
+  bool isReferenced(const FrameId frame) const;
+  bool clearReferenced(const FrameId frame);
+  bool tryEvict(const FrameId frame);
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Actual buffer pool from which frames are allocated.  Frame i is always at
+   * bufPool + i; the memory is owned by 'frameArena'.
 	 */
   Page* bufPool;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Number of frames in the buffer pool
+	 * @param options Replacement policy and other settings
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const BufMgrOptions& options = BufMgrOptions());
 	
 	/**
    * Destructor of BufMgr class
@@ -218,12 +1032,86 @@ class BufMgr
 	 * Reads the given page from the file into a frame and returns the pointer to page.
 	 * If the requested page is already present in the buffer pool pointer to that frame is returned
 	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 * Pages of a file opened with File::openMapped() are returned straight from
+	 * its mapping, without a frame or any I/O, and must not be modified.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy  How the caller is going to use this and the following pages
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  void readPage(File* file, const PageId PageNo, Page*& page,
+                const AccessStrategy strategy = NORMAL_ACCESS);
+
+	/**
+	 * Reads the given page as readPage() does and returns a handle holding the
+	 * pin, which unpins the page when it is destroyed or released, without
+	 * another hash table lookup.  For a page of a mapped file the handle holds
+	 * no pin, and markDirty() has no effect.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param strategy  How the caller is going to use this and the following pages
+	 * @return Handle to the pinned page
+	 */
+  PinnedPage pinPage(File* file, const PageId pageNo,
+                     const AccessStrategy strategy = NORMAL_ACCESS);
+
+	/**
+	 * Reads a batch of pages of the file into the buffer pool and pins them,
+	 * as readPage() would one by one.  Hash table latches are taken once per
+	 * partition for the whole batch, and misses are read in page number order,
+	 * each run of consecutive pages with a single File::readPages() call.
+	 *
+	 * Either all pages are pinned, or, if any of them cannot be read, none is
+	 * and the first error is thrown.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers to read, in any order; duplicates are pinned
+	 *                once per occurrence
+	 * @param pages   Pointers to the pages, in the order of pageNos, returned
+	 *                via this variable
+	 * @throws BufferExceededException If not enough frames can be allocated
+	 * @throws InvalidPageException If a page doesn't exist in the file or is not used
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages);
+
+	/**
+	 * Unpins a batch of pages of the file, as unPinPage() would one by one,
+	 * taking each hash table latch once.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers, in any order
+	 * @param dirty		True if the pages need to be marked dirty
+	 * @throws  PageNotPinnedException If a page is not pinned; the other pages
+	 *          of the batch are unpinned nonetheless
+	 */
+  void unPinPages(File* file, const std::vector<PageId>& pageNos, const bool dirty);
+
+	/**
+	 * Starts reading the given pages of the file into the buffer pool in the
+	 * background, and returns without waiting.  A later readPage() of one of
+	 * them hits, or waits only for its read.  Prefetched pages are not pinned
+	 * and are the first to be evicted until somebody reads them.
+	 *
+	 * Pages already in the pool are skipped, and prefetching stops early
+	 * without an error when no frame can be had.  A page that cannot be read
+	 * is dropped; the error shows when it is read with readPage().  The file
+	 * must stay open until the reads are done; flushFile() waits for them.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers, in any order
+	 */
+  void prefetch(File* file, const std::vector<PageId>& pageNos);
+
+	/**
+	 * Prefetches the count pages of the file starting at first.
+	 *
+	 * @param file   	File object
+	 * @param first   First page number
+	 * @param count   Number of pages
+	 */
+  void prefetch(File* file, const PageId first, const PageId count);
 
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
@@ -232,6 +1120,7 @@ class BufMgr
 	 * @param PageNo  Page number
 	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
    * @throws  PageNotPinnedException If the page is not already pinned
+   * @throws  FileReadOnlyException If dirty is set for a page of a mapped file
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
@@ -242,13 +1131,28 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param strategy  How the caller is going to use this and the following pages
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  void allocPage(File* file, PageId &PageNo, Page*& page,
+                 const AccessStrategy strategy = NORMAL_ACCESS); 
+
+	/**
+	 * Allocates a new, empty page in the file as allocPage() does and returns
+	 * a handle holding its pin; PinnedPage::pageNo() gives its number.  A new
+	 * page is only written back if the handle is marked dirty.
+	 *
+	 * @param file   	File object
+	 * @param strategy  How the caller is going to use this and the following pages
+	 * @return Handle to the pinned page
+	 */
+  PinnedPage pinNewPage(File* file, const AccessStrategy strategy = NORMAL_ACCESS);
 
 	/**
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
+	 * Ends with File::sync(), so the writes are as durable as the file's
+	 * SyncMode makes them.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
@@ -256,26 +1160,138 @@ class BufMgr
 	 */
   void flushFile(const File* file);
 
+	/**
+	 * Saves the list of resident pages, with how hot the replacement policy
+	 * holds each of them, for warmUp() to read back into another BufMgr.
+	 * Waits for a resize() in progress, and holds off others while it ranks
+	 * the pages.
+	 *
+	 * @param path  File to write the list to
+	 * @return False if the list could not be written
+	 */
+  bool saveResidentPages(const std::string& path);
+
+	/**
+	 * Starts reading the pages of a list saved by saveResidentPages() back into
+	 * the buffer pool, in the background, and returns without waiting.  Pages
+	 * are read hottest first, in batches sorted by file and page number whose
+	 * runs of adjacent pages are read with one call each, as readPages() does.
+	 * Only free frames are filled, so pages already in use are never evicted
+	 * for the warm-up, and foreground readPage() calls only ever wait for the
+	 * read of the page they want.  Warm-up reads count as misses in the
+	 * statistics.  A warm-up still running is stopped first.
+	 *
+	 * @param path  File the list was saved to
+	 * @param files Open files to read pages of, by name; pages of other files
+	 *              in the list are ignored.  They must stay open until the
+	 *              warm-up is over (see waitForWarmUp()).
+	 * @return False if the list could not be read; nothing is started
+	 */
+  bool warmUp(const std::string& path, const std::map<std::string, File*>& files);
+
+	/**
+	 * Returns the progress of the last warmUp()
+	 */
+  WarmUpStatus getWarmUpStatus();
+
+	/**
+	 * Waits for the last warmUp() to finish and returns how it went.
+	 */
+  WarmUpStatus waitForWarmUp();
+
+	/**
+	 * Writes back the dirty pages of every file, leaving them in the buffer
+	 * pool, clean.  Pages are written in file and page number order, runs of
+	 * adjacent pages with a single File::writePages() call each, so disks see
+	 * mostly sequential writes; every file written to ends with File::sync().
+	 * Pinned pages are skipped, or written from a copy if options ask for it,
+	 * and pages being read or written back already are left to that.  Pages
+	 * dirtied meanwhile stay dirty.
+	 *
+	 * @param options Pinned pages, run length and rate limit
+	 * @return Number of pages written
+	 * @throws  InvalidPageException If a dirty page has been deleted from its
+	 *          file; the pages of its run stay dirty, those before are written
+	 */
+  std::uint32_t checkpoint(const CheckpointOptions& options = CheckpointOptions());
+
+	/**
+	 * Removes every page of the file from the buffer pool without writing any
+	 * of them back, e.g. before the file is deleted.  Takes time in
+	 * proportion to the file's resident pages.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool;
+   *          every page is checked before any is dropped, so the pages all
+   *          stay unless another thread pins one of them meanwhile
+	 */
+  void dropFile(const File* file);
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
+   * @throws  PagePinnedException If the page is pinned in the buffer pool
 	 */
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Changes the number of frames in the buffer pool, while it is in use.
+	 * Growing hands frames reserved with BufMgrOptions::maxBufs to the pool.
+	 * Shrinking takes frames out as misses would get them, free ones first,
+	 * then by evicting unpinned pages the replacement policy chooses, writing
+	 * them back if dirty, and releases their memory; pinned pages stay where
+	 * they are.  The hash table is resized along with the pool, one partition
+	 * at a time.
+	 *
+	 * @param newNumBufs  New number of frames, from 1 to the reserved number
+	 * @throws BufferExceededException If newNumBufs is out of range, or too
+	 *         many pages are pinned to shrink the pool that far; the pool
+	 *         keeps its size
+	 */
+  void resize(const std::uint32_t newNumBufs);
+
+	/**
+   * Returns the number of frames in the buffer pool
+	 */
+  std::uint32_t getNumBufs() const
+  {
+    return numBufs;
+  }
+
+	/**
+   * Returns the kind of pages the frames got, which may be less than
+   * BufMgrOptions::pageBacking asked for
+	 */
+  PageBacking getPageBacking() const
+  {
+    return frameArena->backing();
+  }
+
+	/**
+   * Returns how many bytes of frame memory are backed by huge pages now
+	 */
+  std::size_t getHugePageBytes() const
+  {
+    return frameArena->hugePageBytes();
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
 
 	/**
-   * Get buffer pool usage statistics
+   * Get buffer pool usage statistics, as a snapshot of the counters at the
+   * time of the call
 	 */
-  BufStats & getBufStats()
+  BufStats getBufStats() const
   {
-		return bufStats;
+		BufStats stats;
+		bufStats.snapshot(stats);
+		return stats;
   }
 
 	/**
@@ -6,39 +6,99 @@
  */
 
 #include "file.h"
+#include "bufTrace.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/file_read_only_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+namespace {
+
+// Alignment of buffers, offsets and sizes for direct I/O
+const std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
+// Bytes before the first page of an aligned file
+const std::size_t ALIGNED_HEADER_SIZE = 4096;
+
+// Written after the file header in aligned files
+const char ALIGNED_MAGIC[8] = {'B', 'D', 'B', 'A', 'L', 'I', 'G', 'N'};
+
+char* allocateAligned(const std::size_t size) {
+  void* memory = NULL;
+  if (posix_memalign(&memory, DIRECT_IO_ALIGNMENT, size) != 0) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(memory);
+}
+
+// Buffer aligned for direct I/O, freed when it goes out of scope
+class AlignedBuffer {
+ public:
+  explicit AlignedBuffer(const std::size_t size)
+      : data_(allocateAligned(size)) {}
+  ~AlignedBuffer() { std::free(data_); }
+  char* get() const { return data_; }
+
+ private:
+  AlignedBuffer(const AlignedBuffer&);
+  AlignedBuffer& operator=(const AlignedBuffer&);
+
+  char* data_;
+};
+
+}
+
+File::DescriptorMap File::open_descriptors_;
 File::CountMap File::open_counts_;
+File::LatchMap File::open_latches_;
+File::OpenFileStateMap File::open_file_states_;
+std::mutex File::open_files_latch_;
 
-File File::create(const std::string& filename) {
-  return File(filename, true /* create_new */);
+File File::create(const std::string& filename, const FileFormat format) {
+  return File(filename, true /* create_new */, format);
 }
 
 File File::open(const std::string& filename) {
   return File(filename, false /* create_new */);
 }
 
+File File::openMapped(const std::string& filename) {
+  File file(filename, false /* create_new */);
+  file.map();
+  return file;
+}
+
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
     throw FileNotFoundException(filename);
   }
-  if (isOpen(filename)) {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
+  if (open_counts_.find(filename) != open_counts_.end()) {
     throw FileOpenException(filename);
   }
   std::remove(filename.c_str());
@@ -48,6 +108,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -62,9 +123,42 @@ bool File::exists(const std::string& filename) {
 	return false;
 }
 
+void File::migrate(const std::string& filename) {
+  if (isOpen(filename)) {
+    throw FileOpenException(filename);
+  }
+  const std::string temporary = filename + ".migrate";
+  {
+    File source = File::open(filename);
+    if (source.format() == FORMAT_ALIGNED) {
+      return;
+    }
+    if (exists(temporary)) {
+      std::remove(temporary.c_str());
+    }
+    File target = File::create(temporary, FORMAT_ALIGNED);
+    target.setSyncMode(SYNC_FDATASYNC);
+    // Page images move as they are, free pages and list pointers included.
+    const FileHeader header = source.readHeader();
+    Page page;
+    for (PageId page_number = 1; page_number < header.num_pages; ++page_number) {
+      source.readPage(page_number, true /* allow_free */, page);
+      target.writePage(page_number, page);
+    }
+    target.writeHeader(header);
+    target.sync();
+  }
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    throw std::ios_base::failure("cannot replace " + filename);
+  }
+}
+
 File::File(const File& other)
-  : filename_(other.filename_),
-    stream_(open_streams_[filename_]) {
+  : filename_(other.filename_) {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
+  fd_ = open_descriptors_[filename_];
+  latch_ = open_latches_[filename_];
+  state_ = open_file_states_[filename_];
   ++open_counts_[filename_];
 }
 
@@ -82,91 +176,153 @@ File::~File() {
 }
 
 Page File::allocatePage() {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePage(new_page);
+  return new_page;
+}
+
+void File::allocatePage(Page& new_page) {
+  BUF_TRACE_SCOPE(trace, TRACE_FILE_ALLOC, TraceEvent::NONE, TraceEvent::NONE);
+  checkWritable();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  loadFreeRuns();
+  new_page.initialize();
+  PageId page_number;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
+    page_number = header.first_free_page;
+    readPage(page_number, true /* allow_free */, new_page);
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
-
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
+    markUsed(page_number);
 
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
-    new_page.set_page_number(header.num_pages);
-    if (header.first_used_page == Page::INVALID_NUMBER) {
-      header.first_used_page = new_page.page_number();
-    } else {
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+    page_number = header.num_pages;
     ++header.num_pages;
   }
-  writePage(new_page.page_number(), new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
+  new_page.set_page_number(page_number);
+
+  // The used list is in page number order, so the new page goes right after
+  // the used page before it, or at the head if there is none.
+  const PageId previous = usedPageBefore(page_number);
+  Page previous_page;
+  if (previous == Page::INVALID_NUMBER) {
+    new_page.set_next_page_number(header.first_used_page);
+    header.first_used_page = page_number;
+  } else {
+    readPage(previous, false /* allow_free */, previous_page);
+    new_page.set_next_page_number(previous_page.next_page_number());
+    previous_page.set_next_page_number(page_number);
+  }
+
+  writePage(page_number, new_page);
+  if (previous_page.isUsed()) {
     // If we updated an existing page by inserting the new page into the
     // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page);
+    writePage(previous, previous_page);
   }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page File::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
-  if (page_number >= header.num_pages) {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void File::readPage(const PageId page_number, Page& page) const {
+  BUF_TRACE_SCOPE(trace, TRACE_FILE_READ, page_number, 1);
+  if (page_number >= readHeader().num_pages) {
     throw InvalidPageException(page_number, filename_);
   }
-  return readPage(page_number, false /* allow_free */);
+  readPage(page_number, false /* allow_free */, page);
+}
+
+void File::readPages(const PageId first_page_number, const std::uint32_t count,
+                     Page* const pages[]) const {
+  BUF_TRACE_SCOPE(trace, TRACE_FILE_READ, first_page_number, count);
+  {
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    FileHeader header = readHeader();
+    if (first_page_number + count > header.num_pages) {
+      throw InvalidPageException(std::max(first_page_number, header.num_pages),
+                                 filename_);
+    }
+    // The pages are adjacent on disk, so one read serves the whole run, once
+    // any of them still being written behind are out.
+    const OpenFileState& state = *state_;
+    if (state.count != 0 && first_page_number < state.first + state.count &&
+        state.first < first_page_number + count) {
+      writePending();
+    }
+  }
+  const OpenFileState& state = *state_;
+  if (state.mapping != NULL) {
+    for (std::uint32_t i = 0; i < count; ++i) {
+      std::memcpy(static_cast<void*>(pages[i]), mappedPage(first_page_number + i),
+                  Page::SIZE);
+    }
+    return;
+  }
+  std::vector<struct iovec> iov(count);
+  for (std::uint32_t i = 0; i < count; ++i) {
+    iov[i].iov_base = pages[i];
+    iov[i].iov_len = Page::SIZE;
+  }
+  readAt(&iov[0], count, pagePosition(first_page_number));
+  for (std::uint32_t i = 0; i < count; ++i) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+  }
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  readPage(page_number, allow_free, page);
+  return page;
+}
+
+void File::readPage(const PageId page_number, const bool allow_free,
+                    Page& page) const {
+  // Header and data are laid out in a Page exactly as they are on disk.
+  // Only the write-behind run needs the latch; the read itself does not.
+  const OpenFileState& state = *state_;
+  if (state.mapping != NULL) {
+    if (page_number == Page::INVALID_NUMBER || page_number >= state.mapped_pages) {
+      std::memset(static_cast<void*>(&page), 0, Page::SIZE);
+    } else {
+      std::memcpy(static_cast<void*>(&page),
+                  state.mapping + pagePosition(page_number), Page::SIZE);
+    }
+    if (!allow_free && !page.isUsed()) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    return;
+  }
+  bool copied = false;
+  {
+    std::lock_guard<std::recursive_mutex> guard(*latch_);
+    const char* pending = pendingPage(page_number);
+    if (pending != NULL) {
+      std::memcpy(static_cast<void*>(&page), pending, Page::SIZE);
+      copied = true;
+    }
+  }
+  if (!copied) {
+    readAt(&page, Page::SIZE, pagePosition(page_number));
+  }
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void File::writePage(const Page& new_page) {
+  BUF_TRACE_SCOPE(trace, TRACE_FILE_WRITE, new_page.page_number(), TraceEvent::NONE);
+  checkWritable();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   PageHeader header = readPageHeader(new_page.page_number());
   if (header.current_page_number == Page::INVALID_NUMBER) {
     // Page has been deleted since it was read.
@@ -181,37 +337,131 @@ void File::writePage(const Page& new_page) {
   writePage(new_page.page_number(), header, new_page);
 }
 
+void File::writePages(const PageId first_page_number, const std::uint32_t count,
+                      const Page* const pages[]) {
+  BUF_TRACE_SCOPE(trace, TRACE_FILE_WRITE, first_page_number, count);
+  checkWritable();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader file_header = readHeader();
+  if (first_page_number + count > file_header.num_pages) {
+    throw InvalidPageException(std::max(first_page_number, file_header.num_pages),
+                               filename_);
+  }
+  // Pages still written behind are written first, both so the run reads
+  // their headers and so they cannot land on top of it later.
+  writePending();
+  const std::size_t size = std::size_t(count) * Page::SIZE;
+  AlignedBuffer image(size);
+  readAt(image.get(), size, pagePosition(first_page_number));
+  for (std::uint32_t i = 0; i < count; ++i) {
+    char* page_image = image.get() + std::size_t(i) * Page::SIZE;
+    PageHeader header;
+    std::memcpy(&header, page_image, sizeof(header));
+    if (header.current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    // Keep the next page pointer on disk, as writePage() does.
+    const PageId next_page_number = header.next_page_number;
+    header = pages[i]->header_;
+    header.next_page_number = next_page_number;
+    std::memcpy(page_image, &header, sizeof(header));
+    std::memcpy(page_image + sizeof(header), &pages[i]->data_[0], Page::DATA_SIZE);
+  }
+  writeAt(image.get(), size, pagePosition(first_page_number));
+  if (state_->mode == FSYNC_EACH_WRITE) {
+    syncToDisk(true /* metadata */);
+  }
+}
+
 void File::deletePage(const PageId page_number) {
+  checkWritable();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
+  loadFreeRuns();
+  // The page before this one in the used list is the used page with the
+  // next lower number; it, or the header if there is none, must skip it.
+  const PageId previous = usedPageBefore(page_number);
   Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
+  if (previous == Page::INVALID_NUMBER) {
+    assert(header.first_used_page == page_number);
     header.first_used_page = existing_page.next_page_number();
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    readPage(previous, false /* allow_free */, previous_page);
+    previous_page.set_next_page_number(existing_page.next_page_number());
   }
   // Clear the page and add it to the head of the free list.
   existing_page.initialize();
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
+  markFree(page_number);
   if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page);
+    writePage(previous, previous_page);
   }
   writePage(page_number, existing_page);
   writeHeader(header);
 }
 
+PageId File::usedPageBefore(const PageId page_number) const {
+  const std::map<PageId, PageId>& runs = state_->free_runs;
+  const PageId below = page_number - 1;
+  // The run starting last at or before the page below, if it reaches it.
+  std::map<PageId, PageId>::const_iterator run = runs.upper_bound(below);
+  if (run == runs.begin() || (--run)->second < below) {
+    return below;
+  }
+  return run->first - 1;
+}
+
+void File::loadFreeRuns() const {
+  OpenFileState& state = *state_;
+  if (state.free_runs_loaded) {
+    return;
+  }
+  for (PageId page_number = readHeader().first_free_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = readPageHeader(page_number).next_page_number) {
+    markFree(page_number);
+  }
+  state.free_runs_loaded = true;
+}
+
+void File::markFree(const PageId page_number) const {
+  std::map<PageId, PageId>& runs = state_->free_runs;
+  PageId last = page_number;
+  std::map<PageId, PageId>::iterator after = runs.find(page_number + 1);
+  if (after != runs.end()) {
+    last = after->second;
+    runs.erase(after);
+  }
+  std::map<PageId, PageId>::iterator before = runs.lower_bound(page_number);
+  if (before != runs.begin() && (--before)->second == page_number - 1) {
+    before->second = last;
+    return;
+  }
+  runs[page_number] = last;
+}
+
+void File::markUsed(const PageId page_number) const {
+  std::map<PageId, PageId>& runs = state_->free_runs;
+  std::map<PageId, PageId>::iterator run = runs.upper_bound(page_number);
+  assert(run != runs.begin());
+  --run;
+  assert(run->first <= page_number && page_number <= run->second);
+  const PageId last = run->second;
+  if (run->first == page_number) {
+    runs.erase(run);
+  } else {
+    run->second = page_number - 1;
+  }
+  if (last != page_number) {
+    runs[page_number + 1] = last;
+  }
+}
+
 FileIterator File::begin() {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
 }
@@ -220,51 +470,165 @@ FileIterator File::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+File::File(const std::string& name, const bool create_new,
+           const FileFormat format) : filename_(name) {
+  openIfNeeded(create_new, format);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
                          0 /* num_free_pages */, 0 /* first_free_page */};
     writeHeader(header);
+    // A new file is never left on disk without a header.
+    writeCachedHeader();
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new, const FileFormat format) {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    fd_ = open_descriptors_[filename_];
+    latch_ = open_latches_[filename_];
+    state_ = open_file_states_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR | O_CLOEXEC;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags |= O_CREAT | O_EXCL;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    fd_ = ::open(filename_.c_str(), flags, 0666);
+    if (fd_ < 0) {
+      if (create_new && errno == EEXIST) {
+        throw FileExistsException(filename_);
+      }
+      throw std::ios_base::failure("cannot open " + filename_);
+    }
+    latch_.reset(new std::recursive_mutex());
+    state_.reset(new OpenFileState());
+    if (create_new) {
+      state_->format = format;
+    } else {
+      // Only aligned files carry the mark after their header.
+      char block[sizeof(FileHeader) + sizeof(ALIGNED_MAGIC)];
+      readAt(block, sizeof(block), 0 /* offset */);
+      state_->format =
+          std::memcmp(block + sizeof(FileHeader), ALIGNED_MAGIC,
+                      sizeof(ALIGNED_MAGIC)) == 0 ? FORMAT_ALIGNED : FORMAT_PACKED;
+    }
+    open_descriptors_[filename_] = fd_;
+    open_latches_[filename_] = latch_;
+    open_file_states_[filename_] = state_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   --open_counts_[filename_];
-  stream_.reset();
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    // The last user writes out whatever is still buffered.  A destructor
+    // cannot report a failed write; sync() first to see them.
+    try {
+      writePending();
+      writeCachedHeader();
+    } catch (const std::ios_base::failure&) {
+    }
+    if (state_->mapping != NULL) {
+      ::munmap(const_cast<char*>(state_->mapping),
+               state_->mapping_size);
+    }
+    ::close(fd_);
+    open_descriptors_.erase(filename_);
+    open_latches_.erase(filename_);
+    open_file_states_.erase(filename_);
     open_counts_.erase(filename_);
   }
+  fd_ = -1;
+  latch_.reset();
+  state_.reset();
+}
+
+void File::map() {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
+  OpenFileState& state = *state_;
+  if (state.mapping != NULL) {
+    return;
+  }
+  if (open_counts_[filename_] != 1) {
+    throw FileOpenException(filename_);
+  }
+  const FileHeader header = readHeader();
+  struct stat status;
+  if (::fstat(fd_, &status) != 0) {
+    throw std::ios_base::failure("cannot map " + filename_);
+  }
+  void* mapping = ::mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    throw std::ios_base::failure("cannot map " + filename_);
+  }
+  state.mapping = static_cast<const char*>(mapping);
+  state.mapping_size = status.st_size;
+  // Pages cut off by a short file are left out.
+  state.mapped_pages = header.num_pages;
+  while (state.mapped_pages > 1 &&
+         pagePosition(state.mapped_pages - 1) + off_t(Page::SIZE) > status.st_size) {
+    --state.mapped_pages;
+  }
+}
+
+void File::checkWritable() const {
+  if (state_->mapping != NULL) {
+    throw FileReadOnlyException(filename_);
+  }
+}
+
+const Page* File::mappedPage(const PageId page_number) const {
+  const OpenFileState& state = *state_;
+  assert(state.mapping != NULL);
+  if (page_number == Page::INVALID_NUMBER || page_number >= state.mapped_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const Page* page =
+      reinterpret_cast<const Page*>(state.mapping + pagePosition(page_number));
+  if (!page->isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return page;
+}
+
+bool File::adviseAccess(const AccessAdvice advice,
+                        const PageId first_page_number,
+                        const std::uint32_t count) const {
+  const OpenFileState& state = *state_;
+  const off_t start = pagePosition(first_page_number);
+  if (state.mapping != NULL) {
+    static const int ADVICE[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM,
+                                 MADV_WILLNEED};
+    if (start >= off_t(state.mapping_size)) {
+      return true;
+    }
+    const std::size_t end = count == 0 ? state.mapping_size :
+        std::min<std::size_t>(start + off_t(count) * Page::SIZE, state.mapping_size);
+    // madvise() wants the range to start on a memory page.
+    const std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+    const std::size_t aligned = start - start % page_size;
+    return ::madvise(const_cast<char*>(state.mapping) + aligned, end - aligned,
+                     ADVICE[advice]) == 0;
+  }
+  static const int ADVICE[] = {POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL,
+                               POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED};
+  return ::posix_fadvise(fd_, start, off_t(count) * Page::SIZE,
+                         ADVICE[advice]) == 0;
 }
 
 void File::writePage(const PageId page_number, const Page& new_page) {
@@ -273,31 +637,332 @@ void File::writePage(const PageId page_number, const Page& new_page) {
 
 void File::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  OpenFileState& state = *state_;
+  if (state.mode == FLUSH_EACH_WRITE || state.mode == FSYNC_EACH_WRITE) {
+    // Header and data go out in one write.
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<PageHeader*>(&header);
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(&new_page.data_[0]);
+    iov[1].iov_len = Page::DATA_SIZE;
+    writeAt(iov, 2, pagePosition(page_number));
+    if (state.mode == FSYNC_EACH_WRITE) {
+      syncToDisk(true /* metadata */);
+    }
+    return;
+  }
+
+  // Add the page to the run, or overwrite it there; a page that does not
+  // extend the run starts a new one.
+  char* image = const_cast<char*>(pendingPage(page_number));
+  if (image == NULL) {
+    if (state.count == 0 || page_number != state.first + state.count ||
+        state.count == MAX_PENDING_PAGES) {
+      writePending();
+      state.first = page_number;
+    }
+    state.count++;
+    image = &state.pages[(state.count - 1) * Page::SIZE];
+  }
+  std::memcpy(image, &header, sizeof(header));
+  std::memcpy(image + sizeof(header), &new_page.data_[0], Page::DATA_SIZE);
 }
 
-FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+const char* File::pendingPage(const PageId page_number) const {
+  const OpenFileState& state = *state_;
+  if (state.count == 0 || page_number < state.first ||
+      page_number >= state.first + state.count) {
+    return NULL;
+  }
+  return &state.pages[(page_number - state.first) * Page::SIZE];
+}
 
-  return header;
+void File::writePending() const {
+  OpenFileState& state = *state_;
+  if (state.count == 0) {
+    return;
+  }
+  writeAt(&state.pages[0], state.count * Page::SIZE,
+          pagePosition(state.first));
+  state.count = 0;
+}
+
+void File::syncToDisk(const bool metadata) const {
+  if ((metadata ? ::fsync(fd_) : ::fdatasync(fd_)) != 0) {
+    throw std::ios_base::failure("cannot sync " + filename_);
+  }
+}
+
+off_t File::pagePosition(const PageId page_number) const {
+  const off_t header_size = state_->format == FORMAT_ALIGNED ?
+      ALIGNED_HEADER_SIZE : sizeof(FileHeader);
+  return header_size + off_t(page_number - 1) * Page::SIZE;
+}
+
+void File::readAt(struct iovec* iov, int count, off_t offset) const {
+  if (state_->direct && !canTransfer(iov, count, offset)) {
+    readBounced(iov, count, offset);
+    return;
+  }
+  while (count > 0) {
+    const ssize_t done = ::preadv(fd_, iov, std::min(count, IOV_MAX), offset);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL && state_->direct) {
+        dropDirectIO();
+        continue;
+      }
+      throw std::ios_base::failure("cannot read " + filename_);
+    }
+    if (done == 0) {
+      // End of the file.
+      for (; count > 0; ++iov, --count) {
+        std::memset(iov->iov_base, 0, iov->iov_len);
+      }
+      return;
+    }
+    offset += done;
+    std::size_t left = done;
+    for (; count > 0 && left >= iov->iov_len; ++iov, --count) {
+      left -= iov->iov_len;
+    }
+    if (left > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
+void File::readAt(void* buffer, const std::size_t size,
+                  const off_t offset) const {
+  struct iovec iov;
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  readAt(&iov, 1, offset);
+}
+
+void File::writeAt(struct iovec* iov, int count, off_t offset) const {
+  if (state_->direct && !canTransfer(iov, count, offset)) {
+    writeBounced(iov, count, offset);
+    return;
+  }
+  while (count > 0) {
+    const ssize_t done = ::pwritev(fd_, iov, std::min(count, IOV_MAX), offset);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL && state_->direct) {
+        dropDirectIO();
+        continue;
+      }
+      throw std::ios_base::failure("cannot write " + filename_);
+    }
+    offset += done;
+    std::size_t left = done;
+    for (; count > 0 && left >= iov->iov_len; ++iov, --count) {
+      left -= iov->iov_len;
+    }
+    if (left > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
+void File::writeAt(const void* buffer, const std::size_t size,
+                   const off_t offset) const {
+  struct iovec iov;
+  iov.iov_base = const_cast<void*>(buffer);
+  iov.iov_len = size;
+  writeAt(&iov, 1, offset);
+}
+
+bool File::canTransfer(const struct iovec* iov, const int count,
+                       const off_t offset) const {
+  if (!state_->direct) {
+    return true;
+  }
+  if (offset % DIRECT_IO_ALIGNMENT != 0) {
+    return false;
+  }
+  for (int i = 0; i < count; ++i) {
+    if (reinterpret_cast<std::uintptr_t>(iov[i].iov_base) % DIRECT_IO_ALIGNMENT != 0 ||
+        iov[i].iov_len % DIRECT_IO_ALIGNMENT != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void File::readBounced(const struct iovec* iov, const int count,
+                       const off_t offset) const {
+  std::size_t size = 0;
+  for (int i = 0; i < count; ++i) {
+    size += iov[i].iov_len;
+  }
+  const off_t start = offset - offset % DIRECT_IO_ALIGNMENT;
+  const off_t end = (offset + size + DIRECT_IO_ALIGNMENT - 1) /
+      DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  AlignedBuffer bounce(end - start);
+  readAt(bounce.get(), end - start, start);
+  const char* from = bounce.get() + (offset - start);
+  for (int i = 0; i < count; ++i) {
+    std::memcpy(iov[i].iov_base, from, iov[i].iov_len);
+    from += iov[i].iov_len;
+  }
+}
+
+void File::writeBounced(const struct iovec* iov, const int count,
+                        const off_t offset) const {
+  std::size_t size = 0;
+  for (int i = 0; i < count; ++i) {
+    size += iov[i].iov_len;
+  }
+  const off_t start = offset - offset % DIRECT_IO_ALIGNMENT;
+  const off_t end = (offset + size + DIRECT_IO_ALIGNMENT - 1) /
+      DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  AlignedBuffer bounce(end - start);
+  if (start != offset || end != off_t(offset + size)) {
+    // Keep what else is in the blocks; writers hold the latch, so nobody
+    // changes them meanwhile.
+    readAt(bounce.get(), end - start, start);
+  }
+  char* to = bounce.get() + (offset - start);
+  for (int i = 0; i < count; ++i) {
+    std::memcpy(to, iov[i].iov_base, iov[i].iov_len);
+    to += iov[i].iov_len;
+  }
+  writeAt(bounce.get(), end - start, start);
+}
+
+void File::dropDirectIO() const {
+  const int flags = ::fcntl(fd_, F_GETFL);
+  if (flags < 0 || ::fcntl(fd_, F_SETFL, flags & ~O_DIRECT) != 0) {
+    throw std::ios_base::failure("cannot leave direct I/O on " + filename_);
+  }
+  state_->direct = false;
+}
+
+bool File::setDirectIO(const bool enable) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  OpenFileState& state = *state_;
+  if (enable == state.direct) {
+    return true;
+  }
+  if (enable && state.format != FORMAT_ALIGNED) {
+    return false;
+  }
+  const int flags = ::fcntl(fd_, F_GETFL);
+  if (flags < 0 ||
+      ::fcntl(fd_, F_SETFL, enable ? flags | O_DIRECT : flags & ~O_DIRECT) != 0) {
+    return false;
+  }
+  state.direct = enable;
+  return true;
+}
+
+bool File::directIO() const {
+  return state_->direct;
+}
+
+FileFormat File::format() const {
+  return state_->format;
+}
+
+void File::setSyncMode(const SyncMode mode) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  OpenFileState& state = *state_;
+  if (mode == FLUSH_EACH_WRITE || mode == FSYNC_EACH_WRITE) {
+    writePending();
+    if (mode == FSYNC_EACH_WRITE) {
+      writeCachedHeader();
+    }
+    std::free(state.pages);
+    state.pages = NULL;
+  } else if (state.pages == NULL) {
+    state.pages = allocateAligned(MAX_PENDING_PAGES * Page::SIZE);
+  }
+  state.mode = mode;
+}
+
+SyncMode File::syncMode() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return state_->mode;
+}
+
+void File::sync() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  switch (state_->mode) {
+    case SYNC_NONE:
+    case FSYNC_EACH_WRITE:
+      break;
+    case FLUSH_EACH_WRITE:
+    case SYNC_FLUSH:
+      writePending();
+      writeCachedHeader();
+      break;
+    case SYNC_FDATASYNC:
+      writePending();
+      writeCachedHeader();
+      syncToDisk(false /* metadata */);
+      break;
+  }
+}
+
+FileHeader File::readHeader() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  OpenFileState& state = *state_;
+  if (!state.header_cached) {
+    readAt(&state.header, sizeof(state.header), 0 /* offset */);
+    state.header_cached = true;
+  }
+  return state.header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  OpenFileState& state = *state_;
+  state.header = header;
+  state.header_cached = true;
+  state.header_dirty = true;
+  if (state.mode == FSYNC_EACH_WRITE) {
+    writeCachedHeader();
+    syncToDisk(true /* metadata */);
+  }
+}
+
+void File::writeCachedHeader() const {
+  OpenFileState& state = *state_;
+  if (!state.header_dirty) {
+    return;
+  }
+  if (state.format == FORMAT_ALIGNED) {
+    // The whole block, mark included, so that direct I/O can write it.
+    AlignedBuffer block(ALIGNED_HEADER_SIZE);
+    std::memset(block.get(), 0, ALIGNED_HEADER_SIZE);
+    std::memcpy(block.get(), &state.header, sizeof(state.header));
+    std::memcpy(block.get() + sizeof(state.header), ALIGNED_MAGIC,
+                sizeof(ALIGNED_MAGIC));
+    writeAt(block.get(), ALIGNED_HEADER_SIZE, 0 /* offset */);
+  } else {
+    writeAt(&state.header, sizeof(state.header), 0 /* offset */);
+  }
+  state.header_dirty = false;
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  const char* pending = pendingPage(page_number);
+  if (pending != NULL) {
+    std::memcpy(&header, pending, sizeof(header));
+    return header;
+  }
+  readAt(&header, sizeof(header), pagePosition(page_number));
 
   return header;
 }
@@ -7,10 +7,15 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <cstdlib>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #include "page.h"
 
@@ -18,6 +23,92 @@ namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief When writes to a file reach the operating system and the disk.
+ *
+ * In the buffered modes page writes are kept in memory and runs of adjacent
+ * pages are written with one call, when the run is broken or full, when the
+ * page is read as part of a run, or at File::sync(); reads of a page still
+ * waiting there see the new contents.
+ *
+ * The file header is kept in memory in every mode but FSYNC_EACH_WRITE, and
+ * written when sync() flushes or the file is closed.
+ */
+enum SyncMode {
+  /**
+   * Each write is handed to the operating system as it is made; sync() only
+   * writes the header.  This is the default.
+   */
+  FLUSH_EACH_WRITE,
+
+  /**
+   * Buffered; sync() does nothing, writes reach the operating system when
+   * the buffers fill or the file is closed
+   */
+  SYNC_NONE,
+
+  /**
+   * Buffered; sync() hands the writes to the operating system
+   */
+  SYNC_FLUSH,
+
+  /**
+   * Buffered; sync() hands the writes to the operating system and waits for
+   * them to reach the disk with fdatasync()
+   */
+  SYNC_FDATASYNC,
+
+  /**
+   * Each write is flushed and fsync()ed before it returns
+   */
+  FSYNC_EACH_WRITE
+};
+
+/**
+ * @brief How the pages of a file are laid out on disk.
+ */
+enum FileFormat {
+  /**
+   * Pages follow the file header directly, so they start 16 bytes past a
+   * block boundary.  Files written before the aligned format was added have
+   * this layout; File::migrate() rewrites them.
+   */
+  FORMAT_PACKED,
+
+  /**
+   * The file header has a 4 KB block to itself, marked as aligned, and every
+   * page starts on a 4 KB boundary, as direct I/O needs.  This is the default
+   * for new files.
+   */
+  FORMAT_ALIGNED
+};
+
+/**
+ * @brief How a range of pages is going to be read, passed on to the
+ *        operating system by File::adviseAccess().
+ */
+enum AccessAdvice {
+  /**
+   * No particular order; undoes the other hints
+   */
+  ADVISE_NORMAL,
+
+  /**
+   * In page number order, so read ahead aggressively
+   */
+  ADVISE_SEQUENTIAL,
+
+  /**
+   * In no order, so do not read ahead
+   */
+  ADVISE_RANDOM,
+
+  /**
+   * Soon, so start reading the pages in now
+   */
+  ADVISE_WILLNEED
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
@@ -60,15 +151,23 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a descriptor of an underlying file on disk, read and
+ * written with positional pread() and pwrite().  Files contain fixed-sized
+ * pages, and they never deallocate space (though they do reuse deleted pages
+ * if possible).  If multiple File objects refer to the same underlying file,
+ * they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_descriptors_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * File objects may be used from several threads.  All File objects for the
+ * same underlying file share one latch (kept in open_latches_ next to the
+ * descriptor).  It guards the file header, the pages still written behind
+ * and the used and free page lists, so writes, allocations and deletions on
+ * one file are serialized.  Reads of pages hold it only to check the page
+ * number, then read without it, so any number of threads may read one file
+ * while another writes other pages of it.  A single File object must not be
+ * assigned to while another thread is using it.
  */
 class File {
  public:
@@ -76,22 +175,40 @@ class File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param format    Layout of its pages on disk.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static File create(const std::string& filename);
+  static File create(const std::string& filename,
+                     const FileFormat format = FORMAT_ALIGNED);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_descriptors_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
   static File open(const std::string& filename);
 
+  /**
+   * Opens a file that is no longer written for reading straight from a
+   * read-only memory mapping of it.  Reads copy from the mapping without a
+   * system call, mappedPage() hands out views into it, and BufMgr pins its
+   * pages without a frame or any I/O.  Every File object for the file is
+   * read-only until the last one is closed: allocating, writing or deleting
+   * pages throws FileReadOnlyException.  Pages appended to the file by other
+   * processes after it was mapped are not seen.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileOpenException       If the file is already open and not
+   *                                  mapped.
+   */
+  static File openMapped(const std::string& filename);
+
   /**
    * Deletes an existing file.
    *
@@ -116,6 +233,17 @@ class File {
    */
   static bool exists(const std::string& filename);
 
+  /**
+   * Rewrites a file in FORMAT_PACKED as FORMAT_ALIGNED, through a temporary
+   * file renamed over it.  Page numbers and contents, the used and free page
+   * lists and the header are kept.  Does nothing to an aligned file.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileOpenException       If the file is currently open.
+   */
+  static void migrate(const std::string& filename);
+
   /**
    * Copy constructor.
    * 
@@ -145,6 +273,14 @@ class File {
    */
   Page allocatePage();
 
+  /**
+   * Allocates a new page in the file, building it directly in the given page
+   * (for example a buffer pool frame) rather than returning a copy.
+   *
+   * @param new_page  Page to initialize as the newly allocated page.
+   */
+  void allocatePage(Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -155,6 +291,33 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page (for
+   * example a buffer pool frame), header and data in a single read.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.  Its previous contents are lost,
+   *                      even if an exception is thrown.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads a run of consecutive existing pages from the file, with a single
+   * seek, into the given pages.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               count pages to read into, in page number
+   *                            order.  Their previous contents are lost,
+   *                            even if an exception is thrown.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number, const std::uint32_t count,
+                 Page* const pages[]) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -164,6 +327,20 @@ class File {
    */
   void writePage(const Page& new_page);
 
+  /**
+   * Writes a run of consecutive pages into the file, as writePage() would one
+   * by one, with a single read of their headers on disk and a single write.
+   * The pages must have been already allocated in this file.
+   *
+   * @param first_page_number   Number of the first page to write.
+   * @param count               Number of pages to write.
+   * @param pages               count pages to write, in page number order.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or has been deleted; none is written.
+   */
+  void writePages(const PageId first_page_number, const std::uint32_t count,
+                  const Page* const pages[]);
+
   /**
    * Deletes a page from the file.
    *
@@ -171,6 +348,84 @@ class File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Sets how writes to the file are buffered and made durable, for every
+   * File object using the same underlying file.  Leaving a buffered mode
+   * writes out what is buffered.
+   *
+   * @param mode  New mode.
+   */
+  void setSyncMode(const SyncMode mode);
+
+  /**
+   * Returns how writes to the file are buffered and made durable.
+   */
+  SyncMode syncMode() const;
+
+  /**
+   * Turns direct I/O (O_DIRECT) on or off for every File object using the
+   * same underlying file.  Direct reads and writes bypass the operating
+   * system's page cache, so pages kept in a buffer pool are not cached twice.
+   * Page images not on a 4 KB boundary in memory go through an aligned
+   * bounce buffer.  If the file system later refuses a direct read or write,
+   * the file falls back to cached I/O.
+   *
+   * @param enable  Whether to use direct I/O.
+   * @return  False if the file is in FORMAT_PACKED or the file system does
+   *          not support direct I/O; the file is left as it was.
+   */
+  bool setDirectIO(const bool enable);
+
+  /**
+   * Returns true if the file is read and written with direct I/O.
+   */
+  bool directIO() const;
+
+  /**
+   * Returns the layout of the file's pages on disk.
+   */
+  FileFormat format() const;
+
+  /**
+   * Returns true if the file was opened with openMapped().
+   */
+  bool mapped() const { return state_->mapping != NULL; }
+
+  /**
+   * Returns a view of a page of a mapped file, valid until the last File
+   * object for it is closed.  The page must not be modified; the mapping is
+   * read-only.
+   *
+   * @param page_number   Number of page.
+   * @return  The page in the mapping.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  const Page* mappedPage(const PageId page_number) const;
+
+  /**
+   * Tells the operating system how the given pages are going to be read,
+   * with madvise() for a mapped file and posix_fadvise() otherwise.
+   *
+   * @param advice              Expected access.
+   * @param first_page_number   Number of the first page.
+   * @param count               Number of pages; 0 for all pages from the
+   *                            first on.
+   * @return  False if the operating system rejected the hint.
+   */
+  bool adviseAccess(const AccessAdvice advice,
+                    const PageId first_page_number = 1,
+                    const std::uint32_t count = 0) const;
+
+  /**
+   * Sync barrier: writes out buffered pages and the header to the operating
+   * system and, as the sync mode asks, waits for the disk.  Writes made
+   * before the call are covered by it.
+   *
+   * @throws  std::ios_base::failure  If a write or the sync failed.
+   */
+  void sync() const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -201,9 +456,7 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
-  }
+  off_t pagePosition(const PageId page_number) const;
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -214,28 +467,44 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param format      Layout of a new file; an existing file keeps its own.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const FileFormat format = FORMAT_ALIGNED);
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
+   * @param format      Layout of a new file; an existing file keeps its own.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new,
+                    const FileFormat format = FORMAT_ALIGNED);
+
+  /**
+   * Maps the file read-only for openMapped(), unless it already is.
+   *
+   * @throws  FileOpenException   If other File objects use it unmapped.
+   */
+  void map();
+
+  /**
+   * Throws FileReadOnlyException if the file is mapped.
+   */
+  void checkWritable() const;
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <fd_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
@@ -245,8 +514,8 @@ class File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -256,6 +525,19 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into the given page.  Same as above, but
+   * without going through a temporary Page.
+   *
+   * @param page_number   Number of page to read.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPage(const PageId page_number, const bool allow_free,
+                Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -279,19 +561,51 @@ class File {
                  const Page& new_page);
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file, read from disk the first time and kept
+   * in memory from then on.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Sets the header for this file.  It is written to disk by sync() or when
+   * the file is closed, or right away in FSYNC_EACH_WRITE mode.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
+  /**
+   * Writes the header kept in memory to the file if it has changed.
+   */
+  void writeCachedHeader() const;
+
+  /**
+   * Returns the number of the used page before the given page in the used
+   * list, which is kept in page number order: the highest numbered used page
+   * below it, or Page::INVALID_NUMBER if there is none.  Found with one
+   * lookup in the free runs, without reading the file.
+   *
+   * @param page_number   Number of page.
+   */
+  PageId usedPageBefore(const PageId page_number) const;
+
+  /**
+   * Reads the free runs from the free list, if they are not known yet.
+   */
+  void loadFreeRuns() const;
+
+  /**
+   * Adds the page to the free runs, joining the runs on either side of it.
+   */
+  void markFree(const PageId page_number) const;
+
+  /**
+   * Takes the page out of the free runs, splitting the run that held it.
+   */
+  void markUsed(const PageId page_number) const;
+
   /**
    * Reads only the header of the given page from disk (not the record data
    * or slot table).  No bounds checking is performed.
@@ -301,29 +615,194 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
-  typedef std::map<std::string,
-                   std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * State of an open file kept in memory, shared by all File objects for the
+   * file like its descriptor and guarded by its latch.
+   */
+  struct OpenFileState {
+    /**
+     * Sync mode of the file.
+     */
+    SyncMode mode;
+
+    /**
+     * Layout of the file, fixed once it is open.
+     */
+    FileFormat format;
+
+    /**
+     * Whether the descriptor is in O_DIRECT mode.  Read without the latch.
+     */
+    std::atomic<bool> direct;
+
+    /**
+     * The file header, once read or written, and whether it has changed
+     * since it was last written to the file.
+     */
+    FileHeader header;
+    bool header_cached;
+    bool header_dirty;
+
+    /**
+     * Run of count adjacent page images, starting at page first, written to
+     * the file yet.  pages has room for MAX_PENDING_PAGES, aligned for direct
+     * I/O, while the file is in a buffered mode and is NULL otherwise.
+     */
+    PageId first;
+    std::uint32_t count;
+    char* pages;
+
+    /**
+     * Read-only mapping of the whole file, of mapping_size bytes, if it was
+     * opened with openMapped(), and the number of pages it holds.  Set before
+     * other File objects can share the state, so read without the latch.
+     */
+    const char* mapping;
+    std::size_t mapping_size;
+    PageId mapped_pages;
+
+    /**
+     * Runs of adjacent free pages, from the first page of each to its last.
+     * Read from the free list by the first allocation or deletion after the
+     * file is opened, as free_runs_loaded tells, and kept up to date by them.
+     */
+    std::map<PageId, PageId> free_runs;
+    bool free_runs_loaded;
+
+    OpenFileState()
+        : mode(FLUSH_EACH_WRITE), format(FORMAT_ALIGNED), direct(false),
+          header_cached(false), header_dirty(false), first(0), count(0),
+          pages(NULL), mapping(NULL), mapping_size(0), mapped_pages(0),
+          free_runs_loaded(false) {}
+
+    ~OpenFileState() { std::free(pages); }
+  };
+
+  /**
+   * Most pages kept in a run before it is written.
+   */
+  static const std::uint32_t MAX_PENDING_PAGES = 64;
+
+  /**
+   * Returns the image of the page if it is waiting in the run, NULL if not.
+   */
+  const char* pendingPage(const PageId page_number) const;
+
+  /**
+   * Writes the pending run to the file.
+   */
+  void writePending() const;
+
+  /**
+   * Syncs the file to disk, with fdatasync() or, if metadata is true, with
+   * fsync().
+   */
+  void syncToDisk(const bool metadata) const;
+
+  /**
+   * Reads into the count buffers of iov, one after the other, from the given
+   * offset on, with one preadv() for as long as the kernel does not cut it
+   * short.  Bytes past the end of the file read as zeros.  iov is used up.
+   *
+   * @throws  std::ios_base::failure  If the read failed.
+   */
+  void readAt(struct iovec* iov, int count, off_t offset) const;
+
+  /**
+   * Reads size bytes at the given offset into buffer.
+   */
+  void readAt(void* buffer, const std::size_t size, const off_t offset) const;
+
+  /**
+   * Writes the count buffers of iov, one after the other, from the given
+   * offset on, with one pwritev() for as long as the kernel does not cut it
+   * short.  iov is used up.
+   *
+   * @throws  std::ios_base::failure  If the write failed.
+   */
+  void writeAt(struct iovec* iov, int count, off_t offset) const;
+
+  /**
+   * Writes size bytes from buffer at the given offset.
+   */
+  void writeAt(const void* buffer, const std::size_t size,
+               const off_t offset) const;
+
+  /**
+   * Returns true if a read or write of the buffers of iov at offset can go
+   * to the descriptor as it is, false if direct I/O needs it bounced.
+   */
+  bool canTransfer(const struct iovec* iov, const int count,
+                   const off_t offset) const;
+
+  /**
+   * Reads or writes the buffers of iov at offset through an aligned buffer
+   * covering the whole blocks they touch, for direct I/O.
+   */
+  void readBounced(const struct iovec* iov, const int count,
+                   const off_t offset) const;
+  void writeBounced(const struct iovec* iov, const int count,
+                    const off_t offset) const;
+
+  /**
+   * Takes the descriptor out of O_DIRECT mode after the file system refused
+   * a direct read or write.
+   */
+  void dropDirectIO() const;
+
+  typedef std::map<std::string, int> DescriptorMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string,
+                   std::shared_ptr<std::recursive_mutex> > LatchMap;
+  typedef std::map<std::string,
+                   std::shared_ptr<OpenFileState> > OpenFileStateMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorMap open_descriptors_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Latches for opened files, shared by all File objects for the same file.
+   */
+  static LatchMap open_latches_;
+
+  /**
+   * In-memory states of opened files.
+   */
+  static OpenFileStateMap open_file_states_;
+
+  /**
+   * Protects open_descriptors_, open_counts_, open_latches_ and
+   * open_file_states_.
+   */
+  static std::mutex open_files_latch_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of the underlying filesystem object, -1 once closed.
+   */
+  int fd_;
+
+  /**
+   * Latch guarding the file header, the in-memory state and the page lists
+   * of the file.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * In-memory state of the file.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<OpenFileState> state_;
 
   friend class FileIterator;
   friend class FileTest;
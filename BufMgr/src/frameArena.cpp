@@ -0,0 +1,135 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include "frameArena.h"
+
+namespace badgerdb {
+
+namespace {
+
+// Size of a huge page with 4 KB base pages, on x86-64 and arm64
+const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+std::size_t roundUp(const std::size_t value, const std::size_t multiple)
+{
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+// True unless transparent huge pages are switched off ("[never]")
+bool transparentHugePages()
+{
+  std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string modes;
+  return std::getline(enabled, modes) && modes.find("[never]") == std::string::npos;
+}
+
+}
+
+FrameArena::FrameArena(const std::uint32_t frames, const PageBacking backing)
+	: base(NULL), size(static_cast<std::size_t>(frames) * Page::SIZE),
+	  mapping(NULL), mappedSize(0), pageBacking(NORMAL_PAGES), numFrames(frames)
+{
+  if (size == 0)
+    return;
+
+  // fall back from explicit to transparent huge pages to normal pages
+  if (backing == EXPLICIT_HUGE_PAGES && map(EXPLICIT_HUGE_PAGES))
+    return;
+  if (backing != NORMAL_PAGES && transparentHugePages() && map(TRANSPARENT_HUGE_PAGES))
+    return;
+  if (!map(NORMAL_PAGES))
+    throw std::bad_alloc();
+}
+
+bool FrameArena::map(const PageBacking backing)
+{
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  std::size_t length = size;
+  if (backing == EXPLICIT_HUGE_PAGES) {
+    // the huge pages are reserved up front, so a shortage shows here and
+    // not as a fault later
+    flags |= MAP_HUGETLB;
+    length = roundUp(size, HUGE_PAGE_SIZE);
+  } else {
+    flags |= MAP_NORESERVE;
+    // one huge page more, to start the frames on a huge page boundary
+    if (backing == TRANSPARENT_HUGE_PAGES)
+      length = roundUp(size, HUGE_PAGE_SIZE) + HUGE_PAGE_SIZE;
+  }
+
+  void* memory = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (memory == MAP_FAILED)
+    return false;
+
+  void* start = memory;
+  if (backing == TRANSPARENT_HUGE_PAGES) {
+    start = reinterpret_cast<void*>(roundUp(reinterpret_cast<std::uintptr_t>(memory), HUGE_PAGE_SIZE));
+    if (madvise(start, roundUp(size, HUGE_PAGE_SIZE), MADV_HUGEPAGE) != 0) {
+      munmap(memory, length);
+      return false;
+    }
+  }
+  mapping = memory;
+  mappedSize = length;
+  base = start;
+  pageBacking = backing;
+  return true;
+}
+
+std::size_t FrameArena::hugePageBytes() const
+{
+  if (pageBacking == EXPLICIT_HUGE_PAGES)
+    return size;
+  if (pageBacking != TRANSPARENT_HUGE_PAGES)
+    return 0;
+
+  // sum AnonHugePages over the mappings inside ours; madvise may have split it
+  const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(mapping);
+  const std::uintptr_t last = first + mappedSize;
+  std::ifstream smaps("/proc/self/smaps");
+  std::string line;
+  bool inside = false;
+  std::size_t kilobytes = 0;
+  while (std::getline(smaps, line)) {
+    const std::size_t colon = line.find(':');
+    std::istringstream fields(line);
+    if (colon == std::string::npos || colon > line.find(' ')) {
+      // a mapping header: "start-end perms offset ..."
+      std::uintptr_t start, end;
+      char dash;
+      if (fields >> std::hex >> start >> dash >> end)
+        inside = start >= first && end <= last;
+    } else if (inside && line.compare(0, colon, "AnonHugePages") == 0) {
+      std::string name;
+      std::size_t value;
+      if (fields >> name >> value)
+        kilobytes += value;
+    }
+  }
+  return kilobytes * 1024;
+}
+
+void FrameArena::release(const FrameId first, const std::uint32_t count)
+{
+  if (pageBacking == EXPLICIT_HUGE_PAGES)
+    return;
+  // frames are whole pages of the mapping, so no neighbour is affected
+  madvise(frames() + first, static_cast<std::size_t>(count) * Page::SIZE, MADV_DONTNEED);
+}
+
+FrameArena::~FrameArena()
+{
+  if (mapping)
+    munmap(mapping, mappedSize);
+}
+
+}
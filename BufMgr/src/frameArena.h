@@ -0,0 +1,145 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Kind of memory pages backing a FrameArena
+*/
+enum PageBacking {
+	/**
+	 * Pages of the system page size
+	 */
+  NORMAL_PAGES,
+
+	/**
+	 * Transparent huge pages, asked for with madvise(MADV_HUGEPAGE); the
+	 * kernel backs the arena with them where it can
+	 */
+  TRANSPARENT_HUGE_PAGES,
+
+	/**
+	 * 2 MB pages from the kernel's reserved huge page pool (MAP_HUGETLB)
+	 */
+  EXPLICIT_HUGE_PAGES
+};
+
+/**
+* @brief One contiguous, page-aligned region of memory holding every frame of the buffer pool
+*
+* Frame i lives at frames() + i for the whole lifetime of the arena, so its
+* address never changes and is suitably aligned for direct I/O.  The region
+* comes from a single anonymous mapping with no swap reservation; the kernel
+* hands out zeroed pages lazily, so creating even a very large arena costs one
+* system call.
+*
+* The mapping may be backed by huge pages, which cut the TLB misses of
+* accesses spread over a large pool.  Explicit huge pages fall back to
+* transparent ones, and those to normal pages, when they are not available.
+*/
+class FrameArena
+{
+ private:
+	/**
+	 * Start of the frames
+	 */
+  void* base;
+
+	/**
+	 * Size of the frames in bytes
+	 */
+  std::size_t size;
+
+	/**
+	 * Start and size of the mapping, which may be larger than the frames to
+	 * align them to huge pages
+	 */
+  void* mapping;
+  std::size_t mappedSize;
+
+	/**
+	 * Kind of pages obtained
+	 */
+  PageBacking pageBacking;
+
+	/**
+	 * Number of frames in the arena
+	 */
+  std::uint32_t numFrames;
+
+	/**
+	 * Maps size bytes, aligned to a huge page if backing asks for huge pages,
+	 * and sets the members if it succeeds.
+	 *
+	 * @return True if the memory was mapped with that backing
+	 */
+  bool map(const PageBacking backing);
+
+  FrameArena(const FrameArena&);
+  FrameArena& operator=(const FrameArena&);
+
+ public:
+	/**
+   * Constructor of FrameArena class
+	 *
+	 * @param frames  Number of Page::SIZE frames to reserve
+	 * @param backing Kind of pages wanted; see backing() for what was obtained
+   * @throws std::bad_alloc if the memory could not be mapped
+	 */
+  explicit FrameArena(const std::uint32_t frames, const PageBacking backing = NORMAL_PAGES);
+
+	/**
+   * Destructor of FrameArena class, unmaps the memory
+	 */
+  ~FrameArena();
+
+	/**
+   * Returns a pointer to the first frame; frame i is at frames() + i.
+	 */
+  Page* frames() const { return static_cast<Page*>(base); }
+
+	/**
+   * Hands the memory behind count frames starting at first back to the
+   * system; the frames keep their addresses and read as zeros when next used.
+   * Explicit huge pages are larger than a frame and are kept.
+	 *
+	 * @param first   First frame whose memory to release
+	 * @param count   Number of frames
+	 */
+  void release(const FrameId first, const std::uint32_t count);
+
+	/**
+   * Returns the size of the arena in bytes
+	 */
+  std::size_t bytes() const { return size; }
+
+	/**
+   * Returns the number of frames in the arena
+	 */
+  std::uint32_t frameCount() const { return numFrames; }
+
+	/**
+   * Returns the kind of pages the arena got
+	 */
+  PageBacking backing() const { return pageBacking; }
+
+	/**
+   * Returns how many bytes of the frames are currently backed by huge pages;
+   * for transparent huge pages this is read from /proc/self/smaps.
+	 */
+  std::size_t hugePageBytes() const;
+};
+
+}
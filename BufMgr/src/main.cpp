@@ -1,13 +1,27 @@
+#include <atomic>
 #include <iostream>
 #include <stdlib.h>
 //#include <stdio.h>
 #include <cstring>
+#include <map>
 #include <memory>
+#include <set>
+#include <sstream>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
 #include "page.h"
 #include "buffer.h"
+#include "bufTrace.h"
+#include "warmUp.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
 #include "exceptions/file_not_found_exception.h"
+#include "exceptions/file_open_exception.h"
+#include "exceptions/file_read_only_exception.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_table_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
@@ -36,6 +50,28 @@ void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
 void testBufMgr();
 
 int main() 
@@ -74,12 +110,15 @@ int main()
     for (FileIterator iter = new_file.begin();
          iter != new_file.end();
          ++iter) {
-      // Iterate through all records on the page.
-      for (PageIterator page_iter = (*iter).begin();
-           page_iter != (*iter).end();
+      // Iterate through all records on the page.  Dereferencing the file
+      // iterator returns a copy of the page, so keep it alive while the page
+      // iterator points into it.
+      Page curr_page = *iter;
+      for (PageIterator page_iter = curr_page.begin();
+           page_iter != curr_page.end();
            ++page_iter) {
         std::cout << "Found record: " << *page_iter
-		  << " on page " << (*iter).page_number() << "\n";
+		  << " on page " << curr_page.page_number() << "\n";
       }
     }
 
@@ -147,6 +186,28 @@ void testBufMgr()
   test4();
   test5();
   test6();
+  test7();
+  test8();
+  test9();
+  test10();
+  test11();
+  test12();
+  test13();
+  test14();
+  test15();
+  test16();
+  test17();
+  test18();
+  test19();
+  test20();
+  test21();
+  test22();
+  test23();
+  test24();
+  test25();
+  test26();
+  test27();
+  test28();
 
   //Close files before deleting them
   file1.~File();
@@ -325,3 +386,2175 @@ void test6()
 
   bufMgr->flushFile(file1ptr);
 }
+
+File freshFile(const std::string& filename, const FileFormat format = FORMAT_ALIGNED)
+{
+  try
+    {
+      File::remove(filename);
+    }
+  catch(const FileNotFoundException& e)
+    {
+    }
+  return File::create(filename, format);
+}
+
+void allocTestPages(BufMgr* mgr, File* file, const PageId numPages)
+{
+  //each page holds one record, "<file name> Page <pageNo> <pageNo as float>"
+  for (PageId j = 0; j < numPages; j++)
+    {
+      PageId pageNo;
+      Page* newPage;
+      mgr->allocPage(file, pageNo, newPage);
+      sprintf((char*)tmpbuf, "%s Page %d %7.1f", file->filename().c_str(), pageNo, (float)pageNo);
+      newPage->insertRecord(tmpbuf);
+      mgr->unPinPage(file, pageNo, true);
+    }
+}
+
+void test7()
+{
+  //Several threads reading and dirtying pages of a file larger than the pool
+  const std::string& filename = "test.7";
+  const PageId numPages = 200;
+  const int numThreads = 4;
+
+  {
+    File file7 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(32);
+    allocTestPages(mgr, &file7, numPages);
+
+    std::vector<int> failures(numThreads, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++)
+      {
+	threads.push_back(std::thread([&, t]() {
+	  unsigned int seed = t + 1;
+	  char expected[100];
+	  for (int j = 0; j < 2000; j++)
+	    {
+	      const PageId pageNo = 1 + rand_r(&seed) % numPages;
+	      Page* readPage;
+	      mgr->readPage(&file7, pageNo, readPage);
+	      sprintf(expected, "test.7 Page %d %7.1f", pageNo, (float)pageNo);
+	      const RecordId recordId = {pageNo, 1};
+	      if (strncmp(readPage->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+		failures[t]++;
+	      mgr->unPinPage(&file7, pageNo, j % 3 == 0);
+	    }
+	}));
+      }
+    for (int t = 0; t < numThreads; t++)
+      {
+	threads[t].join();
+	if (failures[t] != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+
+    delete mgr;
+  }
+  File::remove(filename);
+
+  std::cout << "Test 7 passed" << "\n";
+}
+
+void test8()
+{
+  //Every replacement policy, with most of the pool pinned and under threads
+  const std::string& filename = "test.8";
+  const PageId numPages = 64;
+  const std::uint32_t numFrames = 16;
+  const int numThreads = 4;
+  const ReplacementPolicyKind policies[] = {CLOCK_POLICY, LRU_K_POLICY, TWO_Q_POLICY, ARC_POLICY};
+
+  for (int p = 0; p < 4; p++)
+    {
+      File file8 = freshFile(filename);
+      BufMgrOptions options;
+      options.policy = policies[p];
+      BufMgr* mgr = new BufMgr(numFrames, options);
+      char expected[100];
+      allocTestPages(mgr, &file8, numPages);
+
+      //Keep all frames but one pinned; the rest of the file has to cycle through it
+      for (PageId j = 1; j < numFrames; j++)
+	mgr->readPage(&file8, j, page);
+      for (PageId j = numFrames; j <= numPages; j++)
+	{
+	  mgr->readPage(&file8, j, page);
+	  sprintf(expected, "test.8 Page %d %7.1f", j, (float)j);
+	  const RecordId recordId = {j, 1};
+	  if (strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	    {
+	      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	    }
+	  mgr->unPinPage(&file8, j, false);
+	}
+
+      mgr->readPage(&file8, numFrames, page);
+      try
+	{
+	  mgr->readPage(&file8, numFrames + 1, page);
+	  PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+      catch(const BufferExceededException& e)
+	{
+	}
+      for (PageId j = 1; j <= numFrames; j++)
+	mgr->unPinPage(&file8, j, false);
+
+      std::vector<int> failures(numThreads, 0);
+      std::vector<std::thread> threads;
+      for (int t = 0; t < numThreads; t++)
+	{
+	  threads.push_back(std::thread([&, t]() {
+	    unsigned int seed = t + 1;
+	    char wanted[100];
+	    for (int j = 0; j < 1000; j++)
+	      {
+		const PageId pageNo = 1 + rand_r(&seed) % numPages;
+		Page* readPage;
+		mgr->readPage(&file8, pageNo, readPage);
+		sprintf(wanted, "test.8 Page %d %7.1f", pageNo, (float)pageNo);
+		const RecordId recordId = {pageNo, 1};
+		if (strncmp(readPage->getRecord(recordId).c_str(), wanted, strlen(wanted)) != 0)
+		  failures[t]++;
+		mgr->unPinPage(&file8, pageNo, j % 3 == 0);
+	      }
+	  }));
+	}
+      for (int t = 0; t < numThreads; t++)
+	{
+	  threads[t].join();
+	  if (failures[t] != 0)
+	    {
+	      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	    }
+	}
+
+      delete mgr;
+    }
+  File::remove(filename);
+
+  std::cout << "Test 8 passed" << "\n";
+}
+
+void test9()
+{
+  //Scans and bulk writes must not push hot pages out of the pool. The hot pages
+  //are changed on disk behind the buffer manager's back, so reading them through
+  //it afterwards shows whether they stayed resident.
+  const std::string& filename = "test.9";
+  const PageId numPages = 64;
+  const PageId hotPages[] = {4, 2, 3, 1};
+  const AccessStrategy strategies[] = {SEQUENTIAL_SCAN, NORMAL_ACCESS, BULK_WRITE};
+  char expected[100];
+
+  for (int s = 0; s < 3; s++)
+    {
+      File file9 = freshFile(filename);
+      BufMgrOptions options;
+      options.sequentialRunLength = 4;
+      BufMgr* mgr = new BufMgr(16, options);
+      allocTestPages(mgr, &file9, numPages);
+      mgr->flushFile(&file9);
+
+      for (int h = 0; h < 4; h++)
+	{
+	  mgr->readPage(&file9, hotPages[h], page);
+	  mgr->unPinPage(&file9, hotPages[h], false);
+	  Page onDisk = file9.readPage(hotPages[h]);
+	  const RecordId recordId = {hotPages[h], 1};
+	  onDisk.updateRecord(recordId, "changed on disk");
+	  file9.writePage(onDisk);
+	}
+
+      if (strategies[s] == BULK_WRITE)
+	{
+	  for (PageId j = 0; j < numPages; j++)
+	    {
+	      PageId pageNo;
+	      mgr->allocPage(&file9, pageNo, page, BULK_WRITE);
+	      sprintf((char*)tmpbuf, "test.9 Page %d %7.1f", pageNo, (float)pageNo);
+	      page->insertRecord(tmpbuf);
+	      mgr->unPinPage(&file9, pageNo, true);
+	    }
+	}
+
+      //with NORMAL_ACCESS the scan is only recognized after a few misses
+      for (PageId j = 5; j <= (strategies[s] == BULK_WRITE ? 2 * numPages : numPages); j++)
+	{
+	  mgr->readPage(&file9, j, page, strategies[s]);
+	  sprintf(expected, "test.9 Page %d %7.1f", j, (float)j);
+	  const RecordId recordId = {j, 1};
+	  if (strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	    {
+	      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	    }
+	  mgr->unPinPage(&file9, j, false);
+	}
+
+      for (int h = 0; h < 4; h++)
+	{
+	  mgr->readPage(&file9, hotPages[h], page);
+	  sprintf(expected, "test.9 Page %d %7.1f", hotPages[h], (float)hotPages[h]);
+	  const RecordId recordId = {hotPages[h], 1};
+	  if (strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	    {
+	      PRINT_ERROR("ERROR :: HOT PAGE WAS EVICTED BY A SCAN");
+	    }
+	  mgr->unPinPage(&file9, hotPages[h], false);
+	}
+
+      //nothing may be dirty here, or the destructor would overwrite the changed pages
+      delete mgr;
+    }
+
+  //a ring frame that was freed and taken by a page of another file is not the
+  //ring's to recycle, even though that page is unpinned and unreferenced
+  {
+    File file9 = File::open(filename);
+    File other = freshFile("test.9b");
+    BufMgrOptions options;
+    options.scanRingFrames = 2;
+    BufMgr* mgr = new BufMgr(16, options);
+    PageId otherPage;
+    mgr->allocPage(&other, otherPage, page);
+    page->insertRecord("test.9b other page");
+    mgr->unPinPage(&other, otherPage, true);
+    mgr->flushFile(&other);
+
+    for (PageId j = 1; j <= 2; j++)
+      {
+	mgr->readPage(&file9, j, page, SEQUENTIAL_SCAN);
+	mgr->unPinPage(&file9, j, false);
+      }
+    //the frame of page 1 goes back to the free list and is taken next
+    mgr->disposePage(&file9, 1);
+    mgr->readPage(&other, otherPage, page, SEQUENTIAL_SCAN);
+    mgr->unPinPage(&other, otherPage, false);
+    Page onDisk = other.readPage(otherPage);
+    const RecordId recordId = {otherPage, 1};
+    onDisk.updateRecord(recordId, "changed on disk");
+    other.writePage(onDisk);
+
+    //slot 0 of the ring is next
+    mgr->readPage(&file9, 3, page, SEQUENTIAL_SCAN);
+    mgr->unPinPage(&file9, 3, false);
+    mgr->readPage(&other, otherPage, page);
+    if (page->getRecord(recordId) != "test.9b other page")
+      {
+	PRINT_ERROR("ERROR :: RING RECYCLED A FRAME HOLDING ANOTHER FILE'S PAGE");
+      }
+    mgr->unPinPage(&other, otherPage, false);
+    delete mgr;
+  }
+  File::remove("test.9b");
+  File::remove(filename);
+
+  std::cout << "Test 9 passed" << "\n";
+}
+
+void test10()
+{
+  //The background writer writes dirty pages out while they stay in the pool
+  const std::string& filename = "test.10";
+  const PageId numPages = 8;
+
+  {
+    File file10 = freshFile(filename);
+    BufMgrOptions options;
+    options.policy = LRU_K_POLICY;
+    options.backgroundWriter = true;
+    options.cleanFrameTarget = 16;
+    options.writerIntervalMs = 1;
+    BufMgr* mgr = new BufMgr(16, options);
+    allocTestPages(mgr, &file10, numPages);
+
+    //all pages fit, so nothing is evicted; only the writer can put them on disk
+    PageId onDisk = 0;
+    for (int wait = 0; wait < 2000 && onDisk < numPages; wait++)
+      {
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	onDisk = 0;
+	for (PageId j = 1; j <= numPages; j++)
+	  if (file10.readPage(j).getFreeSpace() < Page().getFreeSpace())
+	    onDisk++;
+      }
+    if (onDisk != numPages)
+      {
+	PRINT_ERROR("ERROR :: BACKGROUND WRITER DID NOT WRITE DIRTY PAGES");
+      }
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	sprintf((char*)tmpbuf, "test.10 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(file10.readPage(j).getRecord(recordId).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+
+    //threads dirtying pages of a file larger than the pool while the writer runs
+    allocTestPages(mgr, &file10, 100 - numPages);
+    std::vector<int> failures(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+      {
+	threads.push_back(std::thread([&, t]() {
+	  unsigned int seed = t + 1;
+	  char expected[100];
+	  for (int j = 0; j < 1000; j++)
+	    {
+	      const PageId pageNo = 1 + rand_r(&seed) % 100;
+	      Page* readPage;
+	      mgr->readPage(&file10, pageNo, readPage);
+	      sprintf(expected, "test.10 Page %d %7.1f", pageNo, (float)pageNo);
+	      const RecordId recordId = {pageNo, 1};
+	      if (strncmp(readPage->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+		failures[t]++;
+	      mgr->unPinPage(&file10, pageNo, j % 2 == 0);
+	    }
+	}));
+      }
+    for (int t = 0; t < 4; t++)
+      {
+	threads[t].join();
+	if (failures[t] != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+
+    delete mgr;
+  }
+  File::remove(filename);
+
+  std::cout << "Test 10 passed" << "\n";
+}
+
+void test11()
+{
+  //Prefetched pages read back correctly, and flushFile() and disposePage() wait
+  //for prefetches still in flight
+  const std::string& filename = "test.11";
+  const PageId numPages = 40;
+  char expected[100];
+
+  {
+    File file11 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(16);
+    allocTestPages(mgr, &file11, numPages);
+    mgr->flushFile(&file11);
+
+    mgr->prefetch(&file11, 1, 8);
+    for (PageId j = 1; j <= 8; j++)
+      {
+	mgr->readPage(&file11, j, page);
+	sprintf(expected, "test.11 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+	mgr->unPinPage(&file11, j, false);
+      }
+
+    //more pages than frames, and a page past the end of the file
+    mgr->prefetch(&file11, 9, numPages);
+    mgr->flushFile(&file11);
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	mgr->readPage(&file11, j, page);
+	sprintf(expected, "test.11 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+	mgr->unPinPage(&file11, j, false);
+      }
+    try
+      {
+	mgr->readPage(&file11, numPages + 5, page);
+	PRINT_ERROR("ERROR :: Page past the end of the file was read. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const InvalidPageException& e)
+      {
+      }
+
+    std::vector<PageId> pageNos;
+    pageNos.push_back(20);
+    pageNos.push_back(3);
+    pageNos.push_back(20);
+    pageNos.push_back(35);
+    mgr->prefetch(&file11, pageNos);
+    mgr->disposePage(&file11, 35);
+    try
+      {
+	mgr->readPage(&file11, 35, page);
+	PRINT_ERROR("ERROR :: Disposed page was read. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const InvalidPageException& e)
+      {
+      }
+
+    //destroyed with prefetches still queued
+    mgr->prefetch(&file11, 1, numPages);
+    delete mgr;
+  }
+  File::remove(filename);
+
+  std::cout << "Test 11 passed" << "\n";
+}
+
+void test12()
+{
+  //Batched readPages()/unPinPages(), all or nothing on errors
+  const std::string& filename = "test.12";
+  const PageId numPages = 40;
+  char expected[100];
+
+  {
+    File file12 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(16);
+    allocTestPages(mgr, &file12, numPages);
+    mgr->flushFile(&file12);
+
+    const PageId batch[] = {5, 1, 2, 3, 9, 2};
+    std::vector<PageId> pageNos(batch, batch + 6);
+    std::vector<Page*> pages;
+    mgr->readPages(&file12, pageNos, pages);
+    for (std::size_t j = 0; j < pageNos.size(); j++)
+      {
+	sprintf(expected, "test.12 Page %d %7.1f", pageNos[j], (float)pageNos[j]);
+	const RecordId recordId = {pageNos[j], 1};
+	if (strncmp(pages[j]->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    if (pages[2] != pages[5])
+      {
+	PRINT_ERROR("ERROR :: SAME PAGE IN TWO FRAMES");
+      }
+    mgr->unPinPages(&file12, pageNos, false);
+    try
+      {
+	mgr->unPinPages(&file12, pageNos, false);
+	PRINT_ERROR("ERROR :: Pages were not pinned. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const PageNotPinnedException& e)
+      {
+      }
+
+    //a page that does not exist, and more pages than frames; neither may leave pins behind
+    pageNos.assign(1, 7);
+    pageNos.push_back(numPages + 10);
+    pageNos.push_back(8);
+    try
+      {
+	mgr->readPages(&file12, pageNos, pages);
+	PRINT_ERROR("ERROR :: Page past the end of the file was read. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const InvalidPageException& e)
+      {
+      }
+    pageNos.clear();
+    for (PageId j = 1; j <= 17; j++)
+      pageNos.push_back(j);
+    try
+      {
+	mgr->readPages(&file12, pageNos, pages);
+	PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const BufferExceededException& e)
+      {
+      }
+    pageNos.pop_back();
+    mgr->readPages(&file12, pageNos, pages);
+    mgr->unPinPages(&file12, pageNos, false);
+    delete mgr;
+
+    //threads reading overlapping batches
+    mgr = new BufMgr(32);
+    std::vector<int> failures(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+      {
+	threads.push_back(std::thread([&, t]() {
+	  unsigned int seed = t + 1;
+	  char wanted[100];
+	  std::vector<PageId> threadPageNos(4);
+	  std::vector<Page*> threadPages;
+	  for (int j = 0; j < 500; j++)
+	    {
+	      for (int k = 0; k < 4; k++)
+		threadPageNos[k] = 1 + rand_r(&seed) % numPages;
+	      mgr->readPages(&file12, threadPageNos, threadPages);
+	      for (int k = 0; k < 4; k++)
+		{
+		  sprintf(wanted, "test.12 Page %d %7.1f", threadPageNos[k], (float)threadPageNos[k]);
+		  const RecordId recordId = {threadPageNos[k], 1};
+		  if (strncmp(threadPages[k]->getRecord(recordId).c_str(), wanted, strlen(wanted)) != 0)
+		    failures[t]++;
+		}
+	      mgr->unPinPages(&file12, threadPageNos, j % 2 == 0);
+	    }
+	}));
+      }
+    for (int t = 0; t < 4; t++)
+      {
+	threads[t].join();
+	if (failures[t] != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    delete mgr;
+  }
+  File::remove(filename);
+
+  std::cout << "Test 12 passed" << "\n";
+}
+
+void test13()
+{
+  //flushFile() and dropFile() touch only the pages of their file
+  const std::string& filenameA = "test.13a";
+  const std::string& filenameB = "test.13b";
+  char expected[100];
+
+  {
+    File fileA = freshFile(filenameA);
+    File fileB = freshFile(filenameB);
+    BufMgr* mgr = new BufMgr(16);
+    //pages of the two files alternate in the pool
+    for (int j = 0; j < 5; j++)
+      {
+	allocTestPages(mgr, &fileA, 1);
+	allocTestPages(mgr, &fileB, 1);
+      }
+    PageId pageNoA = 5, pageNoB = 5;
+
+    //a pinned page of B does not stop A from being flushed
+    mgr->readPage(&fileB, 3, page);
+    mgr->flushFile(&fileA);
+    try
+      {
+	mgr->dropFile(&fileB);
+	PRINT_ERROR("ERROR :: Page is pinned. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const PagePinnedException& e)
+      {
+      }
+    //and a dropFile() that threw left every page of B in the pool
+    const BufStats before = mgr->getBufStats();
+    for (PageId j = 1; j <= pageNoB; j++)
+      {
+	mgr->readPage(&fileB, j, page2);
+	mgr->unPinPage(&fileB, j, false);
+      }
+    if (mgr->getBufStats().counters[MISSES] != before.counters[MISSES])
+      {
+	PRINT_ERROR("ERROR :: Pages dropped by a dropFile() that threw");
+      }
+    mgr->unPinPage(&fileB, 3, false);
+
+    mgr->readPage(&fileB, pageNoB, page);
+    try
+      {
+	mgr->flushFile(&fileB);
+	PRINT_ERROR("ERROR :: Page is pinned. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const PagePinnedException& e)
+      {
+      }
+    mgr->unPinPage(&fileB, pageNoB, false);
+
+    //dropped pages are not written, flushed pages are
+    mgr->dropFile(&fileB);
+    mgr->flushFile(&fileB);
+    for (PageId j = 1; j <= pageNoA; j++)
+      {
+	Page onDisk = fileA.readPage(j);
+	sprintf(expected, "test.13a Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    Page onDisk = fileB.readPage(pageNoB);
+    if (onDisk.getFreeSpace() != Page().getFreeSpace())
+      {
+	PRINT_ERROR("ERROR :: Dropped page was written back");
+      }
+
+    //the dropped frames are free again, and pages of A read back from disk
+    for (PageId j = 1; j <= 5; j++)
+      {
+	mgr->readPage(&fileA, j, page);
+	mgr->allocPage(&fileB, pageNoB, page);
+	mgr->unPinPage(&fileB, pageNoB, true);
+      }
+    for (PageId j = 1; j <= 5; j++)
+      mgr->unPinPage(&fileA, j, false);
+    delete mgr;
+  }
+  File::remove(filenameA);
+  File::remove(filenameB);
+
+  std::cout << "Test 13 passed" << "\n";
+}
+
+void test14()
+{
+  //resize() grows and shrinks the pool; pinned pages stay put
+  const std::string& filename = "test.14";
+  const PageId numPages = 64;
+  char expected[100];
+  Page* pinned[8];
+
+  {
+    File file14 = freshFile(filename);
+    BufMgrOptions options;
+    options.maxBufs = numPages;
+    BufMgr* mgr = new BufMgr(16, options);
+    PageId pageNo;
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	if (j == 17)
+	  {
+	    try
+	      {
+		mgr->allocPage(&file14, pageNo, page);
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	      }
+	    catch(const BufferExceededException& e)
+	      {
+	      }
+	    mgr->resize(numPages);
+	  }
+	mgr->allocPage(&file14, pageNo, page);
+	sprintf((char*)tmpbuf, "test.14 Page %d %7.1f", pageNo, (float)pageNo);
+	page->insertRecord(tmpbuf);
+	if (pageNo <= 8)
+	  pinned[pageNo - 1] = page;
+      }
+    if (mgr->getNumBufs() != numPages)
+      {
+	PRINT_ERROR("ERROR :: Pool did not grow");
+      }
+
+    //every page pinned: the pool cannot shrink and keeps its size
+    try
+      {
+	mgr->resize(numPages / 2);
+	PRINT_ERROR("ERROR :: All pages are pinned. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const BufferExceededException& e)
+      {
+      }
+    try
+      {
+	mgr->resize(numPages + 1);
+	PRINT_ERROR("ERROR :: Pool grown past maxBufs. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const BufferExceededException& e)
+      {
+      }
+
+    //shrinking writes the unpinned pages back and leaves the pinned ones alone
+    for (PageId j = 9; j <= numPages; j++)
+      mgr->unPinPage(&file14, j, true);
+    mgr->resize(8);
+    for (PageId j = 1; j <= 8; j++)
+      {
+	sprintf(expected, "test.14 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(pinned[j - 1]->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    try
+      {
+	mgr->readPage(&file14, 9, page);
+	PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const BufferExceededException& e)
+      {
+      }
+    for (PageId j = 1; j <= 8; j++)
+      mgr->unPinPage(&file14, j, true);
+    mgr->clearBufStats();
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	mgr->readPage(&file14, j, page);
+	sprintf(expected, "test.14 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+	mgr->unPinPage(&file14, j, false);
+      }
+    //the clock sweeps the 8 frames in the pool, not the ones reserved
+    const BufStats stats = mgr->getBufStats();
+    const Histogram& sweeps = stats.histograms[SWEEP_LENGTH];
+    if (sweeps.count == 0 || sweeps.sum > 2 * 8 * sweeps.count)
+      {
+	PRINT_ERROR("ERROR :: Clock swept frames outside the pool");
+      }
+
+    //threads reading while the pool is resized under them
+    std::atomic<bool> stop(false);
+    std::vector<int> failures(2, 0);
+    std::vector<std::thread> threads;
+    mgr->resize(16);
+    for (int t = 0; t < 2; t++)
+      {
+	threads.push_back(std::thread([&, t]() {
+	  unsigned int seed = t + 1;
+	  char wanted[100];
+	  Page* threadPage;
+	  while (!stop)
+	    {
+	      const PageId threadPageNo = 1 + rand_r(&seed) % numPages;
+	      mgr->readPage(&file14, threadPageNo, threadPage);
+	      sprintf(wanted, "test.14 Page %d %7.1f", threadPageNo, (float)threadPageNo);
+	      const RecordId recordId = {threadPageNo, 1};
+	      if (strncmp(threadPage->getRecord(recordId).c_str(), wanted, strlen(wanted)) != 0)
+		failures[t]++;
+	      mgr->unPinPage(&file14, threadPageNo, rand_r(&seed) % 2 == 0);
+	    }
+	}));
+      }
+    for (int j = 0; j < 200; j++)
+      mgr->resize(j % 2 == 0 ? numPages : 16);
+    stop = true;
+    for (int t = 0; t < 2; t++)
+      {
+	threads[t].join();
+	if (failures[t] != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    delete mgr;
+  }
+  File::remove(filename);
+
+  std::cout << "Test 14 passed" << "\n";
+}
+
+void test15()
+{
+  //A sharded pool: every frame usable from any page, resizable, under threads
+  const std::string& filename = "test.15";
+  const PageId numPages = 256;
+  char expected[100];
+
+  {
+    File file15 = freshFile(filename);
+    BufMgrOptions options;
+    options.shards = 4;
+    options.maxBufs = 128;
+    BufMgr* mgr = new BufMgr(64, options);
+    allocTestPages(mgr, &file15, numPages);
+
+    //pages whose shard is full take frames from the others
+    for (PageId j = 1; j <= 64; j++)
+      mgr->readPage(&file15, j, page);
+    try
+      {
+	mgr->readPage(&file15, 65, page);
+	PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const BufferExceededException& e)
+      {
+      }
+    mgr->resize(128);
+    for (PageId j = 65; j <= 128; j++)
+      mgr->readPage(&file15, j, page);
+    for (PageId j = 1; j <= 128; j++)
+      mgr->unPinPage(&file15, j, false);
+    mgr->resize(8);
+
+    std::vector<int> failures(4, 0);
+    std::vector<std::thread> threads;
+    mgr->resize(64);
+    for (int t = 0; t < 4; t++)
+      {
+	threads.push_back(std::thread([&, t]() {
+	  unsigned int seed = t + 1;
+	  char wanted[100];
+	  Page* threadPage;
+	  for (int j = 0; j < 2000; j++)
+	    {
+	      const PageId threadPageNo = 1 + rand_r(&seed) % numPages;
+	      mgr->readPage(&file15, threadPageNo, threadPage);
+	      sprintf(wanted, "test.15 Page %d %7.1f", threadPageNo, (float)threadPageNo);
+	      const RecordId recordId = {threadPageNo, 1};
+	      if (strncmp(threadPage->getRecord(recordId).c_str(), wanted, strlen(wanted)) != 0)
+		failures[t]++;
+	      mgr->unPinPage(&file15, threadPageNo, j % 3 == 0);
+	    }
+	}));
+      }
+    for (int t = 0; t < 4; t++)
+      {
+	threads[t].join();
+	if (failures[t] != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    delete mgr;
+
+    //and everything was written back
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page onDisk = file15.readPage(j);
+	sprintf(expected, "test.15 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 15 passed" << "\n";
+}
+
+void test16()
+{
+  //Every page backing works, falling back to what the system has
+  const std::string& filename = "test.16";
+  const PageBacking backings[] = {NORMAL_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES};
+  char expected[100];
+
+  {
+    File file16 = freshFile(filename);
+    for (int b = 0; b < 3; b++)
+      {
+	BufMgrOptions options;
+	options.pageBacking = backings[b];
+	options.maxBufs = 1024;
+	BufMgr* mgr = new BufMgr(1024, options);
+	if (mgr->getPageBacking() > backings[b])
+	  {
+	    PRINT_ERROR("ERROR :: Got a larger page backing than asked for");
+	  }
+	if (mgr->getPageBacking() == NORMAL_PAGES && mgr->getHugePageBytes() != 0)
+	  {
+	    PRINT_ERROR("ERROR :: Normal pages reported as huge pages");
+	  }
+
+	allocTestPages(mgr, &file16, 8);
+	//shrinking releases frame memory, which huge pages must survive
+	mgr->resize(4);
+	mgr->resize(1024);
+	delete mgr;
+      }
+
+    for (PageId j = 1; j <= 24; j++)
+      {
+	Page onDisk = file16.readPage(j);
+	sprintf(expected, "test.16 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 16 passed" << "\n";
+}
+
+void test17()
+{
+  //PinnedPage handles unpin on destruction, move and exceptions
+  const std::string& filename = "test.17";
+  char expected[100];
+
+  {
+    File file17 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(4);
+    for (int j = 0; j < 8; j++)
+      {
+	PinnedPage pinned = mgr->pinNewPage(&file17);
+	sprintf((char*)tmpbuf, "test.17 Page %d %7.1f", pinned.pageNo(), (float)pinned.pageNo());
+	pinned->insertRecord(tmpbuf);
+	pinned.markDirty();
+      }
+
+    //a moved handle hands its pin over once
+    {
+      PinnedPage first = mgr->pinPage(&file17, 1);
+      PinnedPage second(std::move(first));
+      if (first || !second || second.pageNo() != 1)
+	{
+	  PRINT_ERROR("ERROR :: Moved handle holds the wrong pin");
+	}
+      PinnedPage third = mgr->pinPage(&file17, 2);
+      third = std::move(second);
+      if (third.pageNo() != 1)
+	{
+	  PRINT_ERROR("ERROR :: Moved handle holds the wrong pin");
+	}
+      //page 2 was unpinned by the assignment
+      mgr->disposePage(&file17, 2);
+    }
+
+    //an exception does not leak the pins
+    try
+      {
+	PinnedPage a = mgr->pinPage(&file17, 3);
+	PinnedPage b = mgr->pinPage(&file17, 4);
+	PinnedPage c = mgr->pinPage(&file17, 5);
+	PinnedPage d = mgr->pinPage(&file17, 6);
+	mgr->pinPage(&file17, 7);
+	PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+      }
+    catch(const BufferExceededException& e)
+      {
+      }
+
+    {
+      PinnedPage pinned = mgr->pinPage(&file17, 8);
+      pinned.release();
+      if (pinned)
+	{
+	  PRINT_ERROR("ERROR :: Released handle still holds a pin");
+	}
+      try
+	{
+	  mgr->unPinPage(&file17, 8, false);
+	  PRINT_ERROR("ERROR :: Page is not pinned. Exception should have been thrown before execution reaches this point.");
+	}
+      catch(const PageNotPinnedException& e)
+	{
+	}
+    }
+
+    mgr->flushFile(&file17);
+    delete mgr;
+
+    for (PageId j = 1; j <= 8; j++)
+      {
+	if (j == 2)
+	  continue;
+	Page onDisk = file17.readPage(j);
+	sprintf(expected, "test.17 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 17 passed" << "\n";
+}
+
+void test18()
+{
+  //Statistics count hits, misses, evictions and writes, per file too
+  const std::string& filename = "test.18";
+
+  {
+    File file18 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(4);
+    allocTestPages(mgr, &file18, 8);
+    //pages 5..8 are resident, 1..4 were written back and evicted
+    for (PageId j = 5; j <= 8; j++)
+      {
+	mgr->readPage(&file18, j, page);
+	mgr->unPinPage(&file18, j, false);
+      }
+    mgr->readPage(&file18, 1, page);
+    mgr->unPinPage(&file18, 1, false);
+
+    BufStats stats = mgr->getBufStats();
+    if (stats.counters[ALLOCS] != 8 || stats.counters[HITS] != 4 ||
+	stats.counters[MISSES] != 1 || stats.accesses != 13)
+      {
+	PRINT_ERROR("ERROR :: Wrong access counts");
+      }
+    if (stats.counters[EVICTIONS] != 5 || stats.counters[DIRTY_EVICTIONS] != 5 ||
+	stats.diskwrites != 5 || stats.counters[BYTES_WRITTEN] != 5 * Page::SIZE ||
+	stats.histograms[WRITE_LATENCY].count != 5)
+      {
+	PRINT_ERROR("ERROR :: Wrong eviction counts");
+      }
+    if (stats.histograms[MISS_LATENCY].count != 1 || stats.histograms[SWEEP_LENGTH].count != 5 ||
+	stats.files[filename].reads != 1 || stats.files[filename].writes != 5 ||
+	stats.files[filename].evictions != 5)
+      {
+	PRINT_ERROR("ERROR :: Wrong latency or per-file counts");
+      }
+
+    std::ostringstream text;
+    stats.exportText(text);
+    if (text.str().find("badgerdb_buffer_hits_total 4\n") == std::string::npos ||
+	text.str().find("badgerdb_buffer_file_writes_total{file=\"test.18\"} 5\n") == std::string::npos ||
+	text.str().find("badgerdb_buffer_read_miss_latency_ns_count 1\n") == std::string::npos)
+      {
+	PRINT_ERROR("ERROR :: Wrong text export");
+      }
+
+    mgr->clearBufStats();
+    stats = mgr->getBufStats();
+    if (stats.accesses != 0 || stats.counters[EVICTIONS] != 0 || !stats.files.empty())
+      {
+	PRINT_ERROR("ERROR :: Statistics not cleared");
+      }
+    delete mgr;
+  }
+  File::remove(filename);
+
+  std::cout << "Test 18 passed" << "\n";
+}
+
+void test19()
+{
+  //Traced events are kept, saved, loaded and exported to Chrome JSON
+  const std::string& filename = "test.19";
+  const std::string& traceName = "test.19.trace";
+
+  BufTrace::clear();
+  BufTrace::enable(true);
+  {
+    File file19 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(2);
+    allocTestPages(mgr, &file19, 3);
+    mgr->readPage(&file19, 1, page);
+    mgr->unPinPage(&file19, 1, false);
+    delete mgr;
+  }
+  File::remove(filename);
+  //events recorded by hand are kept whether or not tracing is compiled in
+  std::thread([]() { BufTrace::record(TRACE_HIT, 0, 42, 7); }).join();
+  BufTrace::enable(false);
+  BufTrace::record(TRACE_HIT, 0, 43, 8);
+
+  std::vector<TraceEvent> events;
+  BufTrace::events(events);
+  int kinds[TRACE_KINDS] = {0};
+  for (std::size_t i = 0; i < events.size(); i++)
+    {
+      kinds[events[i].kind]++;
+      if (i > 0 && events[i].start < events[i - 1].start)
+	{
+	  PRINT_ERROR("ERROR :: Events out of order");
+	}
+    }
+  if (kinds[TRACE_HIT] < 2)
+    {
+      PRINT_ERROR("ERROR :: Recorded events missing");
+    }
+#ifdef BADGERDB_TRACE
+  if (kinds[TRACE_MISS] != 1 || kinds[TRACE_FILE_READ] < 1 || kinds[TRACE_FILE_ALLOC] != 3 ||
+      kinds[TRACE_EVICT] != 2 || kinds[TRACE_WRITE_BACK] != 3 || kinds[TRACE_UNPIN] != 4)
+    {
+      PRINT_ERROR("ERROR :: Traced buffer manager events missing");
+    }
+#endif
+
+  std::vector<TraceEvent> loaded;
+  if (!BufTrace::save(traceName) || !BufTrace::load(traceName, loaded) ||
+      loaded.size() != events.size() || loaded.back().pageNo != events.back().pageNo)
+    {
+      PRINT_ERROR("ERROR :: Trace not saved and loaded back");
+    }
+  std::remove(traceName.c_str());
+
+  std::ostringstream json;
+  BufTrace::writeChromeJson(loaded, json);
+  if (json.str().find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") != 0 ||
+      json.str().find("\"name\":\"hit\"") == std::string::npos ||
+      json.str().find("\"args\":{\"page\":43,\"frame\":8}") == std::string::npos)
+    {
+      PRINT_ERROR("ERROR :: Wrong Chrome trace JSON");
+    }
+  BufTrace::clear();
+
+  std::cout << "Test 19 passed" << "\n";
+}
+
+void test20()
+{
+  //Every sync mode keeps what is written, buffered writes included
+  const std::string& filename = "test.20";
+  const SyncMode modes[] = {FLUSH_EACH_WRITE, SYNC_NONE, SYNC_FLUSH, SYNC_FDATASYNC, FSYNC_EACH_WRITE};
+  const PageId numPages = 100;
+  char expected[100];
+  for (int m = 0; m < 5; m++)
+    {
+      {
+	File file20 = freshFile(filename);
+	if (file20.syncMode() != FLUSH_EACH_WRITE)
+	  {
+	    PRINT_ERROR("ERROR :: Files do not start flushing each write");
+	  }
+	file20.setSyncMode(modes[m]);
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    Page newPage = file20.allocatePage();
+	    sprintf((char*)tmpbuf, "test.20 Page %d %7.1f", j, (float)j);
+	    newPage.insertRecord(tmpbuf);
+	    file20.writePage(newPage);
+	  }
+	//read back while they may still be buffered, one by one and as a run
+	Page* run[numPages];
+	std::vector<Page> pages(numPages);
+	for (PageId j = 0; j < numPages; j++)
+	  run[j] = &pages[j];
+	file20.readPages(1, numPages, run);
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    Page onDisk = file20.readPage(j);
+	    sprintf(expected, "test.20 Page %d %7.1f", j, (float)j);
+	    const RecordId recordId = {j, 1};
+	    if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0 ||
+		strncmp(pages[j - 1].getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	      {
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	      }
+	  }
+	//through the buffer pool, whose flushFile() is a sync barrier
+	BufMgr* mgr = new BufMgr(16);
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    mgr->readPage(&file20, j, page);
+	    sprintf((char*)tmpbuf, "test.20 again %d", j);
+	    page->insertRecord(tmpbuf);
+	    mgr->unPinPage(&file20, j, true);
+	  }
+	mgr->flushFile(&file20);
+	delete mgr;
+	file20.sync();
+      }
+
+      //and closing writes out the rest
+      {
+	File file20 = File::open(filename);
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    Page onDisk = file20.readPage(j);
+	    sprintf(expected, "test.20 again %d", j);
+	    const RecordId recordId = {j, 2};
+	    if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	      {
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	      }
+	  }
+      }
+    }
+  File::remove(filename);
+
+  std::cout << "Test 20 passed" << "\n";
+}
+
+void test21()
+{
+  //A checkpoint writes all dirty pages in runs and leaves them resident and clean
+  const std::string& filename = "test.21";
+  const PageId numPages = 40;
+  char expected[100];
+
+  BufTrace::clear();
+  BufTrace::enable(true);
+  {
+    File file21 = freshFile(filename);
+    BufMgr* mgr = new BufMgr(64);
+    allocTestPages(mgr, &file21, numPages);
+    mgr->readPage(&file21, 5, page);
+
+    //the pinned page is skipped, unless it may be copied
+    BufStats before = mgr->getBufStats();
+    if (mgr->checkpoint() != numPages - 1)
+      {
+	PRINT_ERROR("ERROR :: Checkpoint did not write every unpinned dirty page");
+      }
+    BufStats after = mgr->getBufStats();
+    if (after.counters[DISK_WRITES] - before.counters[DISK_WRITES] != numPages - 1 ||
+	after.counters[EVICTIONS] != before.counters[EVICTIONS])
+      {
+	PRINT_ERROR("ERROR :: Wrong checkpoint statistics");
+      }
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page onDisk = file21.readPage(j);
+	sprintf(expected, "test.21 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	const bool present = onDisk.begin() != onDisk.end() &&
+	  strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) == 0;
+	if (present != (j != 5))
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    if (mgr->checkpoint() != 0)
+      {
+	PRINT_ERROR("ERROR :: Checkpoint left pages dirty");
+      }
+    CheckpointOptions copying;
+    copying.copyPinned = true;
+    if (mgr->checkpoint(copying) != 1)
+      {
+	PRINT_ERROR("ERROR :: Pinned page not written from a copy");
+      }
+    mgr->unPinPage(&file21, 5, false);
+
+    //all pages stayed resident
+    before = mgr->getBufStats();
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	mgr->readPage(&file21, j, page);
+	sprintf((char*)tmpbuf, "test.21 again %d", j);
+	page->insertRecord(tmpbuf);
+	mgr->unPinPage(&file21, j, true);
+      }
+    after = mgr->getBufStats();
+    if (after.counters[MISSES] != before.counters[MISSES])
+      {
+	PRINT_ERROR("ERROR :: Checkpointed pages were evicted");
+      }
+
+    //shorter runs, spread over at least a tenth of a second
+    BufTrace::clear();
+    CheckpointOptions throttled;
+    throttled.maxRunPages = 8;
+    throttled.maxBytesPerSecond = numPages * Page::SIZE * 10;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (mgr->checkpoint(throttled) != numPages)
+      {
+	PRINT_ERROR("ERROR :: Checkpoint did not write every dirty page");
+      }
+    if (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(90))
+      {
+	PRINT_ERROR("ERROR :: Checkpoint went over its rate");
+      }
+#ifdef BADGERDB_TRACE
+    std::vector<TraceEvent> events;
+    BufTrace::events(events);
+    int runs = 0;
+    for (std::size_t j = 0; j < events.size(); j++)
+      {
+	if (events[j].kind == TRACE_FILE_WRITE)
+	  runs++;
+      }
+    if (runs != int(numPages / 8))
+      {
+	PRINT_ERROR("ERROR :: Checkpoint did not write in runs");
+      }
+#endif
+    delete mgr;
+
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page onDisk = file21.readPage(j);
+	sprintf(expected, "test.21 again %d", j);
+	const RecordId recordId = {j, 2};
+	if (strncmp(onDisk.getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+  }
+  BufTrace::enable(false);
+  BufTrace::clear();
+  File::remove(filename);
+
+  std::cout << "Test 21 passed" << "\n";
+}
+
+void test22()
+{
+  //Resident pages saved by one pool are read back into the next, hottest first
+  const std::string& filename = "test.22";
+  const std::string& listName = "test.22.list";
+  const std::string& warmName = "test.22.warm";
+  const PageId numPages = 32;
+
+  {
+    File file22 = freshFile(filename);
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page newPage = file22.allocatePage();
+	file22.writePage(newPage);
+      }
+
+    BufMgrOptions options;
+    options.policy = LRU_K_POLICY;
+    options.sequentialRunLength = 0;
+    options.warmUpPath = warmName;
+    BufMgr* mgr = new BufMgr(numPages, options);
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	mgr->readPage(&file22, j, page);
+	mgr->unPinPage(&file22, j, false);
+      }
+    //pages 1 to 8 are hot
+    for (PageId j = 1; j <= 8; j++)
+      {
+	mgr->readPage(&file22, j, page);
+	mgr->unPinPage(&file22, j, false);
+      }
+
+    WarmUpList list;
+    if (!mgr->saveResidentPages(listName) || !list.load(listName) ||
+	list.files.size() != 1 || list.files[0] != filename || list.entries.size() != numPages)
+      {
+	PRINT_ERROR("ERROR :: Resident pages not saved");
+      }
+    std::uint16_t coldestHot = WarmUpList::HOTTEST;
+    std::uint16_t hottestCold = 0;
+    for (std::size_t j = 0; j < list.entries.size(); j++)
+      {
+	if (list.entries[j].pageNo <= 8)
+	  coldestHot = std::min(coldestHot, list.entries[j].hotness);
+	else
+	  hottestCold = std::max(hottestCold, list.entries[j].hotness);
+      }
+    if (coldestHot <= hottestCold)
+      {
+	PRINT_ERROR("ERROR :: Hot pages not ranked hotter");
+      }
+    std::remove(listName.c_str());
+    //the destructor saves them too
+    delete mgr;
+
+    //into a smaller pool, which only has room for the hottest half
+    mgr = new BufMgr(numPages / 2);
+    std::map<std::string, File*> files;
+    if (mgr->warmUp("test.22.missing", files))
+      {
+	PRINT_ERROR("ERROR :: Warm-up from a missing list");
+      }
+    files[filename] = &file22;
+    if (!mgr->warmUp(warmName, files))
+      {
+	PRINT_ERROR("ERROR :: Warm-up list not read");
+      }
+    const WarmUpStatus status = mgr->waitForWarmUp();
+    if (status.running || status.listed != numPages || status.restored != numPages / 2 ||
+	status.skipped != numPages / 2)
+      {
+	PRINT_ERROR("ERROR :: Wrong warm-up progress");
+      }
+    const BufStats before = mgr->getBufStats();
+    for (PageId j = 1; j <= 8; j++)
+      {
+	mgr->readPage(&file22, j, page);
+	mgr->unPinPage(&file22, j, false);
+      }
+    if (mgr->getBufStats().counters[MISSES] != before.counters[MISSES])
+      {
+	PRINT_ERROR("ERROR :: Hot pages not warmed up");
+      }
+    delete mgr;
+  }
+  std::remove(warmName.c_str());
+  File::remove(filename);
+
+  std::cout << "Test 22 passed" << "\n";
+}
+
+FileHeader headerOnDisk(const std::string& filename)
+{
+  FileHeader header = {0, 0, 0, 0};
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return header;
+}
+
+void test23()
+{
+  //The file header is kept in memory, shared by copies, and written at sync and close
+  const std::string& filename = "test.23";
+  const SyncMode modes[] = {FLUSH_EACH_WRITE, SYNC_NONE, FSYNC_EACH_WRITE};
+  const PageId numPages = 20;
+  for (int m = 0; m < 3; m++)
+    {
+      {
+	File file23 = freshFile(filename);
+	if (headerOnDisk(filename).num_pages != 1)
+	  {
+	    PRINT_ERROR("ERROR :: New file has no header on disk");
+	  }
+	file23.setSyncMode(modes[m]);
+	File copy = File::open(filename);
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    Page newPage = (j % 2 ? file23 : copy).allocatePage();
+	    sprintf((char*)tmpbuf, "test.23 Page %d", j);
+	    newPage.insertRecord(tmpbuf);
+	    file23.writePage(newPage);
+	  }
+	//copies share one header, so pages are numbered in turn
+	  {
+	    Page check = copy.readPage(numPages);
+	    if (check.page_number() != numPages)
+	      {
+		PRINT_ERROR("ERROR :: Copies of a file see different headers");
+	      }
+	  }
+	copy.deletePage(numPages);
+	//on disk it changes only on sync, unless each write is synced
+	const FileHeader onDisk = headerOnDisk(filename);
+	if ((modes[m] == FSYNC_EACH_WRITE) != (onDisk.num_pages == numPages + 1 && onDisk.num_free_pages == 1))
+	  {
+	    PRINT_ERROR("ERROR :: Header written to disk too soon or too late");
+	  }
+	file23.sync();
+	if (modes[m] != SYNC_NONE &&
+	    (headerOnDisk(filename).num_pages != numPages + 1 || headerOnDisk(filename).num_free_pages != 1))
+	  {
+	    PRINT_ERROR("ERROR :: Header not written by sync");
+	  }
+      }
+
+      //closing writes it in every mode
+      {
+	File file23 = File::open(filename);
+	if (headerOnDisk(filename).num_pages != numPages + 1 ||
+	    headerOnDisk(filename).num_free_pages != 1)
+	  {
+	    PRINT_ERROR("ERROR :: Header lost when the file was closed");
+	  }
+	PageId count = 0;
+	for (FileIterator iter = file23.begin(); iter != file23.end(); ++iter)
+	  count++;
+	if (count != numPages - 1)
+	  {
+	    PRINT_ERROR("ERROR :: Used pages lost when the file was closed");
+	  }
+      }
+    }
+  File::remove(filename);
+
+  std::cout << "Test 23 passed" << "\n";
+}
+
+void test24()
+{
+  //Threads read and write different pages of one file at the same time
+  const std::string& filename = "test.24";
+  const SyncMode modes[] = {FLUSH_EACH_WRITE, SYNC_FLUSH};
+  const PageId numPages = 64;
+  const int numReaders = 4;
+  const int numWriters = 2;
+  const PageId writerPages = numPages / 2 / numWriters;
+  for (int m = 0; m < 2; m++)
+    {
+      File file24 = freshFile(filename);
+      file24.setSyncMode(modes[m]);
+      for (PageId j = 1; j <= numPages; j++)
+	{
+	  Page newPage = file24.allocatePage();
+	  sprintf((char*)tmpbuf, "test.24 Page %3d writer - pass %5d", j, 0);
+	  newPage.insertRecord(tmpbuf);
+	  file24.writePage(newPage);
+	}
+      file24.sync();
+
+      //readers keep to the first half, writers each to a quarter of the rest
+      std::vector<int> failures(numReaders + numWriters, 0);
+      std::vector<std::thread> threads;
+      for (int t = 0; t < numReaders; t++)
+	{
+	  threads.push_back(std::thread([&, t]() {
+	    File file = file24;
+	    unsigned int seed = t + 1;
+	    char expected[100];
+	    Page run[4];
+	    Page* runPages[4] = {&run[0], &run[1], &run[2], &run[3]};
+	    for (int j = 0; j < 2000; j++)
+	      {
+		const PageId pageNo = 1 + rand_r(&seed) % (numPages / 2 - 3);
+		const RecordId recordId = {pageNo, 1};
+		sprintf(expected, "test.24 Page %3d writer - pass %5d", pageNo, 0);
+		if (j % 2 == 0)
+		  {
+		    Page onDisk = file.readPage(pageNo);
+		    if (onDisk.getRecord(recordId) != expected)
+		      failures[t]++;
+		  }
+		else
+		  {
+		    file.readPages(pageNo, 4, runPages);
+		    if (run[0].getRecord(recordId) != expected || run[3].page_number() != pageNo + 3)
+		      failures[t]++;
+		  }
+	      }
+	  }));
+	}
+      for (int w = 0; w < numWriters; w++)
+	{
+	  threads.push_back(std::thread([&, w]() {
+	    const PageId first = numPages / 2 + 1 + w * writerPages;
+	    char record[100];
+	    for (int pass = 1; pass <= 50; pass++)
+	      {
+		for (PageId pageNo = first; pageNo < first + writerPages; pageNo++)
+		  {
+		    Page onDisk = file24.readPage(pageNo);
+		    const RecordId recordId = {pageNo, 1};
+		    sprintf(record, "test.24 Page %3d writer %d pass %5d", pageNo, w, pass - 1);
+		    if (pass > 1 && onDisk.getRecord(recordId) != record)
+		      failures[numReaders + w]++;
+		    sprintf(record, "test.24 Page %3d writer %d pass %5d", pageNo, w, pass);
+		    onDisk.updateRecord(recordId, record);
+		    file24.writePage(onDisk);
+		  }
+	      }
+	  }));
+	}
+      for (std::size_t t = 0; t < threads.size(); t++)
+	{
+	  threads[t].join();
+	  if (failures[t] != 0)
+	    {
+	      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	    }
+	}
+      file24.sync();
+
+      //another File for it sees what the writers left
+      {
+	File file = File::open(filename);
+	for (PageId pageNo = numPages / 2 + 1; pageNo <= numPages; pageNo++)
+	  {
+	    char expected[100];
+	    sprintf(expected, "test.24 Page %3d writer %d pass %5d", pageNo,
+		    int((pageNo - numPages / 2 - 1) / writerPages), 50);
+	    const RecordId recordId = {pageNo, 1};
+	    if (file.readPage(pageNo).getRecord(recordId) != expected)
+	      {
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	      }
+	  }
+      }
+    }
+  File::remove(filename);
+
+  std::cout << "Test 24 passed" << "\n";
+}
+
+std::streamoff sizeOnDisk(const std::string& filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+  return in.tellg();
+}
+
+void test25()
+{
+  //Aligned files can use direct I/O, and packed files migrate to the aligned layout
+  const std::string& filename = "test.25";
+  const PageId numPages = 40;
+  char expected[100];
+
+  {
+    File file25 = freshFile(filename);
+    if (file25.format() != FORMAT_ALIGNED || file25.directIO())
+      {
+	PRINT_ERROR("ERROR :: New files are not aligned and cached");
+      }
+    //false only where the file system has no direct I/O
+    if (file25.setDirectIO(true) != file25.directIO())
+      {
+	PRINT_ERROR("ERROR :: Direct I/O mode not reported");
+      }
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page newPage = file25.allocatePage();
+	sprintf((char*)tmpbuf, "test.25 Page %d %7.1f", j, (float)j);
+	newPage.insertRecord(tmpbuf);
+	file25.writePage(newPage);
+      }
+    //through the frames of a pool, written behind, and through Pages on the stack
+    file25.setSyncMode(SYNC_FLUSH);
+    BufMgr* mgr = new BufMgr(16);
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	mgr->readPage(&file25, j, page);
+	sprintf((char*)tmpbuf, "test.25 again %d", j);
+	page->insertRecord(tmpbuf);
+	mgr->unPinPage(&file25, j, true);
+      }
+    mgr->flushFile(&file25);
+    delete mgr;
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page onDisk = file25.readPage(j);
+	sprintf(expected, "test.25 again %d", j);
+	const RecordId recordId = {j, 2};
+	if (onDisk.getRecord(recordId) != expected)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+      }
+    if (!file25.setDirectIO(false) || file25.directIO())
+      {
+	PRINT_ERROR("ERROR :: Direct I/O not turned off");
+      }
+  }
+  if (sizeOnDisk(filename) != std::streamoff(4096 + numPages * Page::SIZE))
+    {
+      PRINT_ERROR("ERROR :: Aligned file has the wrong size");
+    }
+  File::remove(filename);
+
+  //a packed file has no direct I/O, and keeps its pages when migrated
+  {
+    File packed = File::create(filename, FORMAT_PACKED);
+    if (packed.format() != FORMAT_PACKED || packed.setDirectIO(true) || packed.directIO())
+      {
+	PRINT_ERROR("ERROR :: Packed file took direct I/O");
+      }
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	Page newPage = packed.allocatePage();
+	sprintf((char*)tmpbuf, "test.25 Page %d %7.1f", j, (float)j);
+	newPage.insertRecord(tmpbuf);
+	packed.writePage(newPage);
+      }
+    packed.deletePage(5);
+    try
+      {
+	File::migrate(filename);
+	PRINT_ERROR("ERROR :: Open file migrated");
+      }
+    catch(const FileOpenException& e)
+      {
+      }
+  }
+  if (sizeOnDisk(filename) != std::streamoff(sizeof(FileHeader) + numPages * Page::SIZE))
+    {
+      PRINT_ERROR("ERROR :: Packed file has the wrong size");
+    }
+  File::migrate(filename);
+  File::migrate(filename);
+  {
+    File file25 = File::open(filename);
+    if (file25.format() != FORMAT_ALIGNED ||
+	sizeOnDisk(filename) != std::streamoff(4096 + numPages * Page::SIZE))
+      {
+	PRINT_ERROR("ERROR :: File not migrated");
+      }
+    file25.setDirectIO(true);
+    PageId count = 0;
+    for (FileIterator iter = file25.begin(); iter != file25.end(); ++iter)
+      {
+	Page curr = *iter;
+	const PageId j = curr.page_number();
+	sprintf(expected, "test.25 Page %d %7.1f", j, (float)j);
+	const RecordId recordId = {j, 1};
+	if (j == 5 || curr.getRecord(recordId) != expected)
+	  {
+	    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	  }
+	count++;
+      }
+    //the deleted page is still the one to reuse
+    if (count != numPages - 1 || file25.allocatePage().page_number() != 5)
+      {
+	PRINT_ERROR("ERROR :: Page lists lost in migration");
+      }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 25 passed" << "\n";
+}
+
+void test26()
+{
+  //Mapped files are read from the mapping, by File and by the pool, and cannot be changed
+  const std::string& filename = "test.26";
+  const FileFormat formats[] = {FORMAT_ALIGNED, FORMAT_PACKED};
+  const PageId numPages = 30;
+  char expected[100];
+  for (int f = 0; f < 2; f++)
+    {
+      {
+	File file26 = freshFile(filename, formats[f]);
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    Page newPage = file26.allocatePage();
+	    sprintf((char*)tmpbuf, "test.26 Page %d %7.1f", j, (float)j);
+	    newPage.insertRecord(tmpbuf);
+	    file26.writePage(newPage);
+	  }
+	file26.deletePage(7);
+	try
+	  {
+	    File::openMapped(filename);
+	    PRINT_ERROR("ERROR :: File open for writing was mapped");
+	  }
+	catch(const FileOpenException& e)
+	  {
+	  }
+      }
+
+      {
+	File file26 = File::openMapped(filename);
+	File copy = File::open(filename);
+	if (!file26.mapped() || !copy.mapped() || file26.format() != formats[f])
+	  {
+	    PRINT_ERROR("ERROR :: File not mapped");
+	  }
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    if (j == 7)
+	      continue;
+	    sprintf(expected, "test.26 Page %d %7.1f", j, (float)j);
+	    const RecordId recordId = {j, 1};
+	    const Page* view = copy.mappedPage(j);
+	    if (view->page_number() != j || view->getRecord(recordId) != expected ||
+		file26.readPage(j).getRecord(recordId) != expected)
+	      {
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	      }
+	  }
+	int refused = 0;
+	try
+	  {
+	    file26.mappedPage(7);
+	  }
+	catch(const InvalidPageException& e)
+	  {
+	    refused++;
+	  }
+	try
+	  {
+	    file26.mappedPage(numPages + 1);
+	  }
+	catch(const InvalidPageException& e)
+	  {
+	    refused++;
+	  }
+	Page copied = file26.readPage(1);
+	try
+	  {
+	    copy.writePage(copied);
+	  }
+	catch(const FileReadOnlyException& e)
+	  {
+	    refused++;
+	  }
+	try
+	  {
+	    copy.allocatePage();
+	  }
+	catch(const FileReadOnlyException& e)
+	  {
+	    refused++;
+	  }
+	try
+	  {
+	    file26.deletePage(1);
+	  }
+	catch(const FileReadOnlyException& e)
+	  {
+	    refused++;
+	  }
+	if (refused != 5)
+	  {
+	    PRINT_ERROR("ERROR :: Mapped file served a missing page or took a write");
+	  }
+	if (!file26.adviseAccess(ADVISE_SEQUENTIAL) || !file26.adviseAccess(ADVISE_RANDOM, 3, 4) ||
+	    !file26.adviseAccess(ADVISE_WILLNEED, 20) || !file26.adviseAccess(ADVISE_NORMAL))
+	  {
+	    PRINT_ERROR("ERROR :: Access advice rejected");
+	  }
+
+	//the pool pins every page without a frame of its 4
+	BufMgr* mgr = new BufMgr(4);
+	std::vector<PageId> pageNos;
+	for (PageId j = 1; j <= numPages; j++)
+	  {
+	    if (j == 7)
+	      continue;
+	    mgr->readPage(&file26, j, page);
+	    if (page != file26.mappedPage(j))
+	      {
+		PRINT_ERROR("ERROR :: Pool did not hand out the mapped page");
+	      }
+	    pageNos.push_back(j);
+	  }
+	std::vector<Page*> pages;
+	mgr->readPages(&file26, pageNos, pages);
+	PinnedPage pinned = mgr->pinPage(&file26, 2);
+	if (pages.size() != numPages - 1 || pages[5] != file26.mappedPage(6) || !pinned ||
+	    pinned->page_number() != 2)
+	  {
+	    PRINT_ERROR("ERROR :: Pool did not hand out the mapped pages");
+	  }
+	mgr->prefetch(&file26, 1, numPages);
+	mgr->unPinPages(&file26, pageNos, false);
+	try
+	  {
+	    mgr->unPinPage(&file26, 1, true);
+	    PRINT_ERROR("ERROR :: Mapped page dirtied");
+	  }
+	catch(const FileReadOnlyException& e)
+	  {
+	  }
+	pinned.release();
+	BufStats stats = mgr->getBufStats();
+	if (stats.counters[MAPPED_PINS] != 2 * (numPages - 1) + 1 ||
+	    stats.counters[MISSES] != 0 || stats.counters[DISK_READS] != 0)
+	  {
+	    PRINT_ERROR("ERROR :: Mapped pins counted wrong");
+	  }
+	try
+	  {
+	    PageId pageNo;
+	    mgr->allocPage(&file26, pageNo, page);
+	    PRINT_ERROR("ERROR :: Page allocated in a mapped file");
+	  }
+	catch(const FileReadOnlyException& e)
+	  {
+	  }
+	delete mgr;
+      }
+
+      //writable again once the mapping is gone
+      {
+	File file26 = File::open(filename);
+	if (file26.mapped() || file26.allocatePage().page_number() != 7)
+	  {
+	    PRINT_ERROR("ERROR :: File still mapped");
+	  }
+      }
+    }
+  File::remove(filename);
+
+  std::cout << "Test 26 passed" << "\n";
+}
+
+bool usedPagesMatch(File& file, const std::set<PageId>& used)
+{
+  std::set<PageId>::const_iterator expected = used.begin();
+  for (FileIterator iter = file.begin(); iter != file.end(); ++iter, ++expected)
+    {
+      if (expected == used.end() || (*iter).page_number() != *expected)
+	return false;
+    }
+  return expected == used.end();
+}
+
+void test27()
+{
+  //Allocation and deletion keep the used list in page number order without walking it
+  const std::string& filename = "test.27";
+  const PageId numPages = 5000;
+
+  std::set<PageId> used;
+  std::vector<PageId> freed;
+  {
+    //quadratic before, so this alone took minutes
+    File file27 = freshFile(filename);
+    file27.setSyncMode(SYNC_FLUSH);
+    for (PageId j = 1; j <= numPages; j++)
+      {
+	if (file27.allocatePage().page_number() != j)
+	  {
+	    PRINT_ERROR("ERROR :: Pages not appended in order");
+	  }
+	used.insert(j);
+      }
+    //runs deleted upwards and downwards, and scattered pages, then reused last freed first
+    for (PageId j = 1000; j < 1100; j++)
+      freed.push_back(j);
+    for (PageId j = 2100; j > 2000; j--)
+      freed.push_back(j);
+    for (PageId j = 3; j < numPages; j += 97)
+      {
+	if ((j < 1000 || j >= 1100) && (j <= 2000 || j > 2100))
+	  freed.push_back(j);
+      }
+    freed.push_back(1);
+    freed.push_back(numPages);
+    for (std::size_t i = 0; i < freed.size(); i++)
+      {
+	file27.deletePage(freed[i]);
+	used.erase(freed[i]);
+      }
+    if (!usedPagesMatch(file27, used))
+      {
+	PRINT_ERROR("ERROR :: Used list wrong after deletions");
+      }
+    for (std::size_t i = 0; i < freed.size() / 2; i++)
+      {
+	const PageId expected = freed.back();
+	freed.pop_back();
+	if (file27.allocatePage().page_number() != expected)
+	  {
+	    PRINT_ERROR("ERROR :: Free page not reused");
+	  }
+	used.insert(expected);
+      }
+    if (!usedPagesMatch(file27, used))
+      {
+	PRINT_ERROR("ERROR :: Used list wrong after reuse");
+      }
+  }
+
+  //a new open finds its way with nothing remembered
+  {
+    File file27 = File::open(filename);
+    file27.deletePage(*used.rbegin());
+    file27.deletePage(*used.begin());
+    used.erase(*used.rbegin());
+    used.erase(used.begin());
+    while (!freed.empty())
+      {
+	used.insert(file27.allocatePage().page_number());
+	freed.pop_back();
+      }
+    for (int i = 0; i < 3; i++)
+      used.insert(file27.allocatePage().page_number());
+    if (used.size() != numPages + 1 || !usedPagesMatch(file27, used))
+      {
+	PRINT_ERROR("ERROR :: Used list wrong after reopening");
+      }
+  }
+
+  //deletes interleaved between far apart pages, so the page reused last
+  //tells nothing about where the next one goes
+  {
+    File file27 = File::open(filename);
+    for (PageId j = 1000; j <= 2000; j++)
+      {
+	file27.deletePage(j);
+	used.erase(j);
+      }
+    file27.deletePage(5);
+    used.erase(5);
+    for (PageId j = 0; j < 50; j++)
+      {
+	file27.deletePage(3000 + j);
+	file27.deletePage(4500 - j);
+	used.erase(3000 + j);
+	used.erase(4500 - j);
+      }
+    for (PageId j = 50; j-- > 0; )
+      {
+	if (file27.allocatePage().page_number() != 4500 - j ||
+	    file27.allocatePage().page_number() != 3000 + j)
+	  {
+	    PRINT_ERROR("ERROR :: Interleaved free pages not reused");
+	  }
+	used.insert(4500 - j);
+	used.insert(3000 + j);
+      }
+    if (file27.allocatePage().page_number() != 5 ||
+	file27.allocatePage().page_number() != 2000)
+      {
+	PRINT_ERROR("ERROR :: Free page not reused after a run");
+      }
+    used.insert(5);
+    used.insert(2000);
+    if (!usedPagesMatch(file27, used))
+      {
+	PRINT_ERROR("ERROR :: Used list wrong after interleaved reuse");
+      }
+  }
+  {
+    File file27 = File::open(filename);
+    for (PageId j = 1000; j < 2000; j++)
+      {
+	used.insert(file27.allocatePage().page_number());
+      }
+    if (used.size() != numPages + 1 || !usedPagesMatch(file27, used))
+      {
+	PRINT_ERROR("ERROR :: Used list wrong after reusing the run");
+      }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 27 passed" << "\n";
+}
+
+bool hashEntriesMatch(BufHashTbl& table, const std::map<PageId, FrameId>& present,
+                      const std::set<PageId>& absent)
+{
+  FrameId frameNo;
+  for (std::map<PageId, FrameId>::const_iterator it = present.begin(); it != present.end(); ++it)
+    {
+      if (!table.probe(file1ptr, it->first, frameNo) || frameNo != it->second)
+	return false;
+    }
+  for (std::set<PageId>::const_iterator it = absent.begin(); it != absent.end(); ++it)
+    {
+      if (table.probe(file1ptr, *it, frameNo))
+	return false;
+    }
+  return true;
+}
+
+void test28()
+{
+  //Robin Hood insert, backward-shift erase and resize of the hash table on colliding keys
+  BufHashTbl table(12);
+  std::map<PageId, FrameId> present;
+  std::set<PageId> absent;
+
+  //keys agreeing in the low 12 bits of their hash share a home slot in any
+  //table of up to 4096 slots; the second group homes on the next slot, so the
+  //two groups interleave in one probe run
+  const std::uint64_t home = table.hashOf(file1ptr, 1) & 0xfff;
+  std::vector<PageId> same, next;
+  for (PageId p = 1; same.size() < 6 || next.size() < 4; p++)
+    {
+      const std::uint64_t slot = table.hashOf(file1ptr, p) & 0xfff;
+      if (slot == home && same.size() < 6)
+	same.push_back(p);
+      else if (slot == ((home + 1) & 0xfff) && next.size() < 4)
+	next.push_back(p);
+    }
+  std::vector<PageId> keys;
+  for (std::size_t j = 0; j < same.size(); j++)
+    {
+      keys.push_back(same[j]);
+      if (j < next.size())
+	keys.push_back(next[j]);
+    }
+
+  for (std::size_t j = 0; j < keys.size(); j++)
+    {
+      table.insert(file1ptr, keys[j], j);
+      present[keys[j]] = j;
+      if (!hashEntriesMatch(table, present, absent))
+	{
+	  PRINT_ERROR("ERROR :: Entry lost while inserting colliding keys");
+	}
+    }
+  try
+    {
+      table.insert(file1ptr, same[3], 99);
+      PRINT_ERROR("ERROR :: Duplicate insert accepted");
+    }
+  catch(const HashAlreadyPresentException& e)
+    {
+    }
+
+  //erase from the middle of the run, then its head, then a key of the other group
+  const PageId order[] = {same[2], same[0], next[1], same[5]};
+  for (std::size_t j = 0; j < sizeof(order) / sizeof(order[0]); j++)
+    {
+      if (!table.erase(file1ptr, order[j]) || table.erase(file1ptr, order[j]))
+	{
+	  PRINT_ERROR("ERROR :: Erase of colliding key wrong");
+	}
+      present.erase(order[j]);
+      absent.insert(order[j]);
+      if (!hashEntriesMatch(table, present, absent))
+	{
+	  PRINT_ERROR("ERROR :: Entry lost after erasing from a probe run");
+	}
+    }
+
+  //reinsert into the holes, then fill the table to its limit
+  table.insert(file1ptr, same[2], 20);
+  present[same[2]] = 20;
+  absent.erase(same[2]);
+  PageId extra = 100000;
+  while (present.size() < 12)
+    {
+      table.insert(file1ptr, extra, extra);
+      present[extra] = extra;
+      extra++;
+    }
+  if (!hashEntriesMatch(table, present, absent))
+    {
+      PRINT_ERROR("ERROR :: Entry lost after filling the table");
+    }
+  try
+    {
+      table.insert(file1ptr, extra, extra);
+      PRINT_ERROR("ERROR :: Insert into a full table accepted");
+    }
+  catch(const HashTableException& e)
+    {
+    }
+
+  //growing rehashes every entry and makes room for more
+  table.resize(400);
+  if (!hashEntriesMatch(table, present, absent))
+    {
+      PRINT_ERROR("ERROR :: Entry lost growing the table");
+    }
+  while (present.size() < 400)
+    {
+      table.insert(file1ptr, extra, extra);
+      present[extra] = extra;
+      extra++;
+    }
+  if (!hashEntriesMatch(table, present, absent))
+    {
+      PRINT_ERROR("ERROR :: Entry lost filling the grown table");
+    }
+
+  //shrinking keeps every entry, and never below the entries held
+  table.resize(8);
+  if (!hashEntriesMatch(table, present, absent))
+    {
+      PRINT_ERROR("ERROR :: Entry lost when shrinking below the entries held");
+    }
+  for (PageId p = 100000; p < extra; p++)
+    {
+      if (present.size() > 5 && p % 3 != 0)
+	{
+	  table.erase(file1ptr, p);
+	  present.erase(p);
+	  absent.insert(p);
+	}
+    }
+  table.resize(8);
+  if (!hashEntriesMatch(table, present, absent))
+    {
+      PRINT_ERROR("ERROR :: Entry lost shrinking the table");
+    }
+  for (std::map<PageId, FrameId>::iterator it = present.begin(); present.size() > 8; )
+    {
+      table.erase(file1ptr, it->first);
+      absent.insert(it->first);
+      present.erase(it++);
+    }
+  table.resize(8);
+  while (present.size() < 8)
+    {
+      absent.erase(extra);
+      table.insert(file1ptr, extra, extra);
+      present[extra] = extra;
+      extra++;
+    }
+  try
+    {
+      table.insert(file1ptr, extra, extra);
+      PRINT_ERROR("ERROR :: Insert past the shrunk limit accepted");
+    }
+  catch(const HashTableException& e)
+    {
+    }
+  if (!hashEntriesMatch(table, present, absent))
+    {
+      PRINT_ERROR("ERROR :: Entry lost in the shrunk table");
+    }
+
+  std::cout << "Test 28 passed" << "\n";
+}
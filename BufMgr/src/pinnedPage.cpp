@@ -0,0 +1,63 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <iostream>
+#include "pinnedPage.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+PinnedPage::PinnedPage()
+	: mgr(NULL), pinned(NULL), pinnedFrame(0), pinnedPageNo(Page::INVALID_NUMBER), dirty(false)
+{
+}
+
+PinnedPage::PinnedPage(BufMgr* mgr, Page* page, const FrameId frame, const PageId pageNo)
+	: mgr(mgr), pinned(page), pinnedFrame(frame), pinnedPageNo(pageNo), dirty(false)
+{
+}
+
+PinnedPage::PinnedPage(PinnedPage&& other)
+	: mgr(other.mgr), pinned(other.pinned), pinnedFrame(other.pinnedFrame),
+	  pinnedPageNo(other.pinnedPageNo), dirty(other.dirty)
+{
+  other.mgr = NULL;
+  other.pinned = NULL;
+  other.dirty = false;
+}
+
+PinnedPage& PinnedPage::operator=(PinnedPage&& other)
+{
+  if (this != &other) {
+    release();
+    mgr = other.mgr;
+    pinned = other.pinned;
+    pinnedFrame = other.pinnedFrame;
+    pinnedPageNo = other.pinnedPageNo;
+    dirty = other.dirty;
+    other.mgr = NULL;
+    other.pinned = NULL;
+    other.dirty = false;
+  }
+  return *this;
+}
+
+PinnedPage::~PinnedPage()
+{
+  release();
+}
+
+void PinnedPage::release()
+{
+  if (mgr != NULL)
+    mgr->unPinFrame(pinnedFrame, dirty);
+  mgr = NULL;
+  pinned = NULL;
+  dirty = false;
+}
+
+}
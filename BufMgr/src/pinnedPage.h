@@ -0,0 +1,123 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufMgr;
+
+/**
+* @brief A pin on a page in the buffer pool, dropped when the handle goes away
+*
+* Returned by BufMgr::pinPage() and BufMgr::pinNewPage().  The handle
+* remembers the frame holding the page, so unpinning it goes straight to the
+* frame instead of looking the page up in the hash table again, and happens
+* in the destructor, so an exception between pinning and unpinning cannot
+* leak the pin.  Handles can be moved but not copied; moving one hands the
+* pin over without touching the buffer pool.
+*/
+class PinnedPage
+{
+  friend class BufMgr;
+
+ private:
+	/**
+	 * Buffer manager holding the pin, NULL if the handle holds none or holds
+	 * a page of a mapped file, which needs no unpinning
+	 */
+  BufMgr* mgr;
+
+	/**
+	 * The pinned page, its frame and its number
+	 */
+  Page* pinned;
+  FrameId pinnedFrame;
+  PageId pinnedPageNo;
+
+	/**
+	 * True if the page is to be marked dirty when unpinned
+	 */
+  bool dirty;
+
+	/**
+	 * Constructor used by BufMgr for a page it has just pinned
+	 */
+  PinnedPage(BufMgr* mgr, Page* page, const FrameId frame, const PageId pageNo);
+
+  PinnedPage(const PinnedPage&);
+  PinnedPage& operator=(const PinnedPage&);
+
+ public:
+	/**
+   * Constructor of an empty PinnedPage, holding no pin
+	 */
+  PinnedPage();
+
+	/**
+   * Takes the pin over from other, which is left empty
+	 */
+  PinnedPage(PinnedPage&& other);
+
+	/**
+   * Drops the pin held, if any, and takes the pin over from other, which is
+   * left empty
+	 */
+  PinnedPage& operator=(PinnedPage&& other);
+
+	/**
+   * Destructor of PinnedPage class, unpins the page
+	 */
+  ~PinnedPage();
+
+	/**
+   * Unpins the page now, marking it dirty if markDirty() was called; the
+   * handle is empty afterwards.  Does nothing on an empty handle.
+	 */
+  void release();
+
+	/**
+   * Has the page marked dirty when it is unpinned, once it has been or is
+   * about to be modified
+	 */
+  void markDirty() { dirty = true; }
+
+	/**
+   * Returns true if the page will be marked dirty when unpinned
+	 */
+  bool isDirty() const { return dirty; }
+
+	/**
+   * Returns true if the handle holds a pin
+	 */
+  explicit operator bool() const { return pinned != NULL; }
+
+	/**
+   * Returns the pinned page, NULL for an empty handle
+	 */
+  Page* get() const { return pinned; }
+  Page* operator->() const { return pinned; }
+  Page& operator*() const { return *pinned; }
+
+	/**
+   * Returns the number of the pinned page in its file
+	 */
+  PageId pageNo() const { return pinnedPageNo; }
+
+	/**
+   * Returns the frame holding the pinned page
+	 */
+  FrameId frame() const { return pinnedFrame; }
+};
+
+}
@@ -0,0 +1,148 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "arcPolicy.h"
+
+namespace badgerdb {
+
+ArcPolicy::ArcPolicy(const std::uint32_t numFrames)
+  : numFrames(numFrames), cacheSize(numFrames), p(0), links(numFrames), list(numFrames, NO_LIST), cold(numFrames, false),
+    ghosts(2 * numFrames, 2)
+{
+}
+
+void ArcPolicy::trimGhosts()
+{
+  while (t1.size() + ghosts.size(B1) > cacheSize && ghosts.size(B1) > 0)
+    ghosts.eraseOldest(B1);
+  while (t1.size() + t2.size() + ghosts.size(B1) + ghosts.size(B2) > 2 * cacheSize &&
+         ghosts.size(B2) > 0)
+    ghosts.eraseOldest(B2);
+}
+
+void ArcPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                           const bool cold)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  int ghostList;
+  const std::uint32_t slot = ghosts.find(file, pageNo, ghostList);
+  this->cold[frame] = cold;
+  if (cold)
+  {
+    // LRU end of T1, without adapting p
+    if (slot != GhostCache::NONE)
+      ghosts.erase(slot);
+    t1.pushBack(links, frame);
+    list[frame] = T1;
+  }
+  else if (slot == GhostCache::NONE)
+  {
+    t1.pushFront(links, frame);
+    list[frame] = T1;
+  }
+  else
+  {
+    // a ghost hit says which list deserved the space
+    const std::uint32_t b1 = ghosts.size(B1);
+    const std::uint32_t b2 = ghosts.size(B2);
+    if (ghostList == B1)
+      p = std::min(cacheSize, p + std::max<std::uint32_t>(1, b2 / b1));
+    else
+      p -= std::min(p, std::max<std::uint32_t>(1, b1 / b2));
+    ghosts.erase(slot);
+    t2.pushFront(links, frame);
+    list[frame] = T2;
+  }
+  trimGhosts();
+}
+
+void ArcPolicy::pageAccessed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (list[frame] == NO_LIST)
+    return;
+  cold[frame] = false;
+  (list[frame] == T1 ? t1 : t2).remove(links, frame);
+  t2.pushFront(links, frame);
+  list[frame] = T2;
+}
+
+void ArcPolicy::pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                            const bool evicted)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (list[frame] == NO_LIST)
+    return;
+  const bool fromT1 = list[frame] == T1;
+  (fromT1 ? t1 : t2).remove(links, frame);
+  list[frame] = NO_LIST;
+  if (evicted && !cold[frame])
+  {
+    ghosts.insert(fromT1 ? B1 : B2, file, pageNo);
+    trimGhosts();
+  }
+}
+
+FrameId ArcPolicy::pickVictim(const FrameEvictor& evictor, const bool inB2,
+                              const std::vector<bool>& failed)
+{
+  // REPLACE(x, p) from the paper
+  const bool fromT1 = t1.size() > 0 && ((inB2 && t1.size() == p) || t1.size() > p);
+  FrameId victim = coldestUnpinned(fromT1 ? t1 : t2, links, evictor, failed);
+  if (victim == IndexLinks::NONE)
+    victim = coldestUnpinned(fromT1 ? t2 : t1, links, evictor, failed);
+  return victim;
+}
+
+void ArcPolicy::upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                                std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  const bool fromT1 = t1.size() > 0 && t1.size() > p;
+  appendUnpinned(fromT1 ? t1 : t2, links, evictor, count, frames);
+  appendUnpinned(fromT1 ? t2 : t1, links, evictor, count, frames);
+}
+
+bool ArcPolicy::chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                             FrameId& frame)
+{
+  // a victim that cannot be evicted is set aside, so each attempt looks at
+  // another frame
+  std::vector<bool> failed;
+  for (std::uint32_t attempt = 0; attempt < 2 * numFrames; attempt++)
+  {
+    FrameId victim;
+    {
+      std::lock_guard<std::mutex> guard(latch);
+      int ghostList = -1;
+      if (file != NULL)
+        ghosts.find(file, pageNo, ghostList);
+      victim = pickVictim(evictor, ghostList == B2, failed);
+    }
+    if (victim == IndexLinks::NONE)
+      return false;
+    if (evictor.tryEvict(victim))
+    {
+      frame = victim;
+      return true;
+    }
+    markFailed(failed, numFrames, victim);
+  }
+  return false;
+}
+
+void ArcPolicy::poolResized(const std::vector<FrameId>& poolFrames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  cacheSize = poolFrames.size();
+  p = std::min(p, cacheSize);
+  trimGhosts();
+}
+
+}
@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "replacementPolicy.h"
+#include "ghostCache.h"
+
+namespace badgerdb {
+
+/**
+* @brief Adaptive Replacement Cache (Megiddo and Modha)
+*
+* Resident pages seen once are on T1, pages seen more than once on T2, both in
+* LRU order.  B1 and B2 remember the pages recently evicted from T1 and T2.
+* A miss that hits in B1 means T1 was too small and grows its target size p;
+* one that hits in B2 shrinks it.  Victims come from T1 while it is larger than
+* p and from T2 otherwise.
+*/
+class ArcPolicy : public ReplacementPolicy
+{
+ public:
+  explicit ArcPolicy(const std::uint32_t numFrames);
+
+  const char* name() const { return "arc"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                  const bool cold);
+  void pageAccessed(const FrameId frame);
+  void pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                   const bool evicted);
+  bool chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                    FrameId& frame);
+  void upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                       std::vector<FrameId>& frames);
+  void poolResized(const std::vector<FrameId>& poolFrames);
+
+ private:
+  enum List { NO_LIST, T1, T2 };
+
+	/**
+	 * Ghost lists
+	 */
+  enum { B1 = 0, B2 = 1 };
+
+	/**
+	 * Forgets old ghosts so |T1| + |B1| <= c and the whole directory <= 2c.
+	 */
+  void trimGhosts();
+
+	/**
+	 * Returns the frame to evict next whose page is not pinned and that is
+	 * not marked in failed, or IndexLinks::NONE.
+	 *
+	 * @param inB2    True if the page the frame is needed for is remembered in B2
+	 * @param failed  Frames that could not be evicted earlier in this search
+	 */
+  FrameId pickVictim(const FrameEvictor& evictor, const bool inB2,
+                     const std::vector<bool>& failed);
+
+	/**
+	 * Number of frames the per-frame arrays are sized for
+	 */
+  std::uint32_t numFrames;
+
+	/**
+	 * Number of frames in the pool, c in the paper
+	 */
+  std::uint32_t cacheSize;
+
+	/**
+	 * Target size of T1
+	 */
+  std::uint32_t p;
+
+  IndexLinks links;
+  IndexList t1;
+  IndexList t2;
+
+	/**
+	 * List each frame is on
+	 */
+  std::vector<char> list;
+
+	/**
+	 * True for frames loaded cold and not accessed since
+	 */
+  std::vector<char> cold;
+
+	/**
+	 * B1 and B2
+	 */
+  GhostCache ghosts;
+
+  std::mutex latch;
+};
+
+}
@@ -0,0 +1,81 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "clockPolicy.h"
+
+namespace badgerdb {
+
+ClockPolicy::ClockPolicy(const std::uint32_t numFrames)
+  : clockHand(0), poolFrames(new std::atomic<FrameId>[numFrames]), poolCount(numFrames)
+{
+  for (std::uint32_t i = 0; i < numFrames; i++)
+    poolFrames[i].store(i, std::memory_order_relaxed);
+}
+
+FrameId ClockPolicy::advanceClock(const std::uint32_t count)
+{
+  //advance clock
+  //if goes out of bounds, cycle back
+  const std::uint64_t step = clockHand.fetch_add(1, std::memory_order_relaxed);
+  return poolFrames[step % count].load(std::memory_order_relaxed);
+}
+
+bool ClockPolicy::chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                               FrameId& frame)
+{
+  const std::uint32_t count = poolCount.load(std::memory_order_acquire);
+
+  // cycle at most twice for pages with refbit==true
+  for (std::uint32_t i = 0; i < 2 * count; i++)
+  {
+    const FrameId hand = advanceClock(count);
+
+    // frames in transition belong to another thread
+    if (!evictor.isResident(hand))
+      continue;
+
+    // clear refbit
+    if (evictor.clearReferenced(hand))
+      continue;
+
+    // if not pinned
+    if (evictor.isPinned(hand))
+      continue;
+
+    if (evictor.tryEvict(hand))
+    {
+      frame = hand;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockPolicy::upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                                  std::vector<FrameId>& frames)
+{
+  // frames the hand will take on its next pass; referenced ones get another chance
+  const std::uint32_t size = poolCount.load(std::memory_order_acquire);
+  if (size == 0)
+    return;
+  const std::uint32_t hand = clockHand.load(std::memory_order_relaxed) % size;
+  for (std::uint32_t i = 0; i < size && frames.size() < count; i++)
+  {
+    const FrameId frame = poolFrames[(hand + i) % size].load(std::memory_order_relaxed);
+    if (evictor.isResident(frame) && !evictor.isReferenced(frame) && !evictor.isPinned(frame))
+      frames.push_back(frame);
+  }
+}
+
+void ClockPolicy::poolResized(const std::vector<FrameId>& frames)
+{
+  for (std::size_t i = 0; i < frames.size(); i++)
+    poolFrames[i].store(frames[i], std::memory_order_relaxed);
+  poolCount.store(frames.size(), std::memory_order_release);
+}
+
+}
@@ -0,0 +1,69 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "replacementPolicy.h"
+
+namespace badgerdb {
+
+/**
+* @brief Clock replacement, the original BadgerDB algorithm
+*
+* Keeps no state besides the clock hand and the frames it sweeps: the
+* reference bits are maintained by BufMgr in the frame descriptors.  The hand
+* is advanced with an atomic increment, so any number of threads can sweep at
+* once without a latch.  Only the frames in the pool are swept, not those
+* reserved for a later resize.
+*/
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+  explicit ClockPolicy(const std::uint32_t numFrames);
+
+  const char* name() const { return "clock"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                  const bool cold) {}
+  void pageAccessed(const FrameId frame) {}
+  void pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                   const bool evicted) {}
+  bool chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                    FrameId& frame);
+  void upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                       std::vector<FrameId>& frames);
+  void poolResized(const std::vector<FrameId>& poolFrames);
+
+ private:
+	/**
+	 * Advance clock to next frame in the buffer pool
+	 *
+	 * @param count   Number of frames the hand sweeps
+	 * @return The frame the clock hand moved to
+	 */
+  FrameId advanceClock(const std::uint32_t count);
+
+	/**
+	 * Number of steps the clock hand has taken; 64 bits wide, so it never
+	 * wraps and the hand never jumps back whatever the number of frames
+	 */
+  std::atomic<std::uint64_t> clockHand;
+
+	/**
+	 * Frames in the buffer pool, ascending, in the first poolCount entries.
+	 * A sweep racing a resize may see a mix of the old and new lists; that
+	 * only makes it skip a frame or visit one out of the pool, which is not
+	 * resident.
+	 */
+  std::unique_ptr<std::atomic<FrameId>[]> poolFrames;
+  std::atomic<std::uint32_t> poolCount;
+};
+
+}
@@ -0,0 +1,65 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "ghostCache.h"
+
+namespace badgerdb {
+
+GhostCache::GhostCache(const std::uint32_t capacity, const int listCount)
+  : files(capacity, NULL), pageNos(capacity, PageId(Page::INVALID_NUMBER)), owner(capacity, -1),
+    links(capacity), lists(listCount), index(capacity)
+{
+  freeSlots.reserve(capacity);
+  for (std::uint32_t i = capacity; i > 0; i--)
+    freeSlots.push_back(i - 1);
+}
+
+std::uint32_t GhostCache::find(const File* file, const PageId pageNo, int& list)
+{
+  FrameId slot;
+  if (!index.probe(file, pageNo, slot))
+    return NONE;
+  list = owner[slot];
+  return slot;
+}
+
+std::uint32_t GhostCache::insert(const int list, const File* file, const PageId pageNo)
+{
+  if (freeSlots.empty())
+  {
+    int longest = 0;
+    for (int i = 1; i < (int)lists.size(); i++)
+      if (lists[i].size() > lists[longest].size())
+        longest = i;
+    eraseOldest(longest);
+  }
+
+  const std::uint32_t slot = freeSlots.back();
+  freeSlots.pop_back();
+  files[slot] = file;
+  pageNos[slot] = pageNo;
+  owner[slot] = list;
+  lists[list].pushFront(links, slot);
+  index.insert(file, pageNo, slot);
+  return slot;
+}
+
+void GhostCache::erase(const std::uint32_t slot)
+{
+  index.erase(files[slot], pageNos[slot]);
+  lists[owner[slot]].remove(links, slot);
+  owner[slot] = -1;
+  files[slot] = NULL;
+  freeSlots.push_back(slot);
+}
+
+void GhostCache::eraseOldest(const int list)
+{
+  erase(lists[list].back());
+}
+
+}
@@ -0,0 +1,86 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "file.h"
+#include "bufHashTbl.h"
+#include "indexList.h"
+
+namespace badgerdb {
+
+/**
+* @brief Remembers the identity of recently evicted pages, without their contents
+*
+* Entries live in a fixed number of slots, each on one of a few lists kept in
+* insertion order, and are found by (file, pageNo) through a BufHashTbl.  The
+* File pointers are only compared, never dereferenced, so an entry may outlive
+* its File object.  Not latched; the owning policy serializes access.
+*/
+class GhostCache
+{
+ public:
+	/**
+	 * Returned by find() when the page is not remembered
+	 */
+  static const std::uint32_t NONE = IndexLinks::NONE;
+
+	/**
+	 * Constructor of GhostCache class
+	 *
+	 * @param capacity Maximum number of entries over all lists
+	 * @param listCount Number of lists
+	 */
+  GhostCache(const std::uint32_t capacity, const int listCount);
+
+	/**
+	 * Returns the slot remembering (file, pageNo), or NONE.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param list    List the entry is on, returned via this variable
+	 */
+  std::uint32_t find(const File* file, const PageId pageNo, int& list);
+
+	/**
+	 * Remembers (file, pageNo), which must not be remembered already, at the
+	 * front of list.  When every slot is in use the oldest entry of the longest
+	 * list is forgotten first.
+	 *
+	 * @return Slot of the new entry
+	 */
+  std::uint32_t insert(const int list, const File* file, const PageId pageNo);
+
+	/**
+	 * Forgets the entry in slot.
+	 */
+  void erase(const std::uint32_t slot);
+
+	/**
+	 * Forgets the oldest entry of list, which must not be empty.
+	 */
+  void eraseOldest(const int list);
+
+	/**
+	 * Returns the number of entries on list.
+	 */
+  std::uint32_t size(const int list) const { return lists[list].size(); }
+
+ private:
+  std::vector<const File*> files;
+  std::vector<PageId> pageNos;
+  std::vector<int> owner;
+  IndexLinks links;
+  std::vector<IndexList> lists;
+  std::vector<std::uint32_t> freeSlots;
+  BufHashTbl index;
+};
+
+}
@@ -0,0 +1,108 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+* @brief Link arrays shared by a set of IndexLists; each index is on at most one list
+*/
+struct IndexLinks {
+	/**
+	 * Marks the end of a list
+	 */
+  static const std::uint32_t NONE = 0xffffffff;
+
+	/**
+	 * Previous (towards the front) index on the list, per index
+	 */
+  std::vector<std::uint32_t> prev;
+
+	/**
+	 * Next (towards the back) index on the list, per index
+	 */
+  std::vector<std::uint32_t> next;
+
+  explicit IndexLinks(const std::uint32_t count)
+    : prev(count, std::uint32_t(NONE)), next(count, std::uint32_t(NONE)) {}
+};
+
+/**
+* @brief Doubly linked list of small integer indexes (frames or ghost slots)
+*
+* The links live in an IndexLinks, so the list never allocates.  The front is
+* the most recently inserted end.
+*/
+class IndexList {
+ public:
+  IndexList() : head(IndexLinks::NONE), tail(IndexLinks::NONE), count(0) {}
+
+  std::uint32_t front() const { return head; }
+  std::uint32_t back() const { return tail; }
+  std::uint32_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+	/**
+	 * Inserts index at the front of the list.
+	 */
+  void pushFront(IndexLinks& links, const std::uint32_t index)
+  {
+    links.prev[index] = IndexLinks::NONE;
+    links.next[index] = head;
+    if (head != IndexLinks::NONE)
+      links.prev[head] = index;
+    else
+      tail = index;
+    head = index;
+    count++;
+  }
+
+	/**
+	 * Inserts index at the back of the list.
+	 */
+  void pushBack(IndexLinks& links, const std::uint32_t index)
+  {
+    links.next[index] = IndexLinks::NONE;
+    links.prev[index] = tail;
+    if (tail != IndexLinks::NONE)
+      links.next[tail] = index;
+    else
+      head = index;
+    tail = index;
+    count++;
+  }
+
+	/**
+	 * Removes index, which must be on this list.
+	 */
+  void remove(IndexLinks& links, const std::uint32_t index)
+  {
+    const std::uint32_t before = links.prev[index];
+    const std::uint32_t after = links.next[index];
+    if (before != IndexLinks::NONE)
+      links.next[before] = after;
+    else
+      head = after;
+    if (after != IndexLinks::NONE)
+      links.prev[after] = before;
+    else
+      tail = before;
+    links.prev[index] = links.next[index] = IndexLinks::NONE;
+    count--;
+  }
+
+ private:
+  std::uint32_t head;
+  std::uint32_t tail;
+  std::uint32_t count;
+};
+
+}
@@ -0,0 +1,221 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "lruKPolicy.h"
+
+namespace badgerdb {
+
+LruKPolicy::LruKPolicy(const std::uint32_t numFrames, const std::uint32_t k)
+  : numFrames(numFrames), k(k), now(0), history((std::size_t)numFrames * k, 0),
+    cold(numFrames, false), heapPos(numFrames, std::uint32_t(IndexLinks::NONE)), ghosts(numFrames, 1),
+    ghostHistory((std::size_t)numFrames * k, 0)
+{
+  heap.reserve(numFrames);
+  skipped.reserve(numFrames);
+}
+
+void LruKPolicy::recordAccess(const FrameId frame)
+{
+  std::uint64_t* times = &history[(std::size_t)frame * k];
+  std::copy_backward(times, times + k - 1, times + k);
+  times[0] = ++now;
+}
+
+bool LruKPolicy::colder(const FrameId a, const FrameId b) const
+{
+  // backward K-distance: a page seen fewer than K times has an infinite one
+  const std::uint64_t kthA = history[(std::size_t)a * k + k - 1];
+  const std::uint64_t kthB = history[(std::size_t)b * k + k - 1];
+  if (kthA != kthB)
+    return kthA < kthB;
+  return history[(std::size_t)a * k] < history[(std::size_t)b * k];
+}
+
+void LruKPolicy::heapSet(const std::uint32_t pos, const FrameId frame)
+{
+  heap[pos] = frame;
+  heapPos[frame] = pos;
+}
+
+void LruKPolicy::siftUp(std::uint32_t pos)
+{
+  const FrameId frame = heap[pos];
+  while (pos > 0)
+  {
+    const std::uint32_t parent = (pos - 1) / 2;
+    if (!colder(frame, heap[parent]))
+      break;
+    heapSet(pos, heap[parent]);
+    pos = parent;
+  }
+  heapSet(pos, frame);
+}
+
+void LruKPolicy::siftDown(std::uint32_t pos)
+{
+  const FrameId frame = heap[pos];
+  const std::uint32_t count = heap.size();
+  for (;;)
+  {
+    std::uint32_t child = pos * 2 + 1;
+    if (child >= count)
+      break;
+    if (child + 1 < count && colder(heap[child + 1], heap[child]))
+      child++;
+    if (!colder(heap[child], frame))
+      break;
+    heapSet(pos, heap[child]);
+    pos = child;
+  }
+  heapSet(pos, frame);
+}
+
+void LruKPolicy::heapPush(const FrameId frame)
+{
+  heap.push_back(frame);
+  heapPos[frame] = heap.size() - 1;
+  siftUp(heap.size() - 1);
+}
+
+void LruKPolicy::heapErase(const FrameId frame)
+{
+  const std::uint32_t pos = heapPos[frame];
+  heapPos[frame] = IndexLinks::NONE;
+  const FrameId last = heap.back();
+  heap.pop_back();
+  if (last == frame)
+    return;
+  heapSet(pos, last);
+  siftUp(pos);
+  siftDown(heapPos[last]);
+}
+
+void LruKPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                            const bool cold)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  std::uint64_t* times = &history[(std::size_t)frame * k];
+  int list;
+  const std::uint32_t slot = ghosts.find(file, pageNo, list);
+  this->cold[frame] = cold;
+  if (cold)
+  {
+    // no recorded access at all puts it at the top of the heap
+    if (slot != GhostCache::NONE)
+      ghosts.erase(slot);
+    std::fill(times, times + k, 0);
+    heapPush(frame);
+    return;
+  }
+  if (slot != GhostCache::NONE)
+  {
+    // the page was evicted recently; pick up its history where it left off
+    std::copy(&ghostHistory[(std::size_t)slot * k], &ghostHistory[(std::size_t)slot * k] + k, times);
+    ghosts.erase(slot);
+  }
+  else
+  {
+    std::fill(times, times + k, 0);
+  }
+  recordAccess(frame);
+  heapPush(frame);
+}
+
+void LruKPolicy::pageAccessed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (heapPos[frame] == IndexLinks::NONE)
+    return;
+  cold[frame] = false;
+  recordAccess(frame);
+  // the key only grows, so the frame can only move down
+  siftDown(heapPos[frame]);
+}
+
+void LruKPolicy::pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                             const bool evicted)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (heapPos[frame] == IndexLinks::NONE)
+    return;
+  heapErase(frame);
+  if (evicted && !cold[frame])
+  {
+    const std::uint32_t slot = ghosts.insert(0, file, pageNo);
+    std::copy(&history[(std::size_t)frame * k], &history[(std::size_t)frame * k] + k,
+              &ghostHistory[(std::size_t)slot * k]);
+  }
+}
+
+FrameId LruKPolicy::pickVictim(const FrameEvictor& evictor, const std::vector<bool>& failed)
+{
+  // pop pinned and failed frames off the top until another one shows up,
+  // then put them back; the victim itself stays on the heap until it is
+  // evicted
+  FrameId victim = IndexLinks::NONE;
+  while (!heap.empty())
+  {
+    const FrameId top = heap[0];
+    if (!evictor.isPinned(top) && (failed.empty() || !failed[top]))
+    {
+      victim = top;
+      break;
+    }
+    heapErase(top);
+    skipped.push_back(top);
+  }
+  for (std::size_t i = 0; i < skipped.size(); i++)
+    heapPush(skipped[i]);
+  skipped.clear();
+  return victim;
+}
+
+void LruKPolicy::upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                                 std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  while (!heap.empty() && frames.size() < count)
+  {
+    const FrameId top = heap[0];
+    if (!evictor.isPinned(top))
+      frames.push_back(top);
+    heapErase(top);
+    skipped.push_back(top);
+  }
+  for (std::size_t i = 0; i < skipped.size(); i++)
+    heapPush(skipped[i]);
+  skipped.clear();
+}
+
+bool LruKPolicy::chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                              FrameId& frame)
+{
+  // a victim that cannot be evicted is set aside, so each attempt looks at
+  // another frame
+  std::vector<bool> failed;
+  for (std::uint32_t attempt = 0; attempt < 2 * numFrames; attempt++)
+  {
+    FrameId victim;
+    {
+      std::lock_guard<std::mutex> guard(latch);
+      victim = pickVictim(evictor, failed);
+    }
+    if (victim == IndexLinks::NONE)
+      return false;
+    if (evictor.tryEvict(victim))
+    {
+      frame = victim;
+      return true;
+    }
+    markFailed(failed, numFrames, victim);
+  }
+  return false;
+}
+
+}
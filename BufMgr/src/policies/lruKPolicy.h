@@ -0,0 +1,116 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "replacementPolicy.h"
+#include "ghostCache.h"
+
+namespace badgerdb {
+
+/**
+* @brief LRU-K replacement (O'Neil, O'Neil and Weikum)
+*
+* Evicts the page whose K-th most recent access is the oldest; pages with
+* fewer than K accesses go first, least recently used first.  Access times
+* are a logical clock.  Resident frames are kept in a binary heap ordered by
+* that key, and the access history of evicted pages is remembered for as many
+* pages as there are frames, so a page that comes back keeps its history.
+*/
+class LruKPolicy : public ReplacementPolicy
+{
+ public:
+	/**
+	 * Constructor of LruKPolicy class
+	 *
+	 * @param numFrames Number of frames in the buffer pool
+	 * @param k         Number of accesses remembered per page
+	 */
+  LruKPolicy(const std::uint32_t numFrames, const std::uint32_t k);
+
+  const char* name() const { return "lru-k"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                  const bool cold);
+  void pageAccessed(const FrameId frame);
+  void pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                   const bool evicted);
+  bool chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                    FrameId& frame);
+  void upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                       std::vector<FrameId>& frames);
+
+ private:
+	/**
+	 * Records an access to frame at the current time.
+	 */
+  void recordAccess(const FrameId frame);
+
+	/**
+	 * True if frame a should be evicted before frame b
+	 */
+  bool colder(const FrameId a, const FrameId b) const;
+
+  void heapPush(const FrameId frame);
+  void heapErase(const FrameId frame);
+  void siftUp(std::uint32_t pos);
+  void siftDown(std::uint32_t pos);
+  void heapSet(const std::uint32_t pos, const FrameId frame);
+
+	/**
+	 * Returns the coldest resident frame whose page is not pinned and that is
+	 * not marked in failed, or IndexLinks::NONE.
+	 */
+  FrameId pickVictim(const FrameEvictor& evictor, const std::vector<bool>& failed);
+
+  std::uint32_t numFrames;
+  std::uint32_t k;
+
+	/**
+	 * Logical time, advanced on every access
+	 */
+  std::uint64_t now;
+
+	/**
+	 * Access times of each frame's page, k per frame, most recent first; zero
+	 * where the page has fewer accesses
+	 */
+  std::vector<std::uint64_t> history;
+
+	/**
+	 * True for frames loaded cold and not accessed since
+	 */
+  std::vector<char> cold;
+
+	/**
+	 * Binary min-heap of resident frames, coldest at the top
+	 */
+  std::vector<FrameId> heap;
+
+	/**
+	 * Position of each frame in heap, or IndexLinks::NONE
+	 */
+  std::vector<std::uint32_t> heapPos;
+
+	/**
+	 * Frames popped off the heap while looking for an evictable one
+	 */
+  std::vector<FrameId> skipped;
+
+	/**
+	 * Evicted pages, with their access times in ghostHistory (k per slot)
+	 */
+  GhostCache ghosts;
+  std::vector<std::uint64_t> ghostHistory;
+
+  std::mutex latch;
+};
+
+}
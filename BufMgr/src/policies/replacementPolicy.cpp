@@ -0,0 +1,62 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "replacementPolicy.h"
+#include "clockPolicy.h"
+#include "lruKPolicy.h"
+#include "twoQPolicy.h"
+#include "arcPolicy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyKind kind,
+                                             const std::uint32_t numFrames)
+{
+  switch (kind)
+  {
+    case LRU_K_POLICY:
+      return new LruKPolicy(numFrames, 2);
+    case TWO_Q_POLICY:
+      return new TwoQPolicy(numFrames);
+    case ARC_POLICY:
+      return new ArcPolicy(numFrames);
+    case CLOCK_POLICY:
+    default:
+      return new ClockPolicy(numFrames);
+  }
+}
+
+std::uint32_t ReplacementPolicy::coldestUnpinned(const IndexList& list, const IndexLinks& links,
+                                                 const FrameEvictor& evictor,
+                                                 const std::vector<bool>& failed)
+{
+  for (std::uint32_t frame = list.back(); frame != IndexLinks::NONE; frame = links.prev[frame])
+    if (!evictor.isPinned(frame) && (failed.empty() || !failed[frame]))
+      return frame;
+  return IndexLinks::NONE;
+}
+
+void ReplacementPolicy::markFailed(std::vector<bool>& failed, const std::uint32_t numFrames,
+                                   const FrameId victim)
+{
+  // sized lazily: most calls evict their first victim
+  if (failed.empty())
+    failed.resize(numFrames, false);
+  failed[victim] = true;
+}
+
+void ReplacementPolicy::appendUnpinned(const IndexList& list, const IndexLinks& links,
+                                       const FrameEvictor& evictor, const std::uint32_t count,
+                                       std::vector<FrameId>& frames)
+{
+  for (std::uint32_t frame = list.back();
+       frame != IndexLinks::NONE && frames.size() < count; frame = links.prev[frame])
+    if (!evictor.isPinned(frame))
+      frames.push_back(frame);
+}
+
+}
@@ -0,0 +1,217 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "file.h"
+#include "types.h"
+#include "indexList.h"
+
+namespace badgerdb {
+
+/**
+* @brief Page replacement policies a BufMgr can be constructed with
+*/
+enum ReplacementPolicyKind {
+	/**
+	 * Clock sweep with one reference bit per frame
+	 */
+  CLOCK_POLICY,
+
+	/**
+	 * LRU-K with K = 2: evicts the page whose second most recent access is oldest
+	 */
+  LRU_K_POLICY,
+
+	/**
+	 * 2Q: new pages enter a FIFO queue, pages referenced again after leaving it
+	 * are promoted to an LRU queue
+	 */
+  TWO_Q_POLICY,
+
+	/**
+	 * Adaptive Replacement Cache: balances recency and frequency lists using
+	 * the history of recently evicted pages
+	 */
+  ARC_POLICY
+};
+
+/**
+* @brief The operations a replacement policy may perform on buffer pool frames
+*
+* Implemented by BufMgr.  isResident(), isPinned() and clearReferenced() are
+* cheap, unlatched hints; tryEvict() makes the real decision.
+*/
+class FrameEvictor
+{
+ public:
+  virtual ~FrameEvictor() {}
+
+	/**
+	 * Returns true if the frame currently holds a page.
+	 */
+  virtual bool isResident(const FrameId frame) const = 0;
+
+	/**
+	 * Returns true if the page in the frame is currently pinned.
+	 */
+  virtual bool isPinned(const FrameId frame) const = 0;
+
+	/**
+	 * Returns the reference bit of the frame without clearing it.
+	 */
+  virtual bool isReferenced(const FrameId frame) const = 0;
+
+	/**
+	 * Clears the reference bit of the frame, which is set whenever its page is
+	 * pinned, and returns its previous value.
+	 */
+  virtual bool clearReferenced(const FrameId frame) = 0;
+
+	/**
+	 * Evicts the page in the frame, writing it back first if it is dirty.  On
+	 * success the frame belongs to the caller of chooseVictim() and the policy
+	 * has already been told through pageRemoved().  Fails if the page is pinned
+	 * or gets pinned while it is being written back.
+	 *
+	 * @return True if the page was evicted.
+	 */
+  virtual bool tryEvict(const FrameId frame) = 0;
+};
+
+/**
+* @brief Interface of page replacement policies
+*
+* BufMgr reports every page that enters or leaves a frame, and every further
+* access to it, and asks the policy for a victim when it has no free frame.
+* Notifications about a page are made while holding that page's hash table
+* latch, so for any one frame they arrive in order; implementations keep
+* their own latch for their shared state.  chooseVictim() must not hold that
+* latch while calling FrameEvictor::tryEvict(), since eviction calls back
+* into pageRemoved().
+*
+* Each shard of the pool has its own policy, so that latch is per shard.
+* The clock policy takes no latch on a hit.  LRU-K, 2Q and ARC reorder their
+* lists on every hit, so hits on pages of the same shard serialize on it;
+* give them as many shards as the threads that share the pool.
+*
+* Per-frame metadata is kept in arrays indexed by FrameId.
+*/
+class ReplacementPolicy
+{
+ public:
+  virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Creates a policy of the given kind for a pool of up to numFrames frames,
+	 * all of them in use until poolResized() says otherwise.
+	 */
+  static ReplacementPolicy* create(const ReplacementPolicyKind kind, const std::uint32_t numFrames);
+
+	/**
+	 * Returns the name of the policy.
+	 */
+  virtual const char* name() const = 0;
+
+	/**
+	 * A page was read or allocated into a frame.
+	 *
+	 * @param frame   	Frame now holding the page
+	 * @param file   	File of the page
+	 * @param pageNo  Page number of the page
+	 * @param cold    True if the page is not expected to be used again soon
+	 *                (a scan or bulk write page), so it should be among the
+	 *                first to go and not be remembered once evicted, unless it
+	 *                is accessed again first
+	 */
+  virtual void pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                          const bool cold) = 0;
+
+	/**
+	 * The page in a frame was pinned again.
+	 *
+	 * @param frame   	Frame holding the page
+	 */
+  virtual void pageAccessed(const FrameId frame) = 0;
+
+	/**
+	 * The page left its frame.
+	 *
+	 * @param frame   	Frame that held the page
+	 * @param file   	File of the page
+	 * @param pageNo  Page number of the page
+	 * @param evicted True if it was evicted; false if it was deleted or its
+	 *                read failed, so it is not worth remembering
+	 */
+  virtual void pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                           const bool evicted) = 0;
+
+	/**
+	 * Picks a victim and evicts it through evictor.tryEvict().
+	 *
+	 * @param evictor Buffer pool to evict from
+	 * @param file   	File of the page the frame is needed for, or NULL if unknown
+	 * @param pageNo  Page number of that page
+	 * @param frame   	Evicted frame, returned via this variable
+	 * @return False if no page could be evicted
+	 */
+  virtual bool chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                            FrameId& frame) = 0;
+
+	/**
+	 * Appends to frames up to count unpinned frames the policy expects to
+	 * evict next, the nearest first, without changing any state.  The
+	 * background writer cleans these ahead of time.
+	 *
+	 * @param evictor Buffer pool to look at
+	 * @param count   Maximum number of frames to return
+	 * @param frames  Frames, returned via this variable
+	 */
+  virtual void upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                               std::vector<FrameId>& frames) = 0;
+
+	/**
+	 * The buffer pool was resized and now uses the given frames of the
+	 * numFrames frames the policy was created for.  Policies whose targets
+	 * depend on the size of the pool adapt them; frames taken out of the pool
+	 * have already been emptied through pageRemoved().
+	 *
+	 * @param poolFrames  Frames in the pool, in ascending order
+	 */
+  virtual void poolResized(const std::vector<FrameId>& poolFrames) {}
+
+ protected:
+	/**
+	 * Returns the frame closest to the back of list whose page is not pinned
+	 * and that is not marked in failed, or IndexLinks::NONE if there is none.
+	 *
+	 * @param failed  Frames that could not be evicted earlier in the same
+	 *                chooseVictim call; empty if there were none
+	 */
+  static std::uint32_t coldestUnpinned(const IndexList& list, const IndexLinks& links,
+                                       const FrameEvictor& evictor,
+                                       const std::vector<bool>& failed);
+
+	/**
+	 * Marks victim in failed, sizing failed for numFrames on first use.
+	 */
+  static void markFailed(std::vector<bool>& failed, const std::uint32_t numFrames,
+                         const FrameId victim);
+
+	/**
+	 * Appends the unpinned frames of list to frames, from the back, until
+	 * frames holds count of them.
+	 */
+  static void appendUnpinned(const IndexList& list, const IndexLinks& links,
+                             const FrameEvictor& evictor, const std::uint32_t count,
+                             std::vector<FrameId>& frames);
+};
+
+}
@@ -0,0 +1,135 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "twoQPolicy.h"
+
+namespace badgerdb {
+
+// the sizes recommended in the paper: Kin 25% and Kout 50% of the pool
+TwoQPolicy::TwoQPolicy(const std::uint32_t numFrames)
+  : numFrames(numFrames), kin(std::max<std::uint32_t>(1, numFrames / 4)),
+    kout(std::max<std::uint32_t>(1, numFrames / 2)), links(numFrames),
+    queue(numFrames, NO_QUEUE), cold(numFrames, false), a1out(kout, 1)
+{
+}
+
+void TwoQPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                            const bool cold)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  int list;
+  const std::uint32_t slot = a1out.find(file, pageNo, list);
+  this->cold[frame] = cold;
+  if (cold)
+  {
+    // first out of A1in, and not promoted by an earlier visit
+    if (slot != GhostCache::NONE)
+      a1out.erase(slot);
+    a1in.pushBack(links, frame);
+    queue[frame] = A1IN;
+  }
+  else if (slot != GhostCache::NONE)
+  {
+    a1out.erase(slot);
+    am.pushFront(links, frame);
+    queue[frame] = AM;
+  }
+  else
+  {
+    a1in.pushFront(links, frame);
+    queue[frame] = A1IN;
+  }
+}
+
+void TwoQPolicy::pageAccessed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  cold[frame] = false;
+  if (queue[frame] == AM)
+  {
+    am.remove(links, frame);
+    am.pushFront(links, frame);
+  }
+}
+
+void TwoQPolicy::pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                             const bool evicted)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (queue[frame] == A1IN)
+  {
+    a1in.remove(links, frame);
+    if (evicted && !cold[frame])
+    {
+      if (a1out.size(0) >= kout)
+        a1out.eraseOldest(0);
+      a1out.insert(0, file, pageNo);
+    }
+  }
+  else if (queue[frame] == AM)
+  {
+    am.remove(links, frame);
+  }
+  queue[frame] = NO_QUEUE;
+}
+
+FrameId TwoQPolicy::pickVictim(const FrameEvictor& evictor, const std::vector<bool>& failed)
+{
+  IndexList& first = a1in.size() > kin ? a1in : am;
+  IndexList& second = &first == &a1in ? am : a1in;
+  FrameId victim = coldestUnpinned(first, links, evictor, failed);
+  if (victim == IndexLinks::NONE)
+    victim = coldestUnpinned(second, links, evictor, failed);
+  return victim;
+}
+
+void TwoQPolicy::upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                                 std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  IndexList& first = a1in.size() > kin ? a1in : am;
+  appendUnpinned(first, links, evictor, count, frames);
+  appendUnpinned(&first == &a1in ? am : a1in, links, evictor, count, frames);
+}
+
+bool TwoQPolicy::chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                              FrameId& frame)
+{
+  // a victim that cannot be evicted is set aside, so each attempt looks at
+  // another frame
+  std::vector<bool> failed;
+  for (std::uint32_t attempt = 0; attempt < 2 * numFrames; attempt++)
+  {
+    FrameId victim;
+    {
+      std::lock_guard<std::mutex> guard(latch);
+      victim = pickVictim(evictor, failed);
+    }
+    if (victim == IndexLinks::NONE)
+      return false;
+    if (evictor.tryEvict(victim))
+    {
+      frame = victim;
+      return true;
+    }
+    markFailed(failed, numFrames, victim);
+  }
+  return false;
+}
+
+void TwoQPolicy::poolResized(const std::vector<FrameId>& poolFrames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  kin = std::max<std::uint32_t>(1, poolFrames.size() / 4);
+  kout = std::max<std::uint32_t>(1, poolFrames.size() / 2);
+  while (a1out.size(0) > kout)
+    a1out.eraseOldest(0);
+}
+
+}
@@ -0,0 +1,88 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "replacementPolicy.h"
+#include "ghostCache.h"
+
+namespace badgerdb {
+
+/**
+* @brief 2Q replacement (Johnson and Shasha), full version
+*
+* Pages read for the first time go into A1in, a FIFO holding about a quarter
+* of the frames; further accesses while there do not count.  Pages evicted
+* from A1in are remembered in A1out, and only a page read again while it is
+* remembered there enters Am, an LRU list of the pages that proved hot.  A
+* single scan therefore passes through A1in without disturbing Am.
+*/
+class TwoQPolicy : public ReplacementPolicy
+{
+ public:
+  explicit TwoQPolicy(const std::uint32_t numFrames);
+
+  const char* name() const { return "2q"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo,
+                  const bool cold);
+  void pageAccessed(const FrameId frame);
+  void pageRemoved(const FrameId frame, const File* file, const PageId pageNo,
+                   const bool evicted);
+  bool chooseVictim(FrameEvictor& evictor, const File* file, const PageId pageNo,
+                    FrameId& frame);
+  void upcomingVictims(const FrameEvictor& evictor, const std::uint32_t count,
+                       std::vector<FrameId>& frames);
+  void poolResized(const std::vector<FrameId>& poolFrames);
+
+ private:
+  enum Queue { NO_QUEUE, A1IN, AM };
+
+	/**
+	 * Returns the frame to evict next whose page is not pinned and that is
+	 * not marked in failed, or IndexLinks::NONE.
+	 */
+  FrameId pickVictim(const FrameEvictor& evictor, const std::vector<bool>& failed);
+
+  std::uint32_t numFrames;
+
+	/**
+	 * Target size of A1in
+	 */
+  std::uint32_t kin;
+
+	/**
+	 * Number of pages remembered in A1out
+	 */
+  std::uint32_t kout;
+
+  IndexLinks links;
+  IndexList a1in;
+  IndexList am;
+
+	/**
+	 * Queue each frame is on
+	 */
+  std::vector<char> queue;
+
+	/**
+	 * True for frames loaded cold and not accessed since
+	 */
+  std::vector<char> cold;
+
+	/**
+	 * A1out, the pages recently evicted from A1in
+	 */
+  GhostCache a1out;
+
+  std::mutex latch;
+};
+
+}
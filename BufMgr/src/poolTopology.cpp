@@ -0,0 +1,107 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sched.h>
+#include "poolTopology.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Parses a kernel CPU list such as "0-3,8-11" into cpus.
+ */
+bool parseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    int first, last;
+    char dash;
+    std::stringstream rs(range);
+    if (!(rs >> first))
+      return false;
+    last = first;
+    if (rs >> dash && !(dash == '-' && rs >> last))
+      return false;
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return !cpus.empty();
+}
+
+}
+
+PoolTopology::PoolTopology()
+  : nodes(false)
+{
+  if (readNodes()) {
+    nodes = true;
+  } else {
+    groupCpus.clear();
+    const int count = std::max(1u, std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < count; cpu++) {
+      if (cpu % CPUS_PER_GROUP == 0)
+        groupCpus.push_back(std::vector<int>());
+      groupCpus.back().push_back(cpu);
+    }
+  }
+
+  for (std::uint32_t group = 0; group < groupCpus.size(); group++) {
+    for (std::size_t i = 0; i < groupCpus[group].size(); i++) {
+      const int cpu = groupCpus[group][i];
+      if (cpu >= static_cast<int>(cpuGroup.size()))
+        cpuGroup.resize(cpu + 1, -1);
+      cpuGroup[cpu] = group;
+    }
+  }
+}
+
+bool PoolTopology::readNodes()
+{
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string list;
+  std::vector<int> nodeIds;
+  if (!std::getline(online, list) || !parseCpuList(list, nodeIds) || nodeIds.size() < 2)
+    return false;
+
+  for (std::size_t i = 0; i < nodeIds.size(); i++) {
+    std::stringstream path;
+    path << "/sys/devices/system/node/node" << nodeIds[i] << "/cpulist";
+    std::ifstream cpulist(path.str().c_str());
+    std::vector<int> cpus;
+    // memory-only nodes have no CPUs to touch their memory from
+    if (std::getline(cpulist, list) && parseCpuList(list, cpus))
+      groupCpus.push_back(cpus);
+  }
+  return groupCpus.size() >= 2;
+}
+
+std::uint32_t PoolTopology::currentGroup() const
+{
+  const int cpu = sched_getcpu();
+  if (cpu < 0 || cpu >= static_cast<int>(cpuGroup.size()) || cpuGroup[cpu] < 0)
+    return 0;
+  return cpuGroup[cpu];
+}
+
+bool PoolTopology::runOn(const std::uint32_t group) const
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (std::size_t i = 0; i < groupCpus[group].size(); i++)
+    if (groupCpus[group][i] < CPU_SETSIZE)
+      CPU_SET(groupCpus[group][i], &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+}
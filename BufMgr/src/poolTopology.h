@@ -0,0 +1,87 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+* @brief Groups of CPUs the buffer pool keeps separate shards for
+*
+* On a NUMA machine each group is one memory node, as listed in
+* /sys/devices/system/node, so no libnuma is needed.  Elsewhere, or when
+* the node list cannot be read, CPUs are grouped by number, a fixed count of
+* consecutive CPUs per group.
+*/
+class PoolTopology
+{
+ private:
+	/**
+	 * CPUs of each group
+	 */
+  std::vector<std::vector<int> > groupCpus;
+
+	/**
+	 * Group of each CPU, -1 for CPUs not in any group
+	 */
+  std::vector<int> cpuGroup;
+
+	/**
+	 * True if the groups are memory nodes
+	 */
+  bool nodes;
+
+	/**
+	 * Reads the memory nodes and their CPUs; returns false if there are fewer
+	 * than two or they cannot be read.
+	 */
+  bool readNodes();
+
+ public:
+	/**
+	 * CPUs per group when there are no memory nodes to group by
+	 */
+  static const int CPUS_PER_GROUP = 8;
+
+	/**
+   * Constructor of PoolTopology class; looks at the machine it runs on
+	 */
+  PoolTopology();
+
+	/**
+   * Returns the number of groups, at least one
+	 */
+  std::uint32_t groupCount() const { return groupCpus.size(); }
+
+	/**
+   * Returns true if the groups are memory nodes, so memory touched first by
+   * a CPU of a group is local to it
+	 */
+  bool numa() const { return nodes; }
+
+	/**
+   * Returns the CPUs of a group
+	 */
+  const std::vector<int>& cpus(const std::uint32_t group) const { return groupCpus[group]; }
+
+	/**
+   * Returns the group of the CPU the calling thread is running on
+	 */
+  std::uint32_t currentGroup() const;
+
+	/**
+   * Restricts the calling thread to the CPUs of a group.
+	 *
+	 * @return False if the thread could not be moved
+	 */
+  bool runOn(const std::uint32_t group) const;
+};
+
+}
@@ -0,0 +1,44 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "bufTrace.h"
+
+using namespace badgerdb;
+
+/**
+ * Converts a trace written by BufTrace::save() to Chrome trace event JSON,
+ * for loading into chrome://tracing or Perfetto.
+ */
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: badgerdb_trace_dump <trace> [output.json]\n";
+    return 1;
+  }
+
+  std::vector<TraceEvent> events;
+  if (!BufTrace::load(argv[1], events)) {
+    std::cerr << "badgerdb_trace_dump: cannot read trace " << argv[1] << "\n";
+    return 1;
+  }
+
+  if (argc == 3) {
+    std::ofstream out(argv[2]);
+    BufTrace::writeChromeJson(events, out);
+    if (!out) {
+      std::cerr << "badgerdb_trace_dump: cannot write " << argv[2] << "\n";
+      return 1;
+    }
+  } else {
+    BufTrace::writeChromeJson(events, std::cout);
+  }
+  std::cerr << events.size() << " events\n";
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "warmUp.h"
+
+namespace badgerdb {
+
+namespace {
+
+// Written at the start of saved lists
+const char WARM_UP_MAGIC[8] = {'B', 'D', 'B', 'W', 'A', 'R', 'M', '1'};
+
+// Longest file name a list is trusted to hold
+const std::uint32_t MAX_NAME_LENGTH = 4096;
+
+}
+
+const std::uint16_t WarmUpList::HOTTEST;
+
+bool WarmUpList::save(const std::string& path) const
+{
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(WARM_UP_MAGIC, sizeof(WARM_UP_MAGIC));
+    const std::uint32_t fileCount = files.size();
+    out.write(reinterpret_cast<const char*>(&fileCount), sizeof(fileCount));
+    for (std::size_t f = 0; f < files.size(); f++) {
+      const std::uint32_t length = files[f].size();
+      out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+      out.write(files[f].data(), length);
+    }
+    const std::uint32_t entryCount = entries.size();
+    out.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+    if (!entries.empty())
+      out.write(reinterpret_cast<const char*>(&entries[0]), entries.size() * sizeof(WarmUpEntry));
+    out.close();
+    if (!out) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool WarmUpList::load(const std::string& path)
+{
+  files.clear();
+  entries.clear();
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char magic[sizeof(WARM_UP_MAGIC)];
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, WARM_UP_MAGIC, sizeof(magic)) != 0)
+    return false;
+
+  std::uint32_t fileCount;
+  if (!in.read(reinterpret_cast<char*>(&fileCount), sizeof(fileCount)))
+    return false;
+  for (std::uint32_t f = 0; f < fileCount; f++) {
+    std::uint32_t length;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > MAX_NAME_LENGTH)
+      return false;
+    std::string name(length, '\0');
+    if (length != 0 && !in.read(&name[0], length))
+      return false;
+    files.push_back(name);
+  }
+
+  std::uint32_t entryCount;
+  if (!in.read(reinterpret_cast<char*>(&entryCount), sizeof(entryCount)))
+    return false;
+  WarmUpEntry entry;
+  for (std::uint32_t e = 0; e < entryCount; e++) {
+    if (!in.read(reinterpret_cast<char*>(&entry), sizeof(entry)) || entry.file >= files.size())
+      return false;
+    entries.push_back(entry);
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,76 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief One resident page in a WarmUpList
+*/
+struct WarmUpEntry
+{
+	/**
+   * Index of the page's file in WarmUpList::files
+	 */
+  std::uint32_t file;
+
+  PageId pageNo;
+
+	/**
+   * How soon the replacement policy would have kept the page, from 0 for the
+   * page it was about to evict to WarmUpList::HOTTEST for pages it was not
+   * going to evict at all (pinned, or referenced since the clock last passed)
+	 */
+  std::uint16_t hotness;
+  std::uint16_t reserved;
+};
+
+/**
+* @brief Resident pages of a buffer pool, saved so that a later BufMgr can
+* read them back in with BufMgr::warmUp()
+*
+* Saved as a magic number, the file names, then 12 bytes per page, in the
+* byte order of the machine; a list of 100000 pages takes about 1.2 MB.
+*/
+struct WarmUpList
+{
+	/**
+   * Hotness of the pages the policy was keeping no matter what
+	 */
+  static const std::uint16_t HOTTEST = 0xffff;
+
+	/**
+   * Names of the files the pages belong to
+	 */
+  std::vector<std::string> files;
+
+  std::vector<WarmUpEntry> entries;
+
+	/**
+   * Writes the list to a file, through a temporary file renamed over it, so
+   * a crash halfway leaves the previous list in place
+   *
+   * @return False if the file could not be written
+	 */
+  bool save(const std::string& path) const;
+
+	/**
+   * Reads a list written by save()
+   *
+   * @return False if the file could not be read or is not a list
+	 */
+  bool load(const std::string& path);
+};
+
+}